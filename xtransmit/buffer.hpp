@@ -1,5 +1,8 @@
 #pragma once
+#include <array>
 #include <cstddef>
+#include <initializer_list>
+#include <vector>
 
 namespace xtransmit
 {
@@ -127,5 +130,72 @@ class const_buffer
 };
 
 
+/// A non-owning view of a sequence of buffers for scatter/gather I/O.
+/**
+ * Lets a header and a payload living in separate memory ranges be written
+ * as one message, or a message be read into separate memory ranges,
+ * without copying the payload into a contiguous buffer first.
+ * Like the buffers themselves, the view does not own the array of buffers,
+ * which must outlive the view:
+ *
+ * @code sock.write(const_buffer_sequence({const_buffer(hdr, hdr_len), payload}));
+ * @endcode
+ */
+template <class Buffer>
+class buffer_sequence
+{
+  public:
+	/// Construct a sequence of a given array of buffers.
+	buffer_sequence(const Buffer *buffers, std::size_t count) noexcept
+	    : buffers_(buffers)
+	    , count_(count)
+	{
+	}
+
+	/// Construct a sequence of the buffers of a braced list.
+	/// The list only lives until the end of the full expression.
+	buffer_sequence(std::initializer_list<Buffer> buffers) noexcept
+	    : buffers_(buffers.begin())
+	    , count_(buffers.size())
+	{
+	}
+
+	template <std::size_t N>
+	buffer_sequence(const std::array<Buffer, N> &buffers) noexcept
+	    : buffers_(buffers.data())
+	    , count_(N)
+	{
+	}
+
+	buffer_sequence(const std::vector<Buffer> &buffers) noexcept
+	    : buffers_(buffers.data())
+	    , count_(buffers.size())
+	{
+	}
+
+	const Buffer *begin() const noexcept { return buffers_; }
+	const Buffer *end() const noexcept { return buffers_ + count_; }
+
+	/// Get the number of buffers in the sequence.
+	std::size_t count() const noexcept { return count_; }
+
+	const Buffer &operator[](std::size_t i) const noexcept { return buffers_[i]; }
+
+	/// Get the total size of the buffers in the sequence.
+	std::size_t size() const noexcept
+	{
+		std::size_t total = 0;
+		for (const Buffer &b : *this)
+			total += b.size();
+		return total;
+	}
+
+  private:
+	const Buffer *buffers_;
+	std::size_t   count_;
+};
+
+using mutable_buffer_sequence = buffer_sequence<mutable_buffer>;
+using const_buffer_sequence   = buffer_sequence<const_buffer>;
 
 } // namespace xtransmit
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace xtransmit
+{
+
+/// Fixed pool of equally sized message buffers filled by one producer and shared by several consumers.
+///
+/// The producer acquires a free buffer, fills it and sets the number of consumers it is handed over to.
+/// Each consumer releases the buffer when done with it, and the last release makes the buffer free again.
+/// No locks are taken: a buffer is free when its reference counter is zero.
+class shared_buffer_pool
+{
+public:
+	struct buffer
+	{
+		std::vector<char> data;
+		size_t            len = 0;
+		std::atomic<int>  refs{0};
+
+		/// Consumer: done with the buffer.
+		void release() { refs.fetch_sub(1, std::memory_order_acq_rel); }
+	};
+
+	/// @param num   the number of buffers
+	/// @param size  the size of each buffer
+	shared_buffer_pool(size_t num, size_t size)
+		: m_buffers(new buffer[num > 0 ? num : 1])
+		, m_num(num > 0 ? num : 1)
+	{
+		for (size_t i = 0; i < m_num; ++i)
+			m_buffers[i].data.resize(size);
+	}
+
+	shared_buffer_pool(const shared_buffer_pool&) = delete;
+	shared_buffer_pool& operator=(const shared_buffer_pool&) = delete;
+
+public:
+	/// Producer: get a free buffer, nullptr if all buffers are in use.
+	/// Buffers are released roughly in the order they were acquired,
+	/// so the search starts after the previously acquired one.
+	buffer* acquire()
+	{
+		for (size_t i = 0; i < m_num; ++i)
+		{
+			const size_t idx = (m_next + i) % m_num;
+			if (m_buffers[idx].refs.load(std::memory_order_acquire) != 0)
+				continue;
+			m_next = idx + 1;
+			return &m_buffers[idx];
+		}
+		return nullptr;
+	}
+
+	/// Producer: hand the acquired buffer over to the given number of consumers.
+	/// Must be called before the buffer is published to the consumers.
+	/// Zero consumers leaves the buffer free.
+	static void share(buffer* b, int num_consumers) { b->refs.store(num_consumers, std::memory_order_relaxed); }
+
+	size_t size() const { return m_num; }
+
+private:
+	std::unique_ptr<buffer[]> m_buffers;
+	const size_t              m_num;
+	size_t                    m_next = 0; // Accessed by the producer only.
+};
+
+} // namespace xtransmit
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace xtransmit
+{
+
+/// Bounded window of recently seen message keys to forward only the first copy of a message
+/// received over several paths. Lock-free: can be used by several reader threads concurrently.
+///
+/// Keys are stored in a direct-mapped table indexed by the key modulo the window size.
+/// With sequential keys (e.g. packet sequence numbers) a slot holding a newer key means
+/// the message is older than the window and is reported as late.
+/// With hashed keys the order is meaningless, and a newer message just replaces the stored one.
+class dedup_window
+{
+public:
+	enum result
+	{
+		FIRST,     // The first copy of the message.
+		DUPLICATE, // The message has already been seen.
+		LATE       // Sequential keys only: the message is older than the window.
+	};
+
+	/// @param size        the number of remembered keys, rounded up to a power of two
+	/// @param sequential  keys are increasing sequence numbers
+	dedup_window(size_t size, bool sequential)
+		: m_sequential(sequential)
+	{
+		size_t n = 1;
+		while (n < size)
+			n <<= 1;
+		m_mask  = n - 1;
+		m_slots = std::unique_ptr<std::atomic<uint64_t>[]>(new std::atomic<uint64_t>[n]);
+		for (size_t i = 0; i < n; ++i)
+			m_slots[i].store(0, std::memory_order_relaxed);
+	}
+
+	/// Register the key of a received message.
+	result submit(uint64_t key)
+	{
+		// Zero marks an empty slot.
+		const uint64_t stored = m_sequential ? key + 1 : (key ? key : 1);
+		std::atomic<uint64_t>& slot = m_slots[key & m_mask];
+
+		uint64_t old = slot.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			if (old == stored)
+				return DUPLICATE;
+			if (m_sequential && old > stored)
+				return LATE;
+			if (slot.compare_exchange_weak(old, stored, std::memory_order_relaxed))
+				return FIRST;
+		}
+	}
+
+	size_t size() const { return m_mask + 1; }
+
+	/// 64-bit FNV-1a hash of the message content to be used as a key.
+	static uint64_t content_hash(const void* data, size_t len)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		uint64_t h = 14695981039346656037ULL;
+		for (size_t i = 0; i < len; ++i)
+		{
+			h ^= p[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+private:
+	const bool                               m_sequential;
+	size_t                                   m_mask = 0;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_slots;
+};
+
+} // namespace xtransmit
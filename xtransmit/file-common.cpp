@@ -0,0 +1,223 @@
+#if ENABLE_FILE_TRANSFER
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <future>
+
+#include "file-common.hpp"
+
+
+using namespace std;
+using namespace xtransmit;
+
+using shared_srt = std::shared_ptr<socket::srt>;
+
+
+namespace
+{
+
+constexpr uint64_t PRIME64_1 = 11400714785074694791ULL;
+constexpr uint64_t PRIME64_2 = 14029467366897019727ULL;
+constexpr uint64_t PRIME64_3 = 1609587929392839161ULL;
+constexpr uint64_t PRIME64_4 = 9650029242287828579ULL;
+constexpr uint64_t PRIME64_5 = 2870177450012600261ULL;
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+// The hash is defined over little endian words.
+inline uint64_t read64(const uint8_t* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof v);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+inline uint32_t read32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof v);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+inline uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME64_2;
+	acc = rotl64(acc, 31);
+	return acc * PRIME64_1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t val)
+{
+	acc ^= hash_round(0, val);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+} // namespace
+
+
+file::hash64::hash64(uint64_t seed)
+	: m_seed(seed)
+{
+	m_lanes[0] = seed + PRIME64_1 + PRIME64_2;
+	m_lanes[1] = seed + PRIME64_2;
+	m_lanes[2] = seed;
+	m_lanes[3] = seed - PRIME64_1;
+}
+
+void file::hash64::update(const void* data, size_t len)
+{
+	const uint8_t* p   = static_cast<const uint8_t*>(data);
+	const uint8_t* end = p + len;
+	m_total += len;
+
+	if (m_tail_len + len < sizeof m_tail)
+	{
+		memcpy(m_tail + m_tail_len, p, len);
+		m_tail_len += len;
+		return;
+	}
+
+	if (m_tail_len > 0)
+	{
+		const size_t n = sizeof m_tail - m_tail_len;
+		memcpy(m_tail + m_tail_len, p, n);
+		p += n;
+		for (int i = 0; i < 4; ++i)
+			m_lanes[i] = hash_round(m_lanes[i], read64(m_tail + 8 * i));
+		m_tail_len = 0;
+	}
+
+	uint64_t v0 = m_lanes[0], v1 = m_lanes[1], v2 = m_lanes[2], v3 = m_lanes[3];
+	for (; p + 32 <= end; p += 32)
+	{
+		v0 = hash_round(v0, read64(p));
+		v1 = hash_round(v1, read64(p + 8));
+		v2 = hash_round(v2, read64(p + 16));
+		v3 = hash_round(v3, read64(p + 24));
+	}
+	m_lanes[0] = v0, m_lanes[1] = v1, m_lanes[2] = v2, m_lanes[3] = v3;
+
+	m_tail_len = static_cast<size_t>(end - p);
+	memcpy(m_tail, p, m_tail_len);
+}
+
+uint64_t file::hash64::digest() const
+{
+	uint64_t h;
+	if (m_total >= 32)
+	{
+		h = rotl64(m_lanes[0], 1) + rotl64(m_lanes[1], 7) + rotl64(m_lanes[2], 12) + rotl64(m_lanes[3], 18);
+		for (int i = 0; i < 4; ++i)
+			h = merge_round(h, m_lanes[i]);
+	}
+	else
+	{
+		h = m_seed + PRIME64_5;
+	}
+	h += m_total;
+
+	const uint8_t* p   = m_tail;
+	const uint8_t* end = m_tail + m_tail_len;
+	for (; p + 8 <= end; p += 8)
+		h = rotl64(h ^ hash_round(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+	if (p + 4 <= end)
+	{
+		h = rotl64(h ^ (uint64_t(read32(p)) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; ++p)
+		h = rotl64(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+
+vector<uint64_t> xtransmit::file::hash_chunks(const string& path, uint64_t size, uint64_t chunk_size, uint64_t* file_hash)
+{
+	vector<uint64_t> hashes;
+	ifstream ifile(path, ios::binary);
+	if (!ifile || chunk_size == 0)
+		return hashes;
+
+	vector<char> buf(min<uint64_t>(chunk_size, 1024 * 1024));
+	hash64       whole;
+	for (uint64_t chunk_start = 0; chunk_start < size; chunk_start += chunk_size)
+	{
+		const uint64_t chunk_len = min(chunk_size, size - chunk_start);
+		hash64 h;
+		for (uint64_t pos = 0; pos < chunk_len;)
+		{
+			const size_t n = static_cast<size_t>(ifile.read(buf.data(), streamsize(min<uint64_t>(buf.size(), chunk_len - pos))).gcount());
+			if (n == 0)
+				return hashes; // The chunk is not completely present in the file.
+			h.update(buf.data(), n);
+			if (file_hash)
+				whole.update(buf.data(), n);
+			pos += n;
+		}
+		hashes.push_back(h.digest());
+	}
+
+	if (file_hash)
+		*file_hash = whole.digest();
+	return hashes;
+}
+
+bool xtransmit::file::hash_file(const string& path, uint64_t& hash)
+{
+	ifstream ifile(path, ios::binary);
+	if (!ifile)
+		return false;
+
+	vector<char> buf(1024 * 1024);
+	hash64       h;
+	while (ifile)
+	{
+		const size_t n = static_cast<size_t>(ifile.read(buf.data(), streamsize(buf.size())).gcount());
+		h.update(buf.data(), n);
+	}
+	if (!ifile.eof())
+		return false;
+
+	hash = h.digest();
+	return true;
+}
+
+
+vector<shared_srt> xtransmit::file::connect_streams(const UriParser& ut, size_t num_streams)
+{
+	shared_srt socket = make_shared<socket::srt>(ut);
+	vector<shared_srt> conns;
+	if (socket->mode() == socket::srt::LISTENER)
+	{
+		conns.push_back(socket->async_accept().get());
+		while (conns.size() < num_streams)
+			conns.push_back(socket->accept());
+		return conns;
+	}
+
+	vector<future<shared_srt>> connecting;
+	connecting.push_back(socket->async_connect());
+	while (connecting.size() < num_streams)
+		connecting.push_back(make_shared<socket::srt>(ut)->async_connect());
+
+	for (auto& c : connecting)
+		conns.push_back(c.get());
+	return conns;
+}
+
+#endif // ENABLE_FILE_TRANSFER
@@ -0,0 +1,130 @@
+#pragma once
+#if ENABLE_FILE_TRANSFER
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "srt_socket.hpp"
+
+
+namespace xtransmit::file
+{
+
+	/* A file is sent as a sequence of segments, one SRT message each.
+	 *   1 byte      string    1 byte   8 bytes (optional)  8 bytes (optional)
+	 * -------------------------------------------------------------------------
+	 * | flags    | Filename | 0     | File size         | Offset            | Payload | Hash
+	 * -------------------------------------------------------------------------
+	 * The file name and the file size are only present in the first segment of a file.
+	 * The rest of the segments have the flags byte followed by the payload.
+	 * The last segment of a file may carry the hash64 of the whole file after the payload (8 bytes).
+	 * Segments of a resumed file carry the file offset of the payload. The first of them
+	 * updates the existing file instead of replacing it.
+	 *
+	 * In the resumable mode the sender announces each file with its chunk manifest:
+	 * | SEG_MANIFEST | Filename | 0 | File size | Chunk size | Chunk hashes (8 bytes each)
+	 * The receiver replies over the same connection with the chunks it already has:
+	 * | SEG_MANIFEST | Number of chunks | Bitmap (bit i % 8 of byte i / 8 is set if chunk i matches)
+	 * Only the missing chunks are sent then.
+	 *
+	 * In the packing mode small files are sent several in a segment, each with an inline index entry:
+	 * | SEG_PACKED | Name length (2 bytes) | File size (4 bytes) | Filename | Payload | Name length | ...
+	 */
+	enum segment_flags : uint8_t
+	{
+		SEG_FIRST    = 0x01, // The first segment of a file.
+		SEG_EOF      = 0x02, // The last segment of a file.
+		SEG_SIZE     = 0x04, // The first segment carries the file size (uint64, little endian) after the file name.
+		SEG_MANIFEST = 0x08, // The chunk manifest of a file or the reply to it.
+		SEG_OFFSET   = 0x10, // The segment carries the file offset of the payload (uint64, little endian).
+		SEG_PACKED   = 0x20, // The segment carries several complete small files.
+		SEG_HASH     = 0x40, // The last segment of a file carries the hash of the file (uint64, little endian).
+	};
+
+	/// Store a 16-bit value in a segment header (little endian).
+	inline void put_uint16(char* dst, uint16_t val)
+	{
+		dst[0] = static_cast<char>(val & 0xFF);
+		dst[1] = static_cast<char>(val >> 8);
+	}
+
+	/// Load a 16-bit value from a segment header (little endian).
+	inline uint16_t get_uint16(const char* src)
+	{
+		return static_cast<uint16_t>(static_cast<unsigned char>(src[0]) | (static_cast<unsigned char>(src[1]) << 8));
+	}
+
+	/// Store a 32-bit value in a segment header (little endian).
+	inline void put_uint32(char* dst, uint32_t val)
+	{
+		for (int i = 0; i < 4; ++i)
+			dst[i] = static_cast<char>((val >> (8 * i)) & 0xFF);
+	}
+
+	/// Load a 32-bit value from a segment header (little endian).
+	inline uint32_t get_uint32(const char* src)
+	{
+		uint32_t val = 0;
+		for (int i = 0; i < 4; ++i)
+			val |= uint32_t(static_cast<unsigned char>(src[i])) << (8 * i);
+		return val;
+	}
+
+	/// Store a 64-bit value in a segment header (little endian).
+	inline void put_uint64(char* dst, uint64_t val)
+	{
+		for (int i = 0; i < 8; ++i)
+			dst[i] = static_cast<char>((val >> (8 * i)) & 0xFF);
+	}
+
+	/// Load a 64-bit value from a segment header (little endian).
+	inline uint64_t get_uint64(const char* src)
+	{
+		uint64_t val = 0;
+		for (int i = 0; i < 8; ++i)
+			val |= uint64_t(static_cast<unsigned char>(src[i])) << (8 * i);
+		return val;
+	}
+
+	/// Streaming 64-bit hash of file contents (XXH64).
+	/// Consumes 32 bytes per step in four independent lanes, running at several GB/s.
+	class hash64
+	{
+	public:
+		explicit hash64(uint64_t seed = 0);
+
+		void     update(const void* data, size_t len);
+		uint64_t digest() const;
+
+	private:
+		uint64_t m_seed;
+		uint64_t m_total = 0;
+		uint64_t m_lanes[4];
+		uint8_t  m_tail[32];
+		size_t   m_tail_len = 0;
+	};
+
+	/// Hash the chunks of a file up to the given size. Only chunks completely present
+	/// in the file are hashed: a shorter file gets fewer hashes.
+	/// @param file_hash  [out] if not null, the hash of the whole file up to the given size,
+	///                   set if all the chunks are present
+	/// @returns chunk hashes, empty if the file can't be read
+	std::vector<uint64_t> hash_chunks(const std::string& path, uint64_t size, uint64_t chunk_size,
+		uint64_t* file_hash = nullptr);
+
+	/// Hash the whole file.
+	/// @returns false if the file can't be read
+	bool hash_file(const std::string& path, uint64_t& hash);
+
+	/// Establish the requested number of connections to the same peer
+	/// to transfer files over several streams.
+	/// A listener accepts all of them on the same listening socket, a caller connects them in parallel.
+	/// @throws socket::exception if any of the connections fails
+	std::vector<std::shared_ptr<socket::srt>> connect_streams(const UriParser& ut, size_t num_streams);
+
+
+} // namespace xtransmit::file
+
+
+#endif // ENABLE_FILE_TRANSFER
@@ -7,10 +7,28 @@
 #include <vector>
 #include <deque>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <thread>
+#include <unordered_set>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#include <malloc.h>
+#endif
+
+#include "file-common.hpp"
 #include "file-receive.hpp"
+#include "socket_stats.hpp"
+#include "spsc_ring.hpp"
 #include "srt_socket.hpp"
+#include "xtr_defs.hpp"
+
+// nlohmann_json
+#include <nlohmann/json.hpp>
 
 
 using namespace std;
@@ -74,63 +92,473 @@ bool create_subfolders(const string& path)
 
 
 
-bool receive_files(socket::srt& src, const string& dstpath
-	, vector<char>& buf, const atomic_bool& force_break)
+namespace
 {
-	cerr << "Downloading to '" << dstpath << endl;
 
-	chrono::steady_clock::time_point time_start;
-	chrono::steady_clock::time_point time_progress;
-	size_t file_size = 0;
+// Alignment of the writes to disk (page size, logical block size of most devices).
+const size_t IO_ALIGNMENT = 4096;
 
-	string download_str = "";
+char* aligned_alloc_block(size_t size)
+{
+#if defined(_WIN32)
+	return static_cast<char*>(_aligned_malloc(size, IO_ALIGNMENT));
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, IO_ALIGNMENT, size) != 0)
+		return nullptr;
+	return static_cast<char*>(ptr);
+#endif
+}
 
-	ofstream ofile;
-	while (!force_break)
+void aligned_free_block(char* ptr)
+{
+#if defined(_WIN32)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+/// A file being downloaded. Preallocated on disk if the size is known.
+class output_file
+{
+public:
+	/// @param size    the expected file size, 0 if unknown
+	/// @param update  update the existing file (resumed transfer) instead of replacing it
+	output_file(const string& path, uint64_t size, bool update)
+		: m_size(size)
+		, m_update(update)
 	{
-		const size_t bytes = src.read(mutable_buffer(buf.data(), buf.size()), -1);
-		if (bytes == 0)
-			continue;
+#if defined(_WIN32)
+		m_file = update ? fopen(path.c_str(), "r+b") : nullptr;
+		if (!m_file)
+			m_file = fopen(path.c_str(), "wb");
+#else
+		m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | (update ? 0 : O_TRUNC), 0644);
+#if defined(__linux__)
+		// Allocate the blocks of the file at once to avoid fragmentation and metadata updates on every write.
+		// Not supported by some file systems: the file just grows as it is written.
+		if (m_fd != -1 && size > 0)
+			m_preallocated = fallocate(m_fd, 0, 0, static_cast<off_t>(size)) == 0;
+#endif
+#endif
+	}
+
+	~output_file() { close(); }
+
+	bool is_open() const
+	{
+#if defined(_WIN32)
+		return m_file != nullptr;
+#else
+		return m_fd != -1;
+#endif
+	}
+
+	/// Write at the given offset of the file.
+	/// @returns false on failure.
+	bool write(uint64_t offset, const char* data, size_t len)
+	{
+		m_end = max(m_end, offset + len);
+#if defined(_WIN32)
+		if (_fseeki64(m_file, static_cast<long long>(offset), SEEK_SET) != 0)
+			return false;
+		return fwrite(data, 1, len, m_file) == len;
+#else
+		while (len > 0)
+		{
+			const ssize_t res = ::pwrite(m_fd, data, len, static_cast<off_t>(offset));
+			if (res == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			data += res;
+			offset += res;
+			len -= static_cast<size_t>(res);
+		}
+		return true;
+#endif
+	}
+
+	/// Close the file. A preallocated file is truncated to the size actually written,
+	/// an updated file to the expected size.
+	void close()
+	{
+#if defined(_WIN32)
+		if (m_file)
+			fclose(m_file);
+		m_file = nullptr;
+		if (m_update)
+			cerr << "Download: the updated file is not truncated to the expected size" << endl;
+#else
+		if (m_fd == -1)
+			return;
+		if (m_update || m_preallocated)
+		{
+			if (ftruncate(m_fd, static_cast<off_t>(m_update ? m_size : m_end)) == -1)
+				cerr << "Download: failed to truncate the file. Error " << errno << endl;
+		}
+		::close(m_fd);
+		m_fd = -1;
+#endif
+	}
+
+private:
+#if defined(_WIN32)
+	FILE* m_file = nullptr;
+#else
+	int m_fd = -1;
+#endif
+	const uint64_t m_size;
+	const bool     m_update;
+	uint64_t       m_end          = 0; // The end of the data written.
+	bool           m_preallocated = false;
+};
+
+/// A received segment waiting to be written.
+struct rx_segment
+{
+	vector<char> buf;
+	size_t       len = 0;
+};
+
+/// Writes received segments to files in a dedicated thread, so that the receiving thread
+/// is only blocked by the disk if all the segments of the queue are waiting to be written.
+/// The payload is collected into large aligned blocks written to disk at once.
+class segment_writer
+{
+public:
+	/// Sends a message back to the sender over the connection. Returns false on failure.
+	using reply_fn = function<bool(const const_buffer&)>;
+
+	/// @param reply  used to reply to chunk manifests of resumed files
+	segment_writer(const string& dstpath, size_t segment_size, size_t queue_depth, size_t block_size,
+		atomic<uint64_t>& bytes_received, bool print_progress, reply_fn reply)
+		: m_dstpath(dstpath)
+		, m_ring(queue_depth, rx_segment{vector<char>(segment_size)})
+		, m_block_size(((max(block_size, segment_size) + IO_ALIGNMENT - 1) / IO_ALIGNMENT) * IO_ALIGNMENT)
+		, m_block(aligned_alloc_block(m_block_size), &aligned_free_block)
+		, m_bytes_received(bytes_received)
+		, m_print_progress(print_progress)
+		, m_reply(std::move(reply))
+	{
+		if (!m_block)
+			throw socket::exception("Failed to allocate the file write buffer");
+		m_writer = thread(&segment_writer::writer_loop, this);
+	}
+
+	~segment_writer() { close(); }
+
+	/// The buffer to receive the next segment into. Waits while all the segments are waiting to be written.
+	/// @returns nullptr if the writer has failed or the transfer is interrupted.
+	rx_segment* free_segment(const atomic_bool& force_break)
+	{
+		rx_segment* seg = m_ring.free_slot();
+		if (seg)
+			return seg;
+
+		const auto t_start = steady_clock::now();
+		while (!force_break && !m_failed)
+		{
+			seg = m_ring.free_slot();
+			if (seg)
+				break;
+			m_ring.wait([this]() { return m_ring.free_slot() != nullptr || m_failed; }, milliseconds(100));
+		}
+		inc(m_blocked_us, duration_cast<microseconds>(steady_clock::now() - t_start).count());
+		return m_failed ? nullptr : seg;
+	}
+
+	/// Pass the segment returned by free_segment() for writing.
+	void push() { m_ring.push(); }
+
+	/// Write the segments received so far and stop the writer thread.
+	void close()
+	{
+		m_stop = true;
+		m_ring.notify();
+		if (m_writer.joinable())
+			m_writer.join();
+	}
+
+	bool failed() const { return m_failed; }
+
+	/// Time the receiving thread waited for a free segment (the network side was blocked by the disk).
+	uint64_t blocked_us() const { return m_blocked_us.load(memory_order_relaxed); }
+	/// Time the writer thread spent writing to disk.
+	uint64_t write_us() const { return m_write_us.load(memory_order_relaxed); }
+	/// The number of files with the hash received matching the file received.
+	uint64_t verified() const { return m_verified.load(memory_order_relaxed); }
+	/// The number of files with the hash received not matching the file received.
+	uint64_t mismatched() const { return m_mismatched.load(memory_order_relaxed); }
+
+private:
+	static void inc(atomic<uint64_t>& counter, uint64_t val)
+	{
+		counter.store(counter.load(memory_order_relaxed) + val, memory_order_relaxed);
+	}
+
+	void writer_loop()
+	{
+		XTR_THREADNAME(std::string("XTR:FileWr"));
+		for (;;)
+		{
+			rx_segment* seg = m_ring.front();
+			if (!seg)
+			{
+				// The segments pushed before the stop are still written.
+				if (m_stop && !m_ring.front())
+					break;
+				m_ring.wait([this]() { return m_ring.front() != nullptr || m_stop; }, milliseconds(100));
+				continue;
+			}
+
+			const bool ok = write_segment(*seg);
+			m_ring.pop();
+			if (!ok)
+			{
+				m_failed = true;
+				m_ring.notify();
+				break;
+			}
+		}
+
+		if (m_file)
+		{
+			cerr << m_download_str << ": incomplete (" << m_file_size / 1024 << " kB received)." << endl;
+			flush_block();
+			m_file.reset();
+		}
+	}
 
-		int hdr_size = 1;
-		const bool is_first = (buf[0] & 0x01) != 0;
-		const bool is_eof = (buf[0] & 0x02) != 0;
-		const auto tnow = chrono::steady_clock::now();
+	/// Reply to the chunk manifest of a file with the chunks already present in the destination file.
+	/// @returns false if the transfer can't be continued.
+	bool reply_manifest(const rx_segment& seg)
+	{
+		const char* data     = seg.buf.data();
+		const char* name_end = static_cast<const char*>(memchr(data + 1, '\0', seg.len - 1));
+		const size_t hdr_size = name_end ? static_cast<size_t>(name_end - data) + 1 + 8 + 8 : 0;
+		if (!name_end || seg.len < hdr_size)
+		{
+			cerr << "Download: malformed chunk manifest" << endl;
+			return false;
+		}
 
-		if (is_first)
+		const string   filename(data + 1, name_end);
+		const uint64_t file_size  = file::get_uint64(name_end + 1);
+		const uint64_t chunk_size = file::get_uint64(name_end + 9);
+		const size_t   num_chunks = (seg.len - hdr_size) / 8;
+
+		const vector<uint64_t> local = file::hash_chunks(m_dstpath + filename, file_size, chunk_size);
+
+		vector<char> reply(9 + (num_chunks + 7) / 8);
+		reply[0] = static_cast<char>(file::SEG_MANIFEST);
+		file::put_uint64(reply.data() + 1, num_chunks);
+		size_t num_present = 0;
+		for (size_t i = 0; i < num_chunks && i < local.size(); ++i)
+		{
+			if (local[i] != file::get_uint64(data + hdr_size + 8 * i))
+				continue;
+			reply[9 + i / 8] |= static_cast<char>(1 << (i % 8));
+			++num_present;
+		}
+
+		cerr << "Resuming '" << filename << "': " << num_present << " of " << num_chunks << " chunks present" << endl;
+		if (!m_reply(const_buffer(reply.data(), reply.size())))
 		{
+			cerr << "Download: failed to reply to the chunk manifest" << endl;
+			return false;
+		}
+		return true;
+	}
+
+	/// Create the folders of the file path unless they have already been created.
+	bool create_parent_folders(const string& filepath)
+	{
+		const size_t last_delim = filepath.find_last_of("/\\");
+		const string dir        = last_delim == string::npos ? string() : filepath.substr(0, last_delim);
+		if (m_created_dirs.count(dir))
+			return true;
+
+		if (!create_subfolders(filepath))
+		{
+			cerr << "Download: failed creating folders for '" << filepath << "'" << endl;
+			return false;
+		}
+		m_created_dirs.insert(dir);
+		return true;
+	}
+
+	/// Write the small files of a packed segment.
+	/// @returns false if the transfer can't be continued.
+	bool unpack_files(const rx_segment& seg)
+	{
+		if (m_file)
+		{
+			cerr << m_download_str << ": incomplete, next file started." << endl;
+			flush_block();
+			m_file.reset();
+		}
+
+		const char* data      = seg.buf.data();
+		size_t      pos       = 1;
+		size_t      num_files = 0;
+		uint64_t    bytes     = 0;
+		while (pos < seg.len)
+		{
+			const size_t name_size = pos + 6 <= seg.len ? file::get_uint16(data + pos) : 0;
+			const size_t file_size = pos + 6 <= seg.len ? file::get_uint32(data + pos + 2) : 0;
+			if (pos + 6 > seg.len || pos + 6 + name_size + file_size > seg.len)
+			{
+				cerr << "Download: malformed packed segment" << endl;
+				return false;
+			}
+
+			const string filepath = m_dstpath + string(data + pos + 6, name_size);
+			if (!create_parent_folders(filepath))
+				return false;
+
+			output_file ofile(filepath, 0, false);
+			const auto  t_start = steady_clock::now();
+			const bool  ok      = ofile.is_open() && ofile.write(0, data + pos + 6 + name_size, file_size);
 			ofile.close();
-			// extranct the filename from the received buffer
-			const string filename = string(buf.data() + 1);
-			const string filepath = dstpath + filename;
-			hdr_size += filename.size() + 1;    // 1 for null character
+			inc(m_write_us, duration_cast<microseconds>(steady_clock::now() - t_start).count());
+			if (!ok)
+			{
+				cerr << "Download: error writing file " << filepath << endl;
+				return false;
+			}
+
+			pos += 6 + name_size + file_size;
+			bytes += file_size;
+			++num_files;
+		}
+
+		m_bytes_received += bytes;
+		cerr << "Unpacked " << num_files << " files (" << bytes / 1024 << " kB)." << endl;
+		return true;
+	}
+
+	/// @returns false if the transfer can't be continued.
+	bool write_segment(const rx_segment& seg)
+	{
+		const char* data  = seg.buf.data();
+		const auto  flags = static_cast<uint8_t>(data[0]);
+		size_t      hdr_size = 1;
+		const auto  tnow     = steady_clock::now();
+
+		if (flags & file::SEG_MANIFEST)
+			return reply_manifest(seg);
+
+		if (flags & file::SEG_PACKED)
+			return unpack_files(seg);
+
+		if (flags & file::SEG_FIRST)
+		{
+			if (m_file)
+			{
+				cerr << m_download_str << ": incomplete, next file started." << endl;
+				flush_block();
+				m_file.reset();
+			}
 
-			if (!create_subfolders(filepath))
+			// extract the filename from the received buffer
+			const char* name_end = static_cast<const char*>(memchr(data + 1, '\0', seg.len - 1));
+			if (!name_end)
 			{
-				cerr << "Download: failed creating folders for '" << filepath << "'" << endl;
+				cerr << "Download: malformed first segment of a file" << endl;
 				return false;
 			}
+			const string filename(data + 1, name_end);
+			hdr_size += filename.size() + 1; // 1 for null character
+
+			uint64_t expected_size = 0;
+			if (flags & file::SEG_SIZE)
+			{
+				if (seg.len < hdr_size + 8)
+				{
+					cerr << "Download: malformed first segment of '" << filename << "'" << endl;
+					return false;
+				}
+				expected_size = file::get_uint64(data + hdr_size);
+				hdr_size += 8;
+			}
 
-			ofile.open(filepath.c_str(), ios::out | ios::trunc | ios::binary);
-			if (!ofile) {
+			const string filepath = m_dstpath + filename;
+			if (!create_parent_folders(filepath))
+				return false;
+
+			// Segments with offsets update the file left by a previous transfer.
+			m_file.reset(new output_file(filepath, expected_size, (flags & file::SEG_OFFSET) != 0));
+			if (!m_file->is_open())
+			{
 				cerr << "Download: error opening file " << filepath << endl;
-				break;
+				m_file.reset();
+				return false;
 			}
 
-			download_str = "Downloading '" + filename + "'";
-			cerr << download_str << "\r";
-			time_start = time_progress = tnow;
-			file_size = 0;
+			m_download_str = "Downloading '" + filename + "'";
+			if (m_print_progress)
+				cerr << m_download_str << "\r";
+			m_time_start = m_time_progress = tnow;
+			m_file_size        = 0;
+			m_block_offset     = 0;
+			m_blocked_us_start = blocked_us();
+			// A file received from the start is hashed as it is received,
+			// a resumed file is hashed from disk once complete.
+			m_filepath    = filepath;
+			m_hash        = file::hash64();
+			m_hash_stream = (flags & file::SEG_OFFSET) == 0;
 		}
 
-		if (!ofile)
+		if (!m_file)
 		{
 			cerr << "Download: file is closed while data is received: first packet missed?\n";
-			continue;
+			return true;
 		}
 
-		ofile.write(buf.data() + hdr_size, bytes - hdr_size);
-		file_size += bytes - hdr_size;
+		if (flags & file::SEG_OFFSET)
+		{
+			if (seg.len < hdr_size + 8)
+			{
+				cerr << m_download_str << ": malformed segment" << endl;
+				return false;
+			}
+
+			// Start a new block if the payload does not continue the collected one.
+			const uint64_t offset = file::get_uint64(data + hdr_size);
+			hdr_size += 8;
+			if (offset != m_block_offset + m_block_len)
+			{
+				if (!flush_block())
+					return false;
+				m_block_offset = offset;
+			}
+		}
+
+		const size_t hash_size = (flags & file::SEG_HASH) ? 8 : 0;
+		if (seg.len < hdr_size + hash_size)
+		{
+			cerr << m_download_str << ": malformed segment" << endl;
+			return false;
+		}
+
+		const size_t payload_size = seg.len - hdr_size - hash_size;
+		if (m_hash_stream)
+			m_hash.update(data + hdr_size, payload_size);
+		for (size_t pos = 0; pos < payload_size;)
+		{
+			const size_t n = min(payload_size - pos, m_block_size - m_block_len);
+			memcpy(m_block.get() + m_block_len, data + hdr_size + pos, n);
+			m_block_len += n;
+			pos += n;
+			if (m_block_len == m_block_size && !flush_block())
+				return false;
+		}
+		m_file_size += payload_size;
+		m_bytes_received += payload_size;
 
 		auto get_rate_kbps = [](steady_clock::time_point t_start, steady_clock::time_point t_now, size_t bytes) {
 			const auto delta_us = chrono::duration_cast<chrono::microseconds>(t_now - t_start).count();
@@ -138,77 +566,249 @@ bool receive_files(socket::srt& src, const string& dstpath
 			return rate_kbps;
 		};
 
-		
-		if (chrono::steady_clock::now() >= time_progress + 1s)
+		if (m_print_progress && tnow >= m_time_progress + 1s)
 		{
-			const size_t rate_kbps = get_rate_kbps(time_start, tnow, file_size);
-			cerr << download_str << ": " << file_size / 1024 << " kB @ " << rate_kbps << " kbps...\r";
-			time_progress = tnow;
+			const size_t rate_kbps = get_rate_kbps(m_time_start, tnow, m_file_size);
+			cerr << m_download_str << ": " << m_file_size / 1024 << " kB @ " << rate_kbps << " kbps...\r";
+			m_time_progress = tnow;
 		}
 
-		if (is_eof)
+		if (flags & file::SEG_EOF)
 		{
-			ofile.close();
-			const size_t rate_kbps = get_rate_kbps(time_start, tnow, file_size);
-			const auto delta_ms = chrono::duration_cast<chrono::milliseconds>(tnow - time_start).count();
-			cerr << download_str << ": done (" << file_size / 1024 << " kB @ " << rate_kbps << " kbps, took "
-				<< delta_ms / 1000.0 << " sec)." << endl;
+			if (!flush_block())
+				return false;
+			m_file.reset();
+
+			const size_t rate_kbps = get_rate_kbps(m_time_start, tnow, m_file_size);
+			const auto delta_ms = chrono::duration_cast<chrono::milliseconds>(tnow - m_time_start).count();
+			string verified;
+			if (hash_size)
+			{
+				uint64_t   file_hash = m_hash.digest();
+				const bool hashed    = m_hash_stream || file::hash_file(m_filepath, file_hash);
+				const bool match     = hashed && file_hash == file::get_uint64(data + hdr_size + payload_size);
+				inc(match ? m_verified : m_mismatched, 1);
+				verified = match ? ", hash OK" : ", HASH MISMATCH";
+			}
+
+			cerr << m_download_str << ": done (" << m_file_size / 1024 << " kB @ " << rate_kbps << " kbps, took "
+				<< delta_ms / 1000.0 << " sec, network blocked by disk " << (blocked_us() - m_blocked_us_start) / 1000
+				<< " ms" << verified << ")." << endl;
 		}
+
+		return true;
 	}
 
-	return true;
-}
+	/// Write the collected payload to the file.
+	bool flush_block()
+	{
+		if (m_block_len == 0)
+			return true;
+
+		const auto t_start = steady_clock::now();
+		const bool ok      = m_file->write(m_block_offset, m_block.get(), m_block_len);
+		inc(m_write_us, duration_cast<microseconds>(steady_clock::now() - t_start).count());
+		m_block_offset += m_block_len;
+		m_block_len = 0;
+		if (!ok)
+			cerr << m_download_str << ": error writing to disk." << endl;
+		return ok;
+	}
 
+private:
+	const string                          m_dstpath;
+	spsc_ring<rx_segment>                 m_ring;
+	const size_t                          m_block_size;
+	unique_ptr<char, void (*)(char*)>     m_block;
+	size_t                                m_block_len = 0;
+	uint64_t                              m_block_offset = 0; // File offset of the collected payload.
+	atomic<uint64_t>&                     m_bytes_received;
+	const bool                            m_print_progress;
+	const reply_fn                        m_reply;
+	atomic_bool                           m_stop{false};
+	atomic_bool                           m_failed{false};
+	atomic<uint64_t>                      m_blocked_us{0};
+	atomic<uint64_t>                      m_write_us{0};
+	atomic<uint64_t>                      m_verified{0};
+	atomic<uint64_t>                      m_mismatched{0};
+
+	// Accessed by the writer thread only.
+	unique_ptr<output_file>               m_file;
+	unordered_set<string>                 m_created_dirs;
+	string                                m_download_str;
+	string                                m_filepath;
+	steady_clock::time_point              m_time_start;
+	steady_clock::time_point              m_time_progress;
+	size_t                                m_file_size        = 0;
+	file::hash64                          m_hash;
+	bool                                  m_hash_stream      = false;
+	uint64_t                              m_blocked_us_start = 0;
+
+	thread                                m_writer;
+};
+
+/// Reports disk write times to the stats file along with the socket statistics.
+class receive_stats_report : public socket::stats_extension
+{
+public:
+	explicit receive_stats_report(shared_ptr<const segment_writer> writer)
+		: m_writer(std::move(writer))
+	{
+	}
 
+public:
+	const string stats_to_csv(bool print_header) final
+	{
+		if (print_header)
+			return "usDiskBlocked,usDiskWrite";
 
-void start_filereceiver(future<shared_srt> connection, const config& cfg,
-	const atomic_bool& force_break)
+		const auto s = next_interval();
+		stringstream ss;
+		ss << s[0] << ',' << s[1];
+		return ss.str();
+	}
+
+	const nlohmann::json stats_to_json() final
+	{
+		const auto s = next_interval();
+		nlohmann::json root;
+		root["usDiskBlocked"] = s[0];
+		root["usDiskWrite"]   = s[1];
+		return root;
+	}
+
+	const char* json_key() const final { return "FileReceiveStats"; }
+
+private:
+	array<uint64_t, 2> next_interval()
+	{
+		const array<uint64_t, 2> curr = {m_writer->blocked_us(), m_writer->write_us()};
+		const array<uint64_t, 2> s    = {curr[0] - m_prev[0], curr[1] - m_prev[1]};
+		m_prev = curr;
+		return s;
+	}
+
+private:
+	shared_ptr<const segment_writer> m_writer;
+	array<uint64_t, 2>               m_prev = {};
+};
+
+} // namespace
+
+
+/// Receive files over one connection. Received segments are written to disk by the writer.
+/// @return true on success, false if writing to disk failed
+bool receive_files(socket::srt& src, segment_writer& writer, const atomic_bool& force_break)
 {
-	if (!connection.valid())
+	while (!force_break)
 	{
-		cerr << "Error: Unexpected socket creation failure!" << endl;
-		return;
+		rx_segment* seg = writer.free_segment(force_break);
+		if (!seg)
+			break;
+
+		seg->len = src.read(mutable_buffer(seg->buf.data(), seg->buf.size()), -1);
+		if (seg->len == 0)
+			continue;
+
+		writer.push();
 	}
 
-	const shared_srt sock = connection.get();
-	if (!sock)
+	return !writer.failed();
+}
+
+
+void start_filereceiver(const vector<shared_srt>& conns, const config& cfg,
+	const atomic_bool& force_break)
+{
+	const bool write_stats = cfg.stats_file != "" && cfg.stats_freq_ms > 0;
+	unique_ptr<socket::stats_writer> stats;
+	try
 	{
-		cerr << "Error: Unexpected socket connection failure!" << endl;
-		return;
+		if (write_stats)
+			stats.reset(new socket::stats_writer(cfg.stats_file, cfg.stats_format, milliseconds(cfg.stats_freq_ms)));
+	}
+	catch (const socket::exception& e)
+	{
+		cerr << "ERROR: " << e.what() << ". No stats output.\n";
 	}
 
-	atomic_bool local_break(false);
+	cerr << "Downloading to '" << cfg.dst_path << endl;
 
-	auto stats_func = [&cfg, &force_break, &local_break](shared_srt sock) {
-		if (cfg.stats_freq_ms == 0)
-			return;
-		if (cfg.stats_file.empty())
+	const auto       time_start = steady_clock::now();
+	atomic<uint64_t> bytes_received(0);
+	vector<shared_ptr<segment_writer>> writers;
+	for (size_t i = 0; i < conns.size(); ++i)
+	{
+		try
+		{
+			// Replies are sent by the writer thread while the receiving thread may be waiting for the socket
+			// to become readable, so the message is sent directly, not waiting on the socket's epoll.
+			auto reply = [sock = conns[i]](const const_buffer& msg) {
+				return srt_sendmsg2(sock->id(), static_cast<const char*>(msg.data()), static_cast<int>(msg.size()), nullptr)
+					== static_cast<int>(msg.size());
+			};
+			writers.push_back(make_shared<segment_writer>(cfg.dst_path, cfg.segment_size, cfg.write_queue > 0 ? cfg.write_queue : 1,
+				cfg.write_block, bytes_received, conns.size() == 1, reply));
+		}
+		catch (const socket::exception& e)
+		{
+			cerr << e.what() << endl;
 			return;
+		}
 
-		ofstream logfile_stats(cfg.stats_file.c_str());
-		if (!logfile_stats)
+		if (stats)
 		{
-			cerr << "ERROR: Can't open '" << cfg.stats_file << "' for writing stats. No output.\n";
-			return;
+			stats->add_socket(conns[i]);
+			stats->add_extension(conns[i]->id(), make_shared<receive_stats_report>(writers[i]));
 		}
+	}
 
-		bool               print_header = true;
-		const milliseconds interval(cfg.stats_freq_ms);
-		while (!force_break && !local_break)
+	vector<future<void>> streams;
+	for (size_t i = 0; i < conns.size(); ++i)
+	{
+		streams.push_back(async(launch::async, [&, i]() {
+			try
+			{
+				receive_files(*conns[i], *writers[i], force_break);
+			}
+			catch (const socket::exception& e)
+			{
+				cerr << "Stream " << i << ": " << e.what() << endl;
+			}
+			writers[i]->close();
+		}));
+	}
+
+	// Aggregate progress of all the streams.
+	for (auto& s : streams)
+	{
+		while (s.wait_for(1s) == future_status::timeout)
 		{
-			this_thread::sleep_for(interval);
+			if (conns.size() == 1)
+				continue;
 
-			logfile_stats << sock->get_statistics(cfg.stats_format, print_header) << flush;
-			print_header = false;
+			const auto   delta_us  = duration_cast<microseconds>(steady_clock::now() - time_start).count();
+			const size_t rate_kbps = (bytes_received * 1000) / (delta_us ? delta_us : 1) * 8;
+			cerr << "Received " << bytes_received / 1024 << " kbytes over " << conns.size() << " streams @ "
+				<< rate_kbps << " kbps...\r";
 		}
-	};
-	auto stats_logger = async(launch::async, stats_func, sock);
+	}
 
-	vector<char> buf(cfg.segment_size);
-	receive_files(*sock.get(), cfg.dst_path, buf, force_break);
+	uint64_t blocked_us = 0, write_us = 0, verified = 0, mismatched = 0;
+	for (const auto& w : writers)
+	{
+		blocked_us += w->blocked_us();
+		write_us += w->write_us();
+		verified += w->verified();
+		mismatched += w->mismatched();
+	}
 
-	local_break = true;
-	stats_logger.wait();
+	const auto elapsed_ms = duration_cast<milliseconds>(steady_clock::now() - time_start).count();
+	cerr << "Received " << bytes_received / 1024 << " kbytes over " << conns.size() << " stream(s) in " << elapsed_ms
+		<< " ms: network blocked by disk " << blocked_us / 1000 << " ms, disk write " << write_us / 1000 << " ms";
+	if (verified || mismatched)
+		cerr << ", " << verified << " files verified, " << mismatched << " hash mismatches";
+	cerr << endl;
 }
 
 
@@ -220,12 +820,9 @@ void xtransmit::file::receive::run(const string& src_url, const config& cfg, con
 	if (!ut["rcvbuf"].exists())
 		ut["rcvbuf"] = to_string(cfg.segment_size * 10);
 
-	shared_srt socket = make_shared<socket::srt>(ut);
-	const bool accept = socket->mode() == socket::srt::LISTENER;
 	try
 	{
-		start_filereceiver(accept ? socket->async_accept() : socket->async_connect()
-			, cfg, force_break);
+		start_filereceiver(file::connect_streams(ut, cfg.streams > 0 ? cfg.streams : 1), cfg, force_break);
 	}
 	catch (const socket::exception & e)
 	{
@@ -243,6 +840,9 @@ CLI::App* xtransmit::file::receive::add_subcommand(CLI::App& app, config& cfg, s
 	sc_file_recv->add_option("src", src_url, "Source URI");
 	sc_file_recv->add_option("dst", cfg.dst_path, "Destination path to file/folder");
 	sc_file_recv->add_option("--segment", cfg.segment_size, "Size of the transmission segment");
+	sc_file_recv->add_option("--write-queue", cfg.write_queue, "Number of received segments waiting to be written to disk");
+	sc_file_recv->add_option("--write-block", cfg.write_block, "Size of a write to disk (rounded up to 4096 bytes)");
+	sc_file_recv->add_option("--streams", cfg.streams, "Number of concurrent SRT connections to receive files over");
 	sc_file_recv->add_option("--statsfile", cfg.stats_file, "output stats report filename");
 	sc_file_recv->add_option("--statsformat", cfg.stats_format, "output stats report format (json, csv)");
 	sc_file_recv->add_option("--statsfreq", cfg.stats_freq_ms, "output stats report frequency (ms)")
@@ -14,6 +14,9 @@ namespace xtransmit::file::receive
 	{
 		std::string dst_path;
 		size_t      segment_size = 1456 * 1000;
+		size_t      streams = 1;	// Number of concurrent connections
+		size_t      write_queue = 16;	// Number of received segments waiting to be written to disk
+		size_t      write_block = 4 * 1024 * 1024;	// Size of a write to disk
 		int stats_freq_ms = 0;
 		std::string stats_file;
 		std::string stats_format = "csv";
@@ -4,14 +4,26 @@
 // https://en.cppreference.com/w/cpp/compiler_support
 #include <filesystem>	// Requires C++17
 #include <functional>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <string>
 #include <vector>
 #include <deque>
 #include <chrono>
+#include <cstring>
 #include <thread>
 
+#include "file-common.hpp"
 #include "file-send.hpp"
+#include "socket_stats.hpp"
+#include "spsc_ring.hpp"
 #include "srt_socket.hpp"
+#include "xtr_defs.hpp"
+
+// nlohmann_json
+#include <nlohmann/json.hpp>
 
 
 using namespace std;
@@ -23,84 +35,715 @@ namespace fs = std::filesystem;
 
 using shared_srt = std::shared_ptr<socket::srt>;
 
+const string relative_path(const string& filepath, const string& dirpath);
 
-/// Send one file in the messaging mode.
-/// @return true on success, false if an error happened during transmission
-bool send_file(const string &filename, const string &upload_name, socket::srt &dst
-	, vector<char> &buf, const atomic_bool& force_break)
+
+namespace
+{
+
+/// A segment of a file read ahead of sending.
+/// The buffer holds the complete message: the header followed by the payload.
+struct file_segment
+{
+	vector<char> buf;
+	size_t       hdr_size = 0; // Header bytes in front of the payload.
+	size_t       len      = 0; // Payload bytes.
+	size_t       file_idx = 0; // Index of the file in the list being sent.
+	uint8_t      flags    = 0; // Segment header flags (file::segment_flags).
+	size_t       trailer_size = 0; // Bytes after the payload (the file hash).
+	vector<size_t> packed_files;   // Packed segment: the indices of the files in the segment.
+	vector<size_t> skipped_files;  // Packed segment: the files that failed to open or to read, not in the segment.
+	size_t       packed_bytes = 0; // Packed segment: file bytes (without the index entries).
+	bool         failed   = false; // Failed to open or to read the file.
+
+	bool is_first() const { return (flags & file::SEG_FIRST) != 0; }
+	bool is_eof() const { return (flags & file::SEG_EOF) != 0; }
+	bool is_manifest() const { return (flags & file::SEG_MANIFEST) != 0; }
+	bool is_packed() const { return (flags & file::SEG_PACKED) != 0; }
+};
+
+/// Reads files segment by segment in a dedicated thread, keeping several segments in flight,
+/// so that the sending thread does not wait on disk while there is data to send.
+class read_ahead
 {
-	ifstream ifile(filename, ios::binary);
-	if (!ifile)
+public:
+	/// A file to read: the path on disk and the name to upload it with.
+	struct file_item
 	{
-		cerr << "Error opening file : " << filename << endl;
-		return false;
+		size_t idx;
+		string path;
+		string upload_name;
+	};
+
+	/// Provides the next file to read, returns false if there are no more files.
+	using file_source = function<bool(file_item&)>;
+
+	/// @param chunk_size      resumable mode: announce files with a manifest of chunks of this size
+	///                        and read only the chunks missing on the receiver (0 - send whole files)
+	/// @param pack_threshold  packing mode: files up to this size are packed several in a segment (0 - no packing)
+	/// @param verify          send the hash of a file in its last segment
+	read_ahead(file_source source, size_t segment_size, size_t depth, uint64_t chunk_size, uint64_t pack_threshold,
+		bool verify, const atomic_bool& force_break)
+		: m_source(std::move(source))
+		, m_ring(depth, file_segment{vector<char>(segment_size)})
+		, m_segment_size(segment_size)
+		, m_chunk_size(chunk_size)
+		, m_pack_threshold(pack_threshold)
+		, m_verify(verify)
+		, m_force_break(force_break)
+	{
+		m_reader = thread(&read_ahead::reader_loop, this);
 	}
 
-	const chrono::steady_clock::time_point time_start = chrono::steady_clock::now();
-	size_t file_size = 0;
+	~read_ahead() { stop(); }
+
+	/// Stop reading and wait for the reading thread to exit.
+	void stop()
+	{
+		m_stop = true;
+		m_ring.notify();
+		if (m_reader.joinable())
+			m_reader.join();
+	}
 
-	cerr << "Transmitting '" << filename << " to " << upload_name << endl;
+	/// The next segment to send. Waits if the reader is behind (disk wait).
+	/// @returns nullptr if all the files have been read or the transfer is interrupted.
+	file_segment* next()
+	{
+		file_segment* seg = m_ring.front();
+		if (seg)
+			return seg;
+
+		const auto t_start = steady_clock::now();
+		while (!m_force_break)
+		{
+			seg = m_ring.front();
+			if (seg || m_done)
+				break;
+			m_ring.wait([this]() { return m_ring.front() != nullptr || m_done || m_force_break; }, milliseconds(100));
+		}
+		inc(m_disk_wait_us, duration_cast<microseconds>(steady_clock::now() - t_start).count());
+		return m_ring.front();
+	}
 
-	/*   1 byte      string    1 byte
-	 * ------------------------------------------------
-	 * | ......EF | Filename | 0     | Payload
-	 * ------------------------------------------------
-	 * E - enf of file flag
-	 * F - frist sefment of a file (flag)
-	 * We add +2 to include the first byte and the \0-character
-	 */
-	int hdr_size = snprintf(buf.data() + 1, buf.size(), "%s", upload_name.c_str()) + 2;
+	/// Release the segment returned by next().
+	void pop() { m_ring.pop(); }
 
-	while (!force_break)
+	/// Pass the receiver's reply to the last manifest: the chunks the receiver already has.
+	void set_present(vector<bool> present) { m_present.set_value(std::move(present)); }
+
+	/// Time the sending thread waited for the disk (no segment was read yet).
+	uint64_t disk_wait_us() const { return m_disk_wait_us.load(memory_order_relaxed); }
+	/// Time the reading thread waited for the network (all segments were waiting to be sent).
+	uint64_t reader_wait_us() const { return m_reader_wait_us.load(memory_order_relaxed); }
+
+private:
+	/// A range of a file to read: [begin, end).
+	using file_range = pair<uint64_t, uint64_t>;
+
+	static void inc(atomic<uint64_t>& counter, uint64_t val)
+	{
+		counter.store(counter.load(memory_order_relaxed) + val, memory_order_relaxed);
+	}
+
+	file_segment* free_slot()
 	{
-		const int n = (int)ifile.read(buf.data() + hdr_size, streamsize(buf.size() - hdr_size)).gcount();
-		const bool is_eof = ifile.eof();
-		const bool is_start = hdr_size > 1;
-		buf[0] = (is_eof ? 2 : 0) | (is_start ? 1 : 0);
+		file_segment* seg = m_ring.free_slot();
+		if (seg)
+			return seg;
 
-		size_t shift = 0;
-		while (n > 0)
+		const auto t_start = steady_clock::now();
+		while (!m_stop && !m_force_break)
 		{
-			const int st = dst.write(const_buffer(buf.data() + shift, n + hdr_size));
-			if (st == 0)
-				continue;
+			seg = m_ring.free_slot();
+			if (seg)
+				break;
+			m_ring.wait([this]() { return m_ring.free_slot() != nullptr || m_stop || m_force_break; }, milliseconds(100));
+		}
+		inc(m_reader_wait_us, duration_cast<microseconds>(steady_clock::now() - t_start).count());
+		return seg;
+	}
 
-			file_size += n;
+	void reader_loop()
+	{
+		XTR_THREADNAME(std::string("XTR:ReadAhead"));
+		file_item item;
+		while (!m_stop && !m_force_break && m_source(item))
+		{
+			ifstream ifile(item.path, ios::binary);
+			// The size lets the receiver preallocate the file.
+			error_code     ec;
+			const uint64_t file_size = fs::file_size(item.path, ec);
+			const bool     has_size  = !ec;
 
-			if (st == SRT_ERROR)
+			// A small file is appended to the packed segment. The index entry and the name
+			// are stored in front of the payload, and the file must fit into one segment.
+			const size_t pack_entry_size = 6 + item.upload_name.size() + (has_size ? file_size : 0);
+			if (m_pack_threshold > 0 && has_size && file_size <= m_pack_threshold
+				&& item.upload_name.size() <= numeric_limits<uint16_t>::max() && 1 + pack_entry_size <= m_segment_size)
 			{
-				cerr << "Upload: SRT error: " << srt_getlasterror_str() << endl;
-				return false;
+				if (!pack_file(ifile, item, file_size))
+					return;
+				continue;
 			}
-			if (st != n + hdr_size)
-			{
-				cerr << "Upload error: not full delivery" << endl;
+
+			if (!push_pack())
+				return;
+
+			vector<file_range> ranges = {{0, numeric_limits<uint64_t>::max()}};
+			const bool resume = m_chunk_size > 0 && has_size && ifile;
+			m_has_file_hash   = false;
+			if (resume && !exchange_manifest(item, file_size, ranges))
+				return;
+
+			if (!read_ranges(ifile, item, has_size ? &file_size : nullptr, resume, ranges))
+				return;
+		}
+
+		if (!push_pack())
+			return;
+
+		m_done = true;
+		m_ring.notify();
+	}
+
+	/// Append a small file to the packed segment.
+	/// A file that fails to open or to read is skipped and reported with the segment.
+	/// @returns false if interrupted
+	bool pack_file(ifstream& ifile, const file_item& item, uint64_t file_size)
+	{
+		const size_t name_size  = item.upload_name.size();
+		const size_t entry_size = 6 + name_size + file_size;
+		if (m_pack && m_pack->hdr_size + m_pack->len + entry_size > m_pack->buf.size() && !push_pack())
+			return false;
+
+		if (!m_pack)
+		{
+			m_pack = free_slot();
+			if (!m_pack)
+				return false;
+			m_pack->file_idx  = item.idx;
+			m_pack->flags     = file::SEG_PACKED;
+			m_pack->hdr_size  = 1;
+			m_pack->len       = 0;
+			m_pack->trailer_size = 0;
+			m_pack->packed_files.clear();
+			m_pack->skipped_files.clear();
+			m_pack->packed_bytes = 0;
+			m_pack->failed    = false;
+			m_pack->buf[0]    = static_cast<char>(file::SEG_PACKED);
+		}
+
+		char* entry = m_pack->buf.data() + m_pack->hdr_size + m_pack->len;
+		file::put_uint16(entry, static_cast<uint16_t>(name_size));
+		file::put_uint32(entry + 2, static_cast<uint32_t>(file_size));
+		memcpy(entry + 6, item.upload_name.data(), name_size);
+		if (!ifile || (file_size > 0 && (size_t)ifile.read(entry + 6 + name_size, streamsize(file_size)).gcount() != file_size))
+		{
+			// The entry is overwritten by the next file.
+			m_pack->skipped_files.push_back(item.idx);
+			return true;
+		}
+
+		m_pack->len += entry_size;
+		m_pack->packed_bytes += file_size;
+		m_pack->packed_files.push_back(item.idx);
+		return true;
+	}
+
+	/// Pass the packed segment for sending.
+	/// @returns false if interrupted
+	bool push_pack()
+	{
+		if (m_pack)
+		{
+			m_ring.push();
+			m_pack = nullptr;
+		}
+		return !m_stop && !m_force_break;
+	}
+
+	/// Send the chunk manifest of the file and wait for the receiver's reply.
+	/// @param ranges  [out] the ranges of the file missing on the receiver
+	/// @returns false if interrupted
+	bool exchange_manifest(const file_item& item, uint64_t file_size, vector<file_range>& ranges)
+	{
+		file_segment* seg = free_slot();
+		if (!seg)
+			return false;
+
+		const size_t name_size = item.upload_name.size() + 1;
+		const size_t hdr_size  = 1 + name_size + 8 + 8;
+		if (hdr_size + 8 > seg->buf.size())
+			return true; // The name does not fit into a segment: send the whole file.
+
+		// Increase the chunk size for the hashes to fit into one segment.
+		const uint64_t max_chunks = (seg->buf.size() - hdr_size) / 8;
+		uint64_t       chunk_size = m_chunk_size;
+		while ((file_size + chunk_size - 1) / chunk_size > max_chunks)
+			chunk_size *= 2;
+
+		// The hash of the whole file is computed in the same pass to verify the resumed file.
+		const vector<uint64_t> hashes = file::hash_chunks(item.path, file_size, chunk_size, m_verify ? &m_file_hash : nullptr);
+		m_has_file_hash = m_verify && hashes.size() == (file_size + chunk_size - 1) / chunk_size;
+
+		char* hdr = seg->buf.data();
+		hdr[0]    = static_cast<char>(file::SEG_MANIFEST);
+		memcpy(hdr + 1, item.upload_name.c_str(), name_size);
+		file::put_uint64(hdr + 1 + name_size, file_size);
+		file::put_uint64(hdr + 1 + name_size + 8, chunk_size);
+		for (size_t i = 0; i < hashes.size(); ++i)
+			file::put_uint64(hdr + hdr_size + 8 * i, hashes[i]);
+
+		seg->file_idx = item.idx;
+		seg->flags    = file::SEG_MANIFEST;
+		seg->hdr_size = hdr_size;
+		seg->len      = 8 * hashes.size();
+		seg->trailer_size = 0;
+		seg->failed   = false;
+
+		m_present   = promise<vector<bool>>();
+		auto future = m_present.get_future();
+		m_ring.push();
+
+		while (future.wait_for(milliseconds(100)) == future_status::timeout)
+		{
+			if (m_stop || m_force_break)
 				return false;
+		}
+
+		// Merge adjacent missing chunks into ranges.
+		const vector<bool> present = future.get();
+		ranges.clear();
+		for (size_t i = 0; i * chunk_size < file_size; ++i)
+		{
+			if (i < present.size() && present[i])
+				continue;
+
+			const uint64_t begin = i * chunk_size;
+			const uint64_t end   = min(begin + chunk_size, file_size);
+			if (!ranges.empty() && ranges.back().second == begin)
+				ranges.back().second = end;
+			else
+				ranges.emplace_back(begin, end);
+		}
+
+		return true;
+	}
+
+	/// Read the ranges of the file into segments.
+	/// @param file_size  the size of the file if known
+	/// @param resume     segments carry the offset of the payload and update the receiver's file
+	/// @returns false if interrupted
+	bool read_ranges(ifstream& ifile, const file_item& item, const uint64_t* file_size, bool resume,
+		const vector<file_range>& ranges)
+	{
+		bool is_first = true;
+		// Only the missing chunks of a resumed file are read: the hash of the whole file
+		// is computed with the chunk manifest.
+		const bool   verify      = m_verify && (!resume || m_has_file_hash);
+		const size_t hash_size   = verify ? 8 : 0;
+		file::hash64 hash;
+		// A file that is already complete on the receiver is sent as a single empty segment.
+		const vector<file_range> empty_range = {{file_size ? *file_size : 0, file_size ? *file_size : 0}};
+		const auto& to_read = ranges.empty() ? empty_range : ranges;
+
+		for (size_t r = 0; r < to_read.size(); ++r)
+		{
+			uint64_t pos = to_read[r].first;
+			if (resume)
+				ifile.seekg(streamoff(pos));
+
+			for (bool range_end = false; !range_end;)
+			{
+				file_segment* seg = free_slot();
+				if (!seg)
+					return false;
+
+				// See file-common.hpp for the segment format.
+				const size_t name_size = item.upload_name.size() + 1;
+				size_t hdr_size = 1 + (is_first ? name_size + (file_size ? 8 : 0) : 0) + (resume ? 8 : 0);
+
+				seg->file_idx = item.idx;
+				seg->hdr_size = hdr_size;
+				seg->failed   = !ifile || hdr_size + hash_size >= seg->buf.size(); // Or the name does not fit into a segment.
+				seg->len      = 0;
+				seg->trailer_size = 0;
+				if (!seg->failed)
+				{
+					// Space for the hash is reserved after the payload, as the end of file is not known in advance.
+					const uint64_t max_len = min<uint64_t>(seg->buf.size() - hdr_size - hash_size, to_read[r].second - pos);
+					if (max_len > 0)
+						seg->len = (size_t)ifile.read(seg->buf.data() + hdr_size, streamsize(max_len)).gcount();
+					if (verify && !resume)
+						hash.update(seg->buf.data() + hdr_size, seg->len);
+					seg->failed = !ifile.good() && !ifile.eof();
+					range_end   = ifile.eof() || pos + seg->len >= to_read[r].second;
+				}
+
+				const bool is_eof = seg->failed || (range_end && (r + 1 == to_read.size() || ifile.eof()));
+				seg->flags = (is_first ? file::SEG_FIRST : 0) | (is_first && file_size ? file::SEG_SIZE : 0)
+					| (resume ? file::SEG_OFFSET : 0) | (is_eof ? file::SEG_EOF : 0)
+					| (is_eof && verify && !seg->failed ? file::SEG_HASH : 0);
+
+				char* hdr = seg->buf.data();
+				hdr[0]    = static_cast<char>(seg->flags);
+				size_t hdr_pos = 1;
+				if (is_first && !seg->failed)
+				{
+					memcpy(hdr + hdr_pos, item.upload_name.c_str(), name_size);
+					hdr_pos += name_size;
+					if (file_size)
+					{
+						file::put_uint64(hdr + hdr_pos, *file_size);
+						hdr_pos += 8;
+					}
+				}
+				if (resume && !seg->failed)
+					file::put_uint64(hdr + hdr_pos, pos);
+				if (seg->flags & file::SEG_HASH)
+				{
+					file::put_uint64(seg->buf.data() + hdr_size + seg->len, resume ? m_file_hash : hash.digest());
+					seg->trailer_size = 8;
+				}
+
+				m_ring.push();
+				pos += seg->len;
+				is_first = false;
+				if (is_eof)
+					return true;
 			}
+		}
 
-			shift += st - hdr_size;
-			hdr_size = 1;
-			break;
+		return true;
+	}
+
+private:
+	file_source              m_source;
+	spsc_ring<file_segment>  m_ring;
+	const size_t             m_segment_size;
+	const uint64_t           m_chunk_size;
+	const uint64_t           m_pack_threshold;
+	const bool               m_verify;
+	file_segment*            m_pack = nullptr; // The packed segment being filled.
+	uint64_t                 m_file_hash     = 0;     // The hash of the whole resumed file.
+	bool                     m_has_file_hash = false; // m_file_hash is computed for the current file.
+	const atomic_bool&       m_force_break;
+	atomic_bool              m_stop{false};
+	atomic_bool              m_done{false};
+	atomic<uint64_t>         m_disk_wait_us{0};
+	atomic<uint64_t>         m_reader_wait_us{0};
+	promise<vector<bool>>    m_present;
+	thread                   m_reader;
+};
+
+/// Counters of a file sender. Updated by the sending thread.
+struct send_stats
+{
+	atomic<uint64_t> net_wait_us{0}; // Time spent in socket write calls.
+	atomic<uint64_t> bytes{0};       // Payload bytes sent.
+};
+
+/// Reports disk and network wait times to the stats file along with the socket statistics.
+class send_stats_report : public socket::stats_extension
+{
+public:
+	send_stats_report(shared_ptr<const send_stats> ss, shared_ptr<const read_ahead> reader)
+		: m_ss(std::move(ss))
+		, m_reader(std::move(reader))
+	{
+	}
+
+public:
+	const string stats_to_csv(bool print_header) final
+	{
+		if (print_header)
+			return "byteFilePayload,usDiskWait,usNetWait,usReaderWait";
+
+		const auto s = next_interval();
+		stringstream ss;
+		ss << s[0] << ',' << s[1] << ',' << s[2] << ',' << s[3];
+		return ss.str();
+	}
+
+	const nlohmann::json stats_to_json() final
+	{
+		const auto s = next_interval();
+		nlohmann::json root;
+		root["bytePayload"]  = s[0];
+		root["usDiskWait"]   = s[1];
+		root["usNetWait"]    = s[2];
+		root["usReaderWait"] = s[3];
+		return root;
+	}
+
+	const char* json_key() const final { return "FileSendStats"; }
+
+private:
+	array<uint64_t, 4> next_interval()
+	{
+		const array<uint64_t, 4> curr = {m_ss->bytes.load(memory_order_relaxed), m_reader->disk_wait_us(),
+			m_ss->net_wait_us.load(memory_order_relaxed), m_reader->reader_wait_us()};
+		array<uint64_t, 4> s;
+		for (size_t i = 0; i < s.size(); ++i)
+			s[i] = curr[i] - m_prev[i];
+		m_prev = curr;
+		return s;
+	}
+
+private:
+	shared_ptr<const send_stats> m_ss;
+	shared_ptr<const read_ahead> m_reader;
+	array<uint64_t, 4>           m_prev = {};
+};
+
+/// Files to send, shared by the streams. A stream takes the next file when it is done with its previous one.
+/// Shared by the file sources of the readers: a reader is also held by the stats writer and its thread
+/// can run until the stats writer is destroyed.
+class file_queue
+{
+public:
+	/// @param order        the indices of the files in the order to send them
+	/// @param num_streams  the number of streams taking files
+	file_queue(const vector<string>& filenames, const string& src_path, const vector<size_t>& order, size_t num_streams)
+		: m_filenames(filenames)
+		, m_src_path(src_path)
+		, m_queue(order.begin(), order.end())
+		, m_taken(num_streams)
+		, m_state(filenames.size(), QUEUED)
+	{
+	}
+
+	const string& filename(size_t idx) const { return m_filenames[idx]; }
+
+	/// Take the next file to read by the stream.
+	/// @returns false if there are no more files.
+	bool take(size_t stream, read_ahead::file_item& item)
+	{
+		lock_guard<mutex> lck(m_mtx);
+		if (m_queue.empty())
+			return false;
+		const size_t idx = m_queue.front();
+		m_queue.pop_front();
+		m_state[idx] = TAKEN;
+		m_taken[stream].push_back(idx);
+		item = {idx, m_filenames[idx], relative_path(m_filenames[idx], m_src_path)};
+		return true;
+	}
+
+	/// The file has been sent completely.
+	void sent(size_t idx) { set_state(idx, SENT); }
+
+	/// The file could not be read: it is not sent by any stream.
+	void failed(size_t idx) { set_state(idx, FAILED); }
+
+	/// Return the files taken but not sent by a failed stream to the front of the queue,
+	/// to be sent by the other streams. The reader of the stream must be stopped.
+	/// @returns the number of files returned.
+	size_t put_back(size_t stream)
+	{
+		lock_guard<mutex> lck(m_mtx);
+		size_t num_files = 0;
+		for (auto it = m_taken[stream].rbegin(); it != m_taken[stream].rend(); ++it)
+		{
+			if (m_state[*it] != TAKEN)
+				continue;
+			m_state[*it] = QUEUED;
+			m_queue.push_front(*it);
+			++num_files;
+		}
+		m_taken[stream].clear();
+		return num_files;
+	}
+
+	/// The files that have not been sent.
+	vector<size_t> not_sent() const
+	{
+		lock_guard<mutex> lck(m_mtx);
+		vector<size_t> idx;
+		for (size_t i = 0; i < m_state.size(); ++i)
+		{
+			if (m_state[i] != SENT)
+				idx.push_back(i);
+		}
+		return idx;
+	}
+
+private:
+	enum file_state
+	{
+		QUEUED,
+		TAKEN,
+		SENT,
+		FAILED
+	};
+
+	void set_state(size_t idx, file_state state)
+	{
+		lock_guard<mutex> lck(m_mtx);
+		m_state[idx] = state;
+	}
+
+private:
+	const vector<string>   m_filenames;
+	const string           m_src_path;
+	mutable mutex          m_mtx;
+	deque<size_t>          m_queue;
+	vector<vector<size_t>> m_taken; // Files taken by each stream.
+	vector<file_state>     m_state;
+};
+
+} // namespace
+
+
+/// Read the receiver's reply to a chunk manifest.
+/// @return the chunks the receiver already has
+vector<bool> read_manifest_reply(socket::srt& src, size_t max_size, const atomic_bool& force_break)
+{
+	vector<char> buf(max_size);
+	while (!force_break)
+	{
+		size_t bytes = 0;
+		try
+		{
+			bytes = src.read(mutable_buffer(buf.data(), buf.size()), -1);
+		}
+		catch (const socket::exception&)
+		{
+			// The receiving timeout expired, keep waiting while connected.
+			if (srt_getsockstate(src.id()) == SRTS_CONNECTED)
+				continue;
+			throw;
+		}
+
+		if (bytes == 0)
+			continue;
+
+		const uint64_t num_chunks = bytes >= 9 ? file::get_uint64(buf.data() + 1) : 0;
+		if (bytes < 9 || (buf[0] & file::SEG_MANIFEST) == 0 || 9 + (num_chunks + 7) / 8 > bytes)
+		{
+			cerr << "Upload: unexpected reply to the chunk manifest, sending the whole file" << endl;
+			return {};
 		}
 
-		if (is_eof)
+		vector<bool> present(num_chunks);
+		for (uint64_t i = 0; i < num_chunks; ++i)
+			present[i] = (buf[9 + i / 8] >> (i % 8)) & 1;
+		return present;
+	}
+
+	return {};
+}
+
+
+/// Send files in the messaging mode, segment by segment, as they are read ahead.
+/// @return true on success, false if an error happened during transmission
+bool send_files(read_ahead& reader, file_queue& files, socket::srt& dst, send_stats& ss,
+	const atomic_bool& force_break)
+{
+	chrono::steady_clock::time_point time_start;
+	size_t file_size = 0;
+	uint64_t disk_wait_start = 0, net_wait_start = 0;
+	size_t   file_idx = numeric_limits<size_t>::max();
+
+	while (!force_break)
+	{
+		file_segment* seg = reader.next();
+		if (!seg)
 			break;
 
-		if (!ifile.good())
+		const string& filename = files.filename(seg->file_idx);
+		// A file starts with the manifest in the resumable mode or with the first segment.
+		if (!seg->is_packed() && seg->file_idx != file_idx)
+		{
+			file_idx        = seg->file_idx;
+			time_start      = chrono::steady_clock::now();
+			file_size       = 0;
+			disk_wait_start = reader.disk_wait_us();
+			net_wait_start  = ss.net_wait_us.load(memory_order_relaxed);
+			cerr << "Transmitting '" << filename << endl;
+		}
+
+		if (seg->failed)
 		{
-			cerr << "ERROR while reading from file\n";
+			cerr << "Error opening or reading file : " << filename << endl;
+			files.failed(seg->file_idx);
 			return false;
 		}
-	}
 
-	const chrono::steady_clock::time_point time_end = chrono::steady_clock::now();
-	const auto delta_us = chrono::duration_cast<chrono::microseconds>(time_end - time_start).count();
+		if (seg->is_packed())
+		{
+			for (const size_t idx : seg->skipped_files)
+			{
+				cerr << "Error opening or reading file : " << files.filename(idx) << ", skipped" << endl;
+				files.failed(idx);
+			}
+
+			// All the files of the pack have been skipped.
+			if (seg->packed_files.empty())
+			{
+				reader.pop();
+				continue;
+			}
+		}
+
+		const char*  msg      = seg->buf.data();
+		const size_t msg_size = seg->hdr_size + seg->len + seg->trailer_size;
+		const auto   t_write  = steady_clock::now();
+		const int    st       = dst.write(const_buffer(msg, msg_size));
+		ss.net_wait_us.store(ss.net_wait_us.load(memory_order_relaxed)
+			+ duration_cast<microseconds>(steady_clock::now() - t_write).count(), memory_order_relaxed);
+
+		if (st == SRT_ERROR)
+		{
+			cerr << "Upload: SRT error: " << srt_getlasterror_str() << endl;
+			return false;
+		}
+		if (st != (int)msg_size)
+		{
+			cerr << "Upload error: not full delivery" << endl;
+			return false;
+		}
+
+		if (seg->is_manifest())
+		{
+			const size_t reply_size = seg->buf.size();
+			reader.pop();
+			reader.set_present(read_manifest_reply(dst, reply_size, force_break));
+			continue;
+		}
+
+		const size_t payload = seg->is_packed() ? seg->packed_bytes : seg->len;
+		ss.bytes.store(ss.bytes.load(memory_order_relaxed) + payload, memory_order_relaxed);
+		if (seg->is_packed())
+		{
+			for (const size_t idx : seg->packed_files)
+				files.sent(idx);
+			cerr << "--> sent " << seg->packed_files.size() << " packed files (" << payload / 1024 << " kbytes)" << endl;
+			reader.pop();
+			continue;
+		}
+
+		file_size += seg->len;
+		const bool is_eof = seg->is_eof();
+		reader.pop();
+
+		if (!is_eof)
+			continue;
+
+		files.sent(file_idx);
+
+		const chrono::steady_clock::time_point time_end = chrono::steady_clock::now();
+		const auto delta_us = chrono::duration_cast<chrono::microseconds>(time_end - time_start).count();
 
-	const size_t rate_kbps = (file_size * 1000) / (delta_us) * 8;
-	cerr << "--> done (" << file_size / 1024 << " kbytes transfered at " << rate_kbps << " kbps, took "
-		<< chrono::duration_cast<chrono::seconds>(time_end - time_start).count() << " s" << endl;
+		const size_t rate_kbps = (file_size * 1000) / (delta_us ? delta_us : 1) * 8;
+		cerr << "--> done (" << file_size / 1024 << " kbytes transfered at " << rate_kbps << " kbps, took "
+			<< chrono::duration_cast<chrono::seconds>(time_end - time_start).count() << " s, disk wait "
+			<< (reader.disk_wait_us() - disk_wait_start) / 1000 << " ms, network wait "
+			<< (ss.net_wait_us.load(memory_order_relaxed) - net_wait_start) / 1000 << " ms)" << endl;
+	}
 
-	return true;
+	return !force_break;
 }
 
 
@@ -160,83 +803,153 @@ const string relative_path(const string& filepath, const string &dirpath)
 }
 
 
-void start_filesender(future<shared_srt> connection, const config& cfg,
+/// Wait for the sender buffer to be empty.
+/// Otherwise we will loose this data, because SRT is not waiting
+/// for all the data to be sent in a general live streaming use case,
+/// as it might be not something it is expected to do, and may lead to
+/// to unnesessary waits on destroy.
+/// srt_getsndbuffer() is designed to handle such cases.
+void wait_sndbuffer_empty(const socket::srt& sock)
+{
+	size_t blocks = 0;
+	do
+	{
+		if (SRT_ERROR == srt_getsndbuffer(sock.id(), &blocks, nullptr))
+			break;
+
+		if (blocks)
+			this_thread::sleep_for(chrono::milliseconds(5));
+	} while (blocks != 0);
+}
+
+
+void start_filesender(const vector<shared_srt>& conns, const config& cfg,
 	const vector<string> &filenames, const atomic_bool& force_break)
 {
-	if (!connection.valid())
+	const bool write_stats = cfg.stats_file != "" && cfg.stats_freq_ms > 0;
+	unique_ptr<socket::stats_writer> stats;
+	try
 	{
-		cerr << "Error: Unexpected socket creation failure!" << endl;
-		return;
+		if (write_stats)
+			stats.reset(new socket::stats_writer(cfg.stats_file, cfg.stats_format, milliseconds(cfg.stats_freq_ms)));
 	}
-
-	const shared_srt sock = connection.get();
-	if (!sock)
+	catch (const socket::exception& e)
 	{
-		cerr << "Error: Unexpected socket connection failure!" << endl;
-		return;
+		cerr << "ERROR: " << e.what() << ". No stats output.\n";
 	}
 
-	atomic_bool local_break(false);
+	// Files are taken from the shared queue by the stream that is done with its previous file.
+	// With several streams the largest files go first, so that the streams finish at about the same time.
+	vector<uint64_t> file_sizes(filenames.size());
+	vector<size_t>   queue(filenames.size());
+	for (size_t i = 0; i < filenames.size(); ++i)
+	{
+		error_code ec;
+		const auto size = fs::file_size(filenames[i], ec);
+		file_sizes[i]   = ec ? 0 : size;
+		queue[i]        = i;
+	}
+	if (conns.size() > 1)
+		stable_sort(queue.begin(), queue.end(), [&](size_t a, size_t b) { return file_sizes[a] > file_sizes[b]; });
+	const uint64_t total_bytes = accumulate(file_sizes.begin(), file_sizes.end(), uint64_t(0));
 
-	auto stats_func = [&cfg, &force_break, &local_break](shared_srt sock) {
-		if (cfg.stats_freq_ms == 0)
-			return;
-		if (cfg.stats_file.empty())
-			return;
+	auto files = make_shared<file_queue>(filenames, cfg.src_path, queue, conns.size());
 
-		ofstream logfile_stats(cfg.stats_file.c_str());
-		if (!logfile_stats)
+	vector<shared_ptr<read_ahead>> readers;
+	vector<shared_ptr<send_stats>> send_ss;
+	for (size_t i = 0; i < conns.size(); ++i)
+	{
+		const auto& sock   = conns[i];
+		auto        source = [files, i](read_ahead::file_item& item) { return files->take(i, item); };
+		readers.push_back(make_shared<read_ahead>(source, cfg.segment_size, cfg.readahead > 0 ? cfg.readahead : 1,
+			cfg.resume ? max<uint64_t>(cfg.chunk_size, 1) : 0, cfg.pack ? cfg.pack_threshold : 0, cfg.verify, force_break));
+		if (cfg.resume)
 		{
-			cerr << "ERROR: Can't open '" << cfg.stats_file << "' for writing stats. No output.\n";
-			return;
+			// Wake up periodically while waiting for replies to chunk manifests.
+			const int timeout_ms = 1000;
+			srt_setsockopt(sock->id(), 0, SRTO_RCVTIMEO, &timeout_ms, sizeof timeout_ms);
 		}
-
-		bool               print_header = true;
-		const milliseconds interval(cfg.stats_freq_ms);
-		while (!force_break && !local_break)
+		send_ss.push_back(make_shared<send_stats>());
+		if (stats)
 		{
-			this_thread::sleep_for(interval);
-
-			logfile_stats << sock->get_statistics(cfg.stats_format, print_header) << flush;
-			print_header = false;
+			stats->add_socket(sock);
+			stats->add_extension(sock->id(), make_shared<send_stats_report>(send_ss.back(), readers.back()));
 		}
-	};
-	auto stats_logger = async(launch::async, stats_func, sock);
+	}
 
+	const auto time_start = steady_clock::now();
+	vector<future<void>> streams;
+	for (size_t i = 0; i < conns.size(); ++i)
+	{
+		streams.push_back(async(launch::async, [&, i]() {
+			bool ok = false;
+			try
+			{
+				ok = send_files(*readers[i], *files, *conns[i], *send_ss[i], force_break);
+			}
+			catch (const socket::exception& e)
+			{
+				cerr << "Stream " << i << ": " << e.what() << endl;
+			}
 
-	socket::srt dst_sock = *sock.get();
+			if (!ok && !force_break)
+			{
+				// The files read ahead by the failed stream are left to the other streams.
+				readers[i]->stop();
+				const size_t num_files = files->put_back(i);
+				if (num_files > 0)
+					cerr << "Stream " << i << ": failed, " << num_files << " file(s) returned to the queue" << endl;
+			}
+			wait_sndbuffer_empty(*conns[i]);
+		}));
+	}
 
-	vector<char> buf(cfg.segment_size);
-	for (const string& fname : filenames)
-	{
-		const bool transmit_res = send_file(fname, relative_path(fname, cfg.src_path),
-			dst_sock, buf, force_break);
+	auto bytes_sent = [&send_ss]() {
+		uint64_t bytes = 0;
+		for (const auto& ss : send_ss)
+			bytes += ss->bytes.load(memory_order_relaxed);
+		return bytes;
+	};
 
-		if (!transmit_res)
-			break;
+	// Aggregate progress of all the streams.
+	for (auto& s : streams)
+	{
+		while (s.wait_for(1s) == future_status::timeout)
+		{
+			if (conns.size() == 1)
+				continue;
 
-		if (force_break)
-			break;
+			const auto   delta_us  = duration_cast<microseconds>(steady_clock::now() - time_start).count();
+			const size_t rate_kbps = (bytes_sent() * 1000) / (delta_us ? delta_us : 1) * 8;
+			cerr << "Sent " << bytes_sent() / 1024 << " of " << total_bytes / 1024 << " kbytes over "
+				<< conns.size() << " streams @ " << rate_kbps << " kbps...\r";
+		}
 	}
 
-	// We have to check if the sending buffer is empty.
-	// Or we will loose this data, because SRT is not waiting
-	// for all the data to be sent in a general live streaming use case,
-	// as it might be not something it is expected to do, and may lead to
-	// to unnesessary waits on destroy.
-	// srt_getsndbuffer() is designed to handle such cases.
-	size_t blocks = 0;
-	do
+	uint64_t disk_wait_us = 0, net_wait_us = 0, reader_wait_us = 0;
+	for (size_t i = 0; i < conns.size(); ++i)
 	{
-		if (SRT_ERROR == srt_getsndbuffer(dst_sock.id(), &blocks, nullptr))
-			break;
+		disk_wait_us += readers[i]->disk_wait_us();
+		net_wait_us += send_ss[i]->net_wait_us.load();
+		reader_wait_us += readers[i]->reader_wait_us();
+	}
 
-		if (blocks)
-			this_thread::sleep_for(chrono::milliseconds(5));
-	} while (blocks != 0);
+	const auto elapsed_ms = duration_cast<milliseconds>(steady_clock::now() - time_start).count();
+	cerr << "Sent " << bytes_sent() / 1024 << " kbytes over " << conns.size() << " stream(s) in " << elapsed_ms
+		<< " ms: disk wait " << disk_wait_us / 1000 << " ms, network wait " << net_wait_us / 1000
+		<< " ms, read-ahead full " << reader_wait_us / 1000 << " ms" << endl;
 
-	local_break = true;
-	stats_logger.wait();
+	const vector<size_t> not_sent = files->not_sent();
+	if (not_sent.empty())
+		return;
+
+	cerr << "ERROR: " << not_sent.size() << " of " << filenames.size() << " file(s) were not transferred"
+		<< (force_break ? " (interrupted)" : ":") << endl;
+	if (!force_break)
+	{
+		for (const size_t idx : not_sent)
+			cerr << "  " << filenames[idx] << endl;
+	}
 }
 
 
@@ -273,12 +986,9 @@ void xtransmit::file::send::run(const string& dst_url, const config& cfg, const
 	if (!ut["sndbuf"].exists())
 		ut["sndbuf"] = to_string(cfg.segment_size * 10);
 
-	shared_srt socket = make_shared<socket::srt>(ut);
-	const bool        accept = socket->mode() == socket::srt::LISTENER;
 	try
 	{
-		start_filesender(accept ? socket->async_accept() : socket->async_connect()
-			, cfg, filenames, force_break);
+		start_filesender(file::connect_streams(ut, cfg.streams > 0 ? cfg.streams : 1), cfg, filenames, force_break);
 	}
 	catch (const socket::exception & e)
 	{
@@ -296,6 +1006,13 @@ CLI::App* xtransmit::file::send::add_subcommand(CLI::App& app, config& cfg, stri
 	sc_file_send->add_option("dst", dst_url, "Destination URI");
 	sc_file_send->add_flag("--printout", cfg.only_print, "Print files found in a folder ad subfolders. No transfer.");
 	sc_file_send->add_option("--segment", cfg.segment_size, "Size of the transmission segment");
+	sc_file_send->add_option("--streams", cfg.streams, "Number of concurrent SRT connections to send files over");
+	sc_file_send->add_flag("--resume", cfg.resume, "Send only the chunks of files missing or different on the receiver");
+	sc_file_send->add_option("--chunk", cfg.chunk_size, "Size of a file chunk compared in the resumable mode");
+	sc_file_send->add_flag("--verify", cfg.verify, "Send the hash of every file to be verified by the receiver");
+	sc_file_send->add_flag("--pack", cfg.pack, "Pack small files several in a segment");
+	sc_file_send->add_option("--pack-threshold", cfg.pack_threshold, "The maximum size of a file to pack (bytes)");
+	sc_file_send->add_option("--readahead", cfg.readahead, "Number of segments read from disk ahead of sending");
 	sc_file_send->add_option("--statsfile", cfg.stats_file, "output stats report filename");
 	sc_file_send->add_option("--statsformat", cfg.stats_format, "output stats report format (json, csv)");
 	sc_file_send->add_option("--statsfreq", cfg.stats_freq_ms, "output stats report frequency (ms)")
@@ -14,6 +14,13 @@ namespace xtransmit::file::send
 	{
 		std::string src_path;
 		size_t      segment_size = 1456 * 1000;
+		size_t      readahead = 4;	// Number of segments read ahead of sending
+		size_t      streams = 1;	// Number of concurrent connections
+		bool        resume = false;	// Send only the chunks missing on the receiver
+		size_t      chunk_size = 4 * 1024 * 1024;	// Size of a chunk compared in the resumable mode
+		bool        verify = false;	// Send the hash of every file to be verified by the receiver
+		bool        pack = false;	// Pack small files several in a segment
+		size_t      pack_threshold = 64 * 1024;	// The maximum size of a file to pack
 		bool        only_print = false;	// Do not transfer, just enumerate files and print to stdout
 		int stats_freq_ms = 0;
 		std::string stats_file;
@@ -0,0 +1,393 @@
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#include <malloc.h>
+#endif
+
+// submodules
+#include "spdlog/spdlog.h"
+
+// xtransmit
+#include "file_sink.hpp"
+#include "socket.hpp"
+#include "xtr_defs.hpp"
+
+// nlohmann_json
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using namespace std::chrono;
+
+#define LOG_SC_SINK "SINK "
+
+namespace xtransmit
+{
+namespace sink
+{
+
+namespace
+{
+// Alignment required for direct I/O (logical block size of most devices, page size).
+const size_t IO_ALIGNMENT = 4096;
+
+char* aligned_alloc_block(size_t size)
+{
+#if defined(_WIN32)
+	return static_cast<char*>(_aligned_malloc(size, IO_ALIGNMENT));
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, IO_ALIGNMENT, size) != 0)
+		return nullptr;
+	return static_cast<char*>(ptr);
+#endif
+}
+
+void aligned_free_block(char* ptr)
+{
+#if defined(_WIN32)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+} // namespace
+
+/// A file opened for sequential writing, bypassing the page cache if possible.
+struct file_sink::raw_file
+{
+	raw_file(const string& path, bool direct)
+	{
+#if defined(_WIN32)
+		m_file = fopen(path.c_str(), "wb");
+		if (!m_file)
+			throw socket::exception("Failed to open sink file " + path);
+#else
+		const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+		if (direct)
+		{
+			// O_DIRECT is not supported by some file systems (e.g. tmpfs): fall back to buffered writing.
+			m_fd     = ::open(path.c_str(), flags | O_DIRECT, 0644);
+			m_direct = m_fd != -1;
+		}
+#endif
+		if (m_fd == -1)
+			m_fd = ::open(path.c_str(), flags, 0644);
+		if (m_fd == -1)
+			throw socket::exception("Failed to open sink file " + path + ". Error " + to_string(errno));
+#ifdef F_NOCACHE
+		// macOS: the closest equivalent of O_DIRECT.
+		if (direct)
+			m_direct = fcntl(m_fd, F_NOCACHE, 1) != -1;
+#endif
+#endif
+	}
+
+	~raw_file()
+	{
+#if defined(_WIN32)
+		fclose(m_file);
+#else
+		::close(m_fd);
+#endif
+	}
+
+	/// @returns false on failure.
+	bool write(const char* data, size_t len)
+	{
+		// Direct I/O requires the length to be aligned. The tail of the file is written buffered.
+		if (m_direct && len % IO_ALIGNMENT != 0)
+			disable_direct();
+
+#if defined(_WIN32)
+		return fwrite(data, 1, len, m_file) == len;
+#else
+		while (len > 0)
+		{
+			const ssize_t res = ::write(m_fd, data, len);
+			if (res == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			data += res;
+			len -= static_cast<size_t>(res);
+		}
+		return true;
+#endif
+	}
+
+	bool is_direct() const { return m_direct; }
+
+private:
+	void disable_direct()
+	{
+#if !defined(_WIN32) && defined(O_DIRECT)
+		const int flags = fcntl(m_fd, F_GETFL);
+		if (flags != -1)
+			fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+		m_direct = false;
+	}
+
+private:
+#if defined(_WIN32)
+	FILE* m_file = nullptr;
+#else
+	int m_fd = -1;
+#endif
+	bool m_direct = false;
+};
+
+file_sink::file_sink(const string& path, size_t block_size, int num_blocks)
+	: m_path(path)
+	, m_block_size(((block_size + IO_ALIGNMENT - 1) / IO_ALIGNMENT) * IO_ALIGNMENT)
+	, m_blocks(num_blocks < 2 ? 2 : num_blocks)
+{
+	for (size_t i = 0; i < m_blocks.size(); ++i)
+	{
+		m_blocks[i].data = aligned_alloc_block(m_block_size);
+		if (!m_blocks[i].data)
+			throw socket::exception("Failed to allocate sink buffers");
+		m_blocks[i].index.reserve(2 * (m_block_size / 188 + 1)); // The smallest expected message is a TS packet.
+		m_free.push_back(static_cast<int>(i));
+	}
+
+	m_file  = unique_ptr<raw_file>(new raw_file(path, true));
+	m_index = unique_ptr<raw_file>(new raw_file(path + ".idx", false));
+
+	spdlog::info(LOG_SC_SINK "Writing to '{}' ({} blocks of {} bytes{}), index '{}.idx'.", path, m_blocks.size(),
+		m_block_size, m_file->is_direct() ? ", direct I/O" : "", path);
+
+	m_writer = thread(&file_sink::writer_loop, this);
+}
+
+file_sink::~file_sink()
+{
+	close();
+	for (auto& b : m_blocks)
+		aligned_free_block(b.data);
+}
+
+int file_sink::acquire_block()
+{
+	lock_guard<mutex> lck(m_mtx);
+	if (m_free.empty())
+		return -1;
+	const int idx = m_free.front();
+	m_free.pop_front();
+	return idx;
+}
+
+void file_sink::submit_block(int idx)
+{
+	lock_guard<mutex> lck(m_mtx);
+	m_full.push_back(idx);
+	m_cv.notify_one();
+}
+
+bool file_sink::write(const const_buffer& msg)
+{
+	if (m_closed || msg.size() == 0)
+		return false;
+
+	if (msg.size() > m_block_size)
+	{
+		spdlog::warn(LOG_SC_SINK "Message of {} bytes exceeds the block size {}. Dropped.", msg.size(), m_block_size);
+		inc(m_msgs_dropped, 1);
+		inc(m_bytes_dropped, msg.size());
+		return false;
+	}
+
+	if (m_fill_idx == -1)
+		m_fill_idx = acquire_block();
+
+	// A message not fitting into the current block continues in the next one.
+	// Acquire it in advance to never store a part of a message.
+	int next_idx = -1;
+	if (m_fill_idx != -1 && m_blocks[m_fill_idx].len + msg.size() > m_block_size)
+		next_idx = acquire_block();
+
+	if (m_fill_idx == -1 || (m_blocks[m_fill_idx].len + msg.size() > m_block_size && next_idx == -1))
+	{
+		if (!m_stalled)
+		{
+			m_stalled     = true;
+			m_stall_start = steady_clock::now();
+		}
+		inc(m_msgs_dropped, 1);
+		inc(m_bytes_dropped, msg.size());
+		return false;
+	}
+
+	if (m_stalled)
+	{
+		m_stalled = false;
+		inc(m_stall_us, duration_cast<microseconds>(steady_clock::now() - m_stall_start).count());
+	}
+
+	block& b = m_blocks[m_fill_idx];
+	b.index.push_back(m_offset);
+	b.index.push_back(msg.size());
+	m_offset += msg.size();
+
+	const char*  src  = static_cast<const char*>(msg.data());
+	const size_t part = min(msg.size(), m_block_size - b.len);
+	memcpy(b.data + b.len, src, part);
+	b.len += part;
+
+	if (b.len == m_block_size)
+	{
+		submit_block(m_fill_idx);
+		m_fill_idx = next_idx;
+	}
+
+	if (part < msg.size())
+	{
+		block& nb = m_blocks[m_fill_idx];
+		memcpy(nb.data, src + part, msg.size() - part);
+		nb.len = msg.size() - part;
+	}
+
+	inc(m_msgs_written, 1);
+	inc(m_bytes_written, msg.size());
+	return true;
+}
+
+void file_sink::close()
+{
+	if (m_closed)
+		return;
+	m_closed = true;
+
+	if (m_stalled)
+	{
+		m_stalled = false;
+		inc(m_stall_us, duration_cast<microseconds>(steady_clock::now() - m_stall_start).count());
+	}
+
+	{
+		lock_guard<mutex> lck(m_mtx);
+		if (m_fill_idx != -1 && m_blocks[m_fill_idx].len > 0)
+			m_full.push_back(m_fill_idx);
+		m_fill_idx = -1;
+		m_stop     = true;
+		m_cv.notify_one();
+	}
+
+	if (m_writer.joinable())
+		m_writer.join();
+
+	const auto s = get_stats();
+	spdlog::info(LOG_SC_SINK "'{}': {} messages ({} bytes) written, {} messages ({} bytes) dropped. "
+		"Stall {} ms, disk write {} ms.", m_path, s.msgs_written, s.bytes_written, s.msgs_dropped, s.bytes_dropped,
+		s.stall_us / 1000, s.disk_us / 1000);
+}
+
+void file_sink::writer_loop()
+{
+	XTR_THREADNAME(std::string("XTR:Sink"));
+	bool failed = false;
+
+	for (;;)
+	{
+		int idx = -1;
+		{
+			unique_lock<mutex> lck(m_mtx);
+			m_cv.wait(lck, [this]() { return m_stop || !m_full.empty(); });
+			if (m_full.empty())
+				break; // Stopped and no more data.
+			idx = m_full.front();
+			m_full.pop_front();
+		}
+
+		block& b = m_blocks[idx];
+		if (!failed)
+		{
+			const auto t_start = steady_clock::now();
+			failed = !m_file->write(b.data, b.len)
+				|| !m_index->write(reinterpret_cast<const char*>(b.index.data()), b.index.size() * sizeof(uint64_t));
+			inc(m_disk_us, duration_cast<microseconds>(steady_clock::now() - t_start).count());
+
+			if (failed)
+				spdlog::error(LOG_SC_SINK "Failed to write to '{}'. Further data is discarded.", m_path);
+		}
+
+		b.len = 0;
+		b.index.clear();
+
+		lock_guard<mutex> lck(m_mtx);
+		m_free.push_back(idx);
+	}
+}
+
+file_sink::stats file_sink::get_stats() const
+{
+	stats s;
+	s.msgs_written  = m_msgs_written.load(memory_order_relaxed);
+	s.bytes_written = m_bytes_written.load(memory_order_relaxed);
+	s.msgs_dropped  = m_msgs_dropped.load(memory_order_relaxed);
+	s.bytes_dropped = m_bytes_dropped.load(memory_order_relaxed);
+	s.stall_us      = m_stall_us.load(memory_order_relaxed);
+	s.disk_us       = m_disk_us.load(memory_order_relaxed);
+	return s;
+}
+
+file_sink::stats file_sink::stats::operator-(const stats& prev) const
+{
+	stats s;
+	s.msgs_written  = msgs_written - prev.msgs_written;
+	s.bytes_written = bytes_written - prev.bytes_written;
+	s.msgs_dropped  = msgs_dropped - prev.msgs_dropped;
+	s.bytes_dropped = bytes_dropped - prev.bytes_dropped;
+	s.stall_us      = stall_us - prev.stall_us;
+	s.disk_us       = disk_us - prev.disk_us;
+	return s;
+}
+
+file_sink::stats file_sink_stats::next_interval()
+{
+	const auto curr = m_sink->get_stats();
+	const auto s    = curr - m_prev;
+	m_prev          = curr;
+	return s;
+}
+
+const string file_sink_stats::stats_to_csv(bool print_header)
+{
+	if (print_header)
+		return "pktSinkWritten,byteSinkWritten,pktSinkDropped,byteSinkDropped,usSinkStall,usSinkDisk";
+
+	const auto s = next_interval();
+	stringstream ss;
+	ss << s.msgs_written << ',';
+	ss << s.bytes_written << ',';
+	ss << s.msgs_dropped << ',';
+	ss << s.bytes_dropped << ',';
+	ss << s.stall_us << ',';
+	ss << s.disk_us;
+	return ss.str();
+}
+
+const nlohmann::json file_sink_stats::stats_to_json()
+{
+	const auto s = next_interval();
+	nlohmann::json root;
+	root["pktWritten"]  = s.msgs_written;
+	root["byteWritten"] = s.bytes_written;
+	root["pktDropped"]  = s.msgs_dropped;
+	root["byteDropped"] = s.bytes_dropped;
+	root["usStall"]     = s.stall_us;
+	root["usDisk"]      = s.disk_us;
+	return root;
+}
+
+} // namespace sink
+} // namespace xtransmit
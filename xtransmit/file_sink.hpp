@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// xtransmit
+#include "buffer.hpp"
+#include "socket_stats.hpp"
+
+namespace xtransmit
+{
+namespace sink
+{
+
+/// Asynchronous capture of received messages to a file.
+///
+/// Messages are copied into large aligned blocks, and full blocks are written to disk
+/// by a dedicated writer thread (with O_DIRECT where available).
+/// The receiving thread never waits for the disk: if no free block is available,
+/// the message is dropped and the time spent without a free block is accounted as a stall.
+///
+/// A message-boundary index is written next to the data file ("<path>.idx"),
+/// one record per message: uint64 offset in the data file, uint64 message length (host byte order).
+class file_sink
+{
+public:
+	/// @param path        data file path
+	/// @param block_size  size of a buffer block, rounded up to a multiple of 4096 bytes
+	/// @param num_blocks  the number of buffer blocks (at least 2)
+	/// @throws socket::exception if the file can't be opened
+	file_sink(const std::string& path, size_t block_size, int num_blocks);
+	~file_sink();
+
+	file_sink(const file_sink&) = delete;
+	file_sink& operator=(const file_sink&) = delete;
+
+public:
+	/// Copy a message to the sink. Never blocks on disk.
+	/// Must be called from one thread only (the receiving thread).
+	/// @returns false if the message was dropped (no free block).
+	bool write(const const_buffer& msg);
+
+	/// Flush the remaining data and wait for the writer thread to finish.
+	/// Must be called from the same thread as write().
+	void close();
+
+	struct stats
+	{
+		uint64_t msgs_written  = 0; // Messages accepted by the sink.
+		uint64_t bytes_written = 0;
+		uint64_t msgs_dropped  = 0; // Messages dropped because no free block was available.
+		uint64_t bytes_dropped = 0;
+		uint64_t stall_us      = 0; // Time the receiving side had no free block.
+		uint64_t disk_us       = 0; // Time the writer thread spent in disk writes.
+
+		stats operator-(const stats& prev) const;
+	};
+
+	/// Get cumulative values. Safe to call from any thread.
+	stats get_stats() const;
+
+private:
+	struct block
+	{
+		char*                 data = nullptr; // Aligned memory, released in ~file_sink().
+		size_t                len  = 0;
+		std::vector<uint64_t> index;          // (offset, length) of the messages starting in this block.
+	};
+
+	struct raw_file;
+
+	int  acquire_block();
+	void submit_block(int idx);
+	void writer_loop();
+
+	static void inc(std::atomic<uint64_t>& counter, uint64_t val)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+	}
+
+private:
+	const std::string                m_path;
+	const size_t                     m_block_size;
+	std::vector<block>               m_blocks;
+	std::unique_ptr<raw_file>        m_file;
+	std::unique_ptr<raw_file>        m_index;
+
+	// Accessed by the receiving thread only.
+	int                                   m_fill_idx = -1; // The block being filled.
+	uint64_t                              m_offset   = 0;  // The offset of the next message in the data file.
+	bool                                  m_stalled  = false;
+	std::chrono::steady_clock::time_point m_stall_start;
+	bool                                  m_closed   = false;
+
+	// Shared between the receiving and the writer threads.
+	std::mutex              m_mtx;
+	std::condition_variable m_cv;
+	std::deque<int>         m_free;
+	std::deque<int>         m_full;
+	bool                    m_stop = false;
+	std::thread             m_writer;
+
+	std::atomic<uint64_t> m_msgs_written{0};
+	std::atomic<uint64_t> m_bytes_written{0};
+	std::atomic<uint64_t> m_msgs_dropped{0};
+	std::atomic<uint64_t> m_bytes_dropped{0};
+	std::atomic<uint64_t> m_stall_us{0};
+	std::atomic<uint64_t> m_disk_us{0};
+};
+
+/// Reports file_sink statistics to the stats file.
+class file_sink_stats : public socket::stats_extension
+{
+public:
+	explicit file_sink_stats(std::shared_ptr<const file_sink> sink)
+		: m_sink(std::move(sink))
+	{
+	}
+
+public:
+	const std::string    stats_to_csv(bool print_header) final;
+	const nlohmann::json stats_to_json() final;
+	const char*          json_key() const final { return "SinkStats"; }
+
+private:
+	file_sink::stats next_interval();
+
+private:
+	std::shared_ptr<const file_sink> m_sink;
+	file_sink::stats                 m_prev;
+};
+
+} // namespace sink
+} // namespace xtransmit
@@ -17,8 +17,13 @@
 #include "generate.hpp"
 #include "pacer.hpp"
 #include "metrics.hpp"
+#include "metrics_histogram.hpp"
+#include "srt_worker.hpp"
 #include "xtr_defs.hpp"
 
+// nlohmann_json
+#include <nlohmann/json.hpp>
+
 // OpenSRT
 #include "apputil.hpp"
 #include "uriparser.hpp"
@@ -33,7 +38,249 @@ using shared_sock = std::shared_ptr<socket::isocket>;
 
 #define LOG_SC_GENERATE "GENERATE "
 
-void run_pipe(shared_sock dst, const config& cfg, std::function<void(int conn_id)> const& on_done, const atomic_bool& force_break)
+namespace
+{
+
+/// Sender-side backpressure: how long socket write calls take and how often sending falls behind.
+/// Updated by the generating thread only, can be read from any thread.
+struct send_backpressure
+{
+	metrics::histogram write_time;
+	atomic<uint64_t>   short_writes{0};   // Writes that sent less than requested (but not zero).
+	atomic<uint64_t>   eagain_retries{0}; // Writes that sent nothing (e.g. SRT_EASYNCSND) and were retried.
+	atomic<uint64_t>   pacer_misses{0};   // Pacer wait started after the scheduled sending time.
+
+	struct snapshot
+	{
+		metrics::histogram::snapshot write_time;
+		uint64_t short_writes   = 0;
+		uint64_t eagain_retries = 0;
+		uint64_t pacer_misses   = 0;
+
+		snapshot operator-(const snapshot& prev) const
+		{
+			snapshot s;
+			s.write_time     = write_time - prev.write_time;
+			s.short_writes   = short_writes - prev.short_writes;
+			s.eagain_retries = eagain_retries - prev.eagain_retries;
+			s.pacer_misses   = pacer_misses - prev.pacer_misses;
+			return s;
+		}
+	};
+
+	static void inc(atomic<uint64_t>& counter)
+	{
+		counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+	}
+
+	snapshot get_snapshot() const
+	{
+		snapshot s;
+		s.write_time     = write_time.get_snapshot();
+		s.short_writes   = short_writes.load(memory_order_relaxed);
+		s.eagain_retries = eagain_retries.load(memory_order_relaxed);
+		s.pacer_misses   = pacer_misses.load(memory_order_relaxed);
+		return s;
+	}
+};
+
+/// Reports send_backpressure of a generating pipe to the stats file.
+class send_backpressure_stats : public socket::stats_extension
+{
+public:
+	explicit send_backpressure_stats(shared_ptr<const send_backpressure> bp)
+		: m_bp(std::move(bp))
+	{
+	}
+
+public:
+	const string stats_to_csv(bool print_header) final
+	{
+		if (print_header)
+			return metrics::histogram::snapshot::csv_header("Write") + ",pktShortWrites,pktEagainRetries,pktPacerMisses";
+
+		const auto s = next_interval();
+		stringstream ss;
+		ss << s.write_time.to_csv() << ',';
+		ss << s.short_writes << ',';
+		ss << s.eagain_retries << ',';
+		ss << s.pacer_misses;
+		return ss.str();
+	}
+
+	const nlohmann::json stats_to_json() final
+	{
+		const auto s = next_interval();
+		nlohmann::json root;
+		root["write"]            = s.write_time.to_json();
+		root["pktShortWrites"]   = s.short_writes;
+		root["pktEagainRetries"] = s.eagain_retries;
+		root["pktPacerMisses"]   = s.pacer_misses;
+		return root;
+	}
+
+	const char* json_key() const final { return "GenStats"; }
+
+private:
+	send_backpressure::snapshot next_interval()
+	{
+		const auto curr = m_bp->get_snapshot();
+		const auto s    = curr - m_prev;
+		m_prev          = curr;
+		return s;
+	}
+
+private:
+	shared_ptr<const send_backpressure> m_bp;
+	send_backpressure::snapshot         m_prev;
+};
+
+/// The source time of a generated message in the SRT clock:
+/// the timestamp of the payload if metrics are enabled, otherwise now.
+int64_t srt_srctime(const config& cfg, const vector<char>& payload)
+{
+	const auto gen_time = cfg.enable_metrics ? metrics::read_stdclock_timestamp(const_buffer(payload.data(), payload.size()))
+											 : steady_clock::now();
+	return srt_time_now() - duration_cast<microseconds>(steady_clock::now() - gen_time).count();
+}
+
+void log_send_rate(SOCKET conn_id, int num_msgs, steady_clock::duration elapsed, int message_size,
+	const send_backpressure::snapshot& bp_intv)
+{
+	const long long bps = (8 * num_msgs * message_size) / duration_cast<milliseconds>(elapsed).count() * 1000;
+	auto us_str = [](long long val) -> string {
+		return val < 0 ? "n/a" : to_string(val);
+	};
+	spdlog::info(LOG_SC_GENERATE "@{} Sending at {} kbps. Write call, us: avg {}, p99 {}, max {}. "
+		"Short writes {}, EAGAIN retries {}, pacer misses {}.",
+		conn_id, bps / 1000, us_str(bp_intv.write_time.avg_us()), us_str(bp_intv.write_time.percentile_us(99)),
+		us_str(bp_intv.write_time.max_us()), bp_intv.short_writes, bp_intv.eagain_retries, bp_intv.pacer_misses);
+}
+
+/// Generation of an SRT connection served by a worker thread (see srt_worker_pool).
+/// A message is sent when the pacer is due. If the sender buffer is full,
+/// the message is sent once the socket becomes writable.
+class generate_task : public pipe_task
+{
+public:
+	generate_task(shared_sock sock, const config& cfg, socket::stats_writer* stats)
+		: m_sock(std::move(sock))
+		, m_srt(dynamic_cast<socket::srt_msg_io*>(m_sock.get()))
+		, m_cfg(cfg)
+		, m_num_messages(cfg.duration > 0 ? -1 : cfg.num_messages)
+		, m_message(cfg.message_size)
+		, m_pldgen(cfg.enable_metrics)
+		, m_pacer(cfg.sendrate ? new pacer(cfg.sendrate, cfg.message_size) : nullptr)
+		, m_bp(make_shared<send_backpressure>())
+	{
+		iota(m_message.begin(), m_message.end(), (char)0);
+		if (stats)
+			stats->add_extension(m_sock->id(), make_shared<send_backpressure_stats>(m_bp));
+	}
+
+public:
+	bool process(int events) final
+	{
+		const auto tnow = steady_clock::now();
+		if (m_cfg.duration > 0 && tnow - m_start_time > seconds(m_cfg.duration))
+			return false;
+
+		// A few messages at a time not to hold up the other connections of the worker.
+		for (int n = 0; n < 16; ++n)
+		{
+			if (!m_pending)
+			{
+				if (m_num_messages >= 0 && m_num_sent >= m_num_messages)
+					return false;
+				if (m_pacer && m_pacer->next_send_time() > tnow)
+					break;
+				if (m_pacer)
+					m_pacer->on_sent(tnow);
+
+				m_pldgen.generate_payload(m_message);
+				m_to_send = const_buffer(m_message.data(), m_message.size());
+				m_mctrl   = srt_msgctrl_default;
+				if (m_cfg.srctime && m_srt)
+					m_mctrl.srctime = srt_srctime(m_cfg, m_message);
+				m_pending = true;
+			}
+
+			const auto t_write = steady_clock::now();
+			const int  bytes   = m_srt ? m_srt->write_msg(m_to_send, m_mctrl, 0) : m_sock->write(m_to_send, 0);
+
+			// The sender buffer is full: wait for the socket to become writable.
+			m_blocked = bytes == 0;
+			if (m_blocked)
+			{
+				send_backpressure::inc(m_bp->eagain_retries);
+				break;
+			}
+
+			// Only the writes that sent data are sampled, as in run_pipe().
+			m_bp->write_time.submit_sample(steady_clock::now() - t_write);
+
+			if (static_cast<size_t>(bytes) < m_to_send.size())
+			{
+				send_backpressure::inc(m_bp->short_writes);
+				m_to_send += bytes;
+				continue;
+			}
+
+			m_pending = false;
+			++m_num_sent;
+			if (m_pacer)
+				m_pacer->on_ready(steady_clock::now());
+		}
+
+		if (m_pacer)
+			m_bp->pacer_misses.store(m_pacer->deadline_misses(), memory_order_relaxed);
+
+		if (tnow > m_stat_time + seconds(1))
+		{
+			const auto bp_curr = m_bp->get_snapshot();
+			log_send_rate(m_sock->id(), m_num_sent - m_prev_sent, tnow - m_stat_time, m_cfg.message_size, bp_curr - m_bp_prev);
+			m_stat_time = tnow;
+			m_prev_sent = m_num_sent;
+			m_bp_prev   = bp_curr;
+		}
+
+		return true;
+	}
+
+	int interest() const final { return m_blocked ? SRT_EPOLL_OUT : 0; }
+
+	steady_clock::time_point due() const final
+	{
+		if (m_blocked)
+			return steady_clock::time_point::max();
+		return m_pacer && !m_pending ? m_pacer->next_send_time() : steady_clock::now();
+	}
+
+private:
+	const shared_sock          m_sock;
+	socket::srt_msg_io* const  m_srt;
+	const config&              m_cfg;
+	const int                  m_num_messages;
+	vector<char>               m_message;
+	metrics::generator         m_pldgen;
+	unique_ptr<pacer>          m_pacer;
+	shared_ptr<send_backpressure> m_bp;
+	send_backpressure::snapshot   m_bp_prev;
+
+	const steady_clock::time_point m_start_time = steady_clock::now();
+	steady_clock::time_point       m_stat_time  = steady_clock::now();
+	int                            m_num_sent   = 0;
+	int                            m_prev_sent  = 0;
+	bool                           m_pending    = false; // A message is generated, but not sent yet.
+	bool                           m_blocked    = false; // Waiting for the socket to become writable.
+	const_buffer                   m_to_send;
+	SRT_MSGCTRL                    m_mctrl = srt_msgctrl_default;
+};
+
+} // namespace
+
+void run_pipe(shared_sock dst, const config& cfg, socket::stats_writer* stats,
+	std::function<void(int conn_id)> const& on_done, const atomic_bool& force_break)
 {
 	XTR_THREADNAME(std::string("XTR:Gen"));
 	vector<char> message_to_send(cfg.message_size);
@@ -45,11 +292,23 @@ void run_pipe(shared_sock dst, const config& cfg, std::function<void(int conn_id
 	socket::isocket& sock = *dst.get();
 	const auto conn_id = sock.id();
 
+	// With tcp://...?zerocopy=1 messages are generated directly in the buffers of the socket.
+	auto* tcp_sock = dynamic_cast<socket::tcp*>(&sock);
+	// With --srctime SRT sockets and groups are written with the source time of the message.
+	auto* srt_sock = cfg.srctime ? dynamic_cast<socket::srt_msg_io*>(&sock) : nullptr;
+	if (cfg.srctime && !srt_sock)
+		spdlog::warn(LOG_SC_GENERATE "@{} --srctime is only supported by SRT.", conn_id);
+
 	metrics::generator pldgen(cfg.enable_metrics);
 
 	auto stat_time = steady_clock::now();
 	int  prev_i    = 0;
 
+	auto bp = make_shared<send_backpressure>();
+	send_backpressure::snapshot bp_prev;
+	if (stats)
+		stats->add_extension(conn_id, make_shared<send_backpressure_stats>(bp));
+
 	unique_ptr<ipacer> ratepacer =
 		cfg.sendrate ? unique_ptr<ipacer>(new pacer(cfg.sendrate, cfg.message_size, cfg.spin_wait))
 					 : (!cfg.playback_csv.empty() ? unique_ptr<ipacer>(new csv_pacer(cfg.playback_csv)) : nullptr);
@@ -61,6 +320,7 @@ void run_pipe(shared_sock dst, const config& cfg, std::function<void(int conn_id
 			if (ratepacer)
 			{
 				ratepacer->wait(force_break);
+				bp->pacer_misses.store(ratepacer->deadline_misses(), memory_order_relaxed);
 			}
 
 			// Check if sending duration is respected
@@ -69,19 +329,51 @@ void run_pipe(shared_sock dst, const config& cfg, std::function<void(int conn_id
 				break;
 			}
 
-			pldgen.generate_payload(message_to_send);
+			vector<char>* payload = tcp_sock ? tcp_sock->zerocopy_buffer(message_to_send.size(), force_break) : nullptr;
+			if (force_break)
+				break;
+			if (!payload)
+				payload = &message_to_send;
+			pldgen.generate_payload(*payload);
+
+			SRT_MSGCTRL mctrl = srt_msgctrl_default;
+			if (srt_sock)
+				mctrl.srctime = srt_srctime(cfg, *payload);
+
+			// A write may block (full sender buffer) or send nothing in non-blocking mode.
+			// Retry until the whole message is sent, measuring each call that sent data.
+			const_buffer to_send(payload->data(), payload->size());
+			steady_clock::time_point tnow;
+			while (!force_break)
+			{
+				const auto t_write = steady_clock::now();
+				const int  bytes   = srt_sock ? srt_sock->write_msg(to_send, mctrl) : sock.write(to_send);
+				tnow = steady_clock::now();
+
+				if (bytes == 0)
+				{
+					// The send buffer is full: back off instead of spinning on the socket.
+					send_backpressure::inc(bp->eagain_retries);
+					this_thread::sleep_for(microseconds(100));
+					continue;
+				}
+
+				bp->write_time.submit_sample(tnow - t_write);
 
-			sock.write(const_buffer(message_to_send.data(), message_to_send.size()));
+				if (static_cast<size_t>(bytes) >= to_send.size())
+					break;
+
+				send_backpressure::inc(bp->short_writes);
+				to_send += bytes;
+			}
 
-			const auto tnow = steady_clock::now();
 			if (tnow > (stat_time + chrono::seconds(1)))
 			{
-				const int       n       = i - prev_i;
-				const auto      elapsed = tnow - stat_time;
-				const long long bps     = (8 * n * cfg.message_size) / duration_cast<milliseconds>(elapsed).count() * 1000;
-				spdlog::info(LOG_SC_GENERATE "@{} Sending at {} kbps", conn_id, bps / 1000);
+				const auto bp_curr = bp->get_snapshot();
+				log_send_rate(conn_id, i - prev_i, tnow - stat_time, cfg.message_size, bp_curr - bp_prev);
 				stat_time = tnow;
 				prev_i    = i;
+				bp_prev   = bp_curr;
 			}
 		}
 	}
@@ -101,8 +393,14 @@ void run_pipe(shared_sock dst, const config& cfg, std::function<void(int conn_id
 void xtransmit::generate::run(const std::vector<std::string>& dst_urls, const config& cfg, const atomic_bool& force_break)
 {
 	using namespace std::placeholders;
-	processing_fn_t process_fn = std::bind(run_pipe, _1, cfg, _2, _3);
-	common_run(dst_urls, cfg, cfg, force_break, process_fn);
+	processing_fn_t process_fn = std::bind(run_pipe, _1, cfg, _2, _3, _4);
+	const pipe_task_fn_t task_fn = [&cfg](shared_sock sock, socket::stats_writer* stats) -> unique_ptr<pipe_task> {
+		// CSV playback and spin waiting need a thread of their own.
+		if (!cfg.playback_csv.empty() || cfg.spin_wait)
+			return nullptr;
+		return unique_ptr<pipe_task>(new generate_task(sock, cfg, stats));
+	};
+	common_run(dst_urls, cfg, cfg, force_break, process_fn, task_fn);
 }
 
 CLI::App* xtransmit::generate::add_subcommand(CLI::App& app, config& cfg, std::vector<std::string>& dst_urls)
@@ -127,6 +425,7 @@ CLI::App* xtransmit::generate::add_subcommand(CLI::App& app, config& cfg, std::v
 	sc_generate->add_flag("--enable-metrics", cfg.enable_metrics, "Enable embeding metrics: latency, loss, reordering, jitter, etc.");
 	sc_generate->add_option("--playback-csv", cfg.playback_csv, "Input CSV file with timestamp of every packet");
 	sc_generate->add_flag("--spin-wait", cfg.spin_wait, "Use CPU-expensive spin waiting for better sending accuracy");
+	sc_generate->add_flag("--srctime", cfg.srctime, "Set the SRT source time of a message to the time it was generated (SRT only)");
 	
 	apply_cli_opts(*sc_generate, cfg);
 
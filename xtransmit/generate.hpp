@@ -24,6 +24,7 @@ struct config
 	bool        two_way        = false;
 	bool        enable_metrics = false;
 	bool        spin_wait      = false;
+	bool        srctime        = false; // Set the SRT source time of a message to the time it was generated.
 	std::string playback_csv;
 };
 
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+// submodules
+#include "spdlog/spdlog.h"
+
+// xtransmit
+#include "impairment.hpp"
+#include "socket.hpp"
+#include "xtr_defs.hpp"
+
+// nlohmann_json
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using namespace std::chrono;
+
+#define LOG_SC_IMPAIR "IMPAIR "
+
+namespace xtransmit
+{
+namespace impairment
+{
+
+bool stage::later(const message& a, const message& b)
+{
+	return a.due != b.due ? a.due > b.due : a.seq > b.seq;
+}
+
+stage::stage(const config& cfg, size_t message_size, sink_fn sink)
+	: m_cfg(cfg)
+	, m_message_size(message_size)
+	, m_sink(std::move(sink))
+{
+	const unsigned seed = cfg.seed ? cfg.seed : random_device()();
+	m_rng.seed(seed);
+
+	m_tokens      = cfg.burst_bytes > 0 ? cfg.burst_bytes : cfg.rate_bps / 800.0;
+	m_tokens_time = steady_clock::now();
+	m_queue.reserve(cfg.queue_limit);
+
+	spdlog::info(LOG_SC_IMPAIR "delay {} ms, jitter {} ms ({}), loss {}%, GE p {}% r {}% bad-loss {}%, reorder {}%, "
+		"duplicate {}%, rate {} bps, queue {}, seed {}.", cfg.delay_ms, cfg.jitter_ms, cfg.jitter_dist, cfg.loss, cfg.ge_p,
+		cfg.ge_r, cfg.ge_loss_bad, cfg.reorder, cfg.duplicate, cfg.rate_bps, cfg.queue_limit, seed);
+
+	m_scheduler = thread(&stage::scheduler_loop, this);
+}
+
+stage::~stage()
+{
+	stop();
+}
+
+bool stage::is_lost()
+{
+	uniform_real_distribution<double> pct(0, 100);
+
+	if (m_cfg.ge_p > 0)
+	{
+		// The state changes before the message is handled.
+		if (m_ge_bad ? pct(m_rng) < m_cfg.ge_r : pct(m_rng) < m_cfg.ge_p)
+			m_ge_bad = !m_ge_bad;
+		if (m_ge_bad && pct(m_rng) < m_cfg.ge_loss_bad)
+			return true;
+	}
+
+	return m_cfg.loss > 0 && pct(m_rng) < m_cfg.loss;
+}
+
+steady_clock::duration stage::random_delay()
+{
+	double delay_ms = m_cfg.delay_ms;
+	if (m_cfg.jitter_ms > 0)
+	{
+		const double jitter = m_cfg.jitter_ms;
+		if (m_cfg.jitter_dist == "normal")
+		{
+			delay_ms += normal_distribution<double>(0, jitter)(m_rng);
+		}
+		else if (m_cfg.jitter_dist == "pareto")
+		{
+			// Heavy-tailed additional delay with the shape 3: the mean is x_m / 2.
+			const double u = uniform_real_distribution<double>(0, 1)(m_rng);
+			delay_ms += 2 * jitter * (pow(1 - u, -1.0 / 3) - 1);
+		}
+		else
+		{
+			delay_ms += uniform_real_distribution<double>(-jitter, jitter)(m_rng);
+		}
+	}
+
+	return duration_cast<steady_clock::duration>(duration<double, milli>(max(delay_ms, 0.0)));
+}
+
+void stage::submit(const const_buffer& msg)
+{
+	if (m_failed)
+		rethrow_exception(m_sink_error);
+
+	inc(m_in);
+	if (is_lost())
+	{
+		inc(m_lost);
+		return;
+	}
+
+	uniform_real_distribution<double> pct(0, 100);
+	const int copies = (m_cfg.duplicate > 0 && pct(m_rng) < m_cfg.duplicate) ? 2 : 1;
+	if (copies > 1)
+		inc(m_duplicated);
+
+	const auto now = steady_clock::now();
+	for (int i = 0; i < copies; ++i)
+	{
+		// A reordered message is not delayed and overtakes the messages waiting in the queue.
+		const bool reorder = m_cfg.reorder > 0 && pct(m_rng) < m_cfg.reorder;
+		if (reorder)
+			inc(m_reordered);
+		enqueue(msg, reorder ? now : now + random_delay());
+	}
+}
+
+void stage::enqueue(const const_buffer& msg, steady_clock::time_point due)
+{
+	lock_guard<mutex> lck(m_mtx);
+	if (m_queue.size() + m_in_flight >= static_cast<size_t>(m_cfg.queue_limit))
+	{
+		inc(m_queue_drops);
+		return;
+	}
+
+	vector<char> data;
+	if (!m_spare.empty())
+	{
+		data = std::move(m_spare.back());
+		m_spare.pop_back();
+	}
+	data.resize(max(m_message_size, msg.size()));
+	memcpy(data.data(), msg.data(), msg.size());
+
+	const bool earliest = m_queue.empty() || due < m_queue.front().due;
+	m_queue.push_back(message{due, m_seq++, std::move(data), msg.size()});
+	push_heap(m_queue.begin(), m_queue.end(), later);
+
+	// The scheduler only has to wake up if its next deadline has changed.
+	if (earliest)
+		m_cv.notify_one();
+}
+
+void stage::stop()
+{
+	{
+		lock_guard<mutex> lck(m_mtx);
+		if (m_stop)
+			return;
+		m_stop = true;
+		m_cv.notify_one();
+	}
+
+	if (m_scheduler.joinable())
+		m_scheduler.join();
+
+	const auto s = get_stats();
+	spdlog::info(LOG_SC_IMPAIR "{} messages in, {} out, {} lost, {} duplicated, {} reordered, {} dropped (queue full), "
+		"{} discarded. Rate limit wait {} ms.", s.in, s.out, s.lost, s.duplicated, s.reordered, s.queue_drops,
+		m_queue.size(), s.shaped_us / 1000);
+}
+
+void stage::shape(size_t len)
+{
+	if (m_cfg.rate_bps <= 0)
+		return;
+
+	const double bytes_per_us = m_cfg.rate_bps / 8e6;
+	const double bucket_size  = m_cfg.burst_bytes > 0 ? m_cfg.burst_bytes : m_cfg.rate_bps / 800.0;
+
+	const auto now = steady_clock::now();
+	m_tokens       = min(bucket_size, m_tokens + duration_cast<microseconds>(now - m_tokens_time).count() * bytes_per_us);
+	m_tokens_time  = now;
+	m_tokens -= static_cast<double>(len);
+	if (m_tokens >= 0)
+		return;
+
+	// Wait until the debt is paid off.
+	const auto wait_us = static_cast<long long>(ceil(-m_tokens / bytes_per_us));
+	this_thread::sleep_until(now + microseconds(wait_us));
+	const auto end = steady_clock::now();
+	inc(m_shaped_us, duration_cast<microseconds>(end - now).count());
+	m_tokens      += duration_cast<microseconds>(end - now).count() * bytes_per_us;
+	m_tokens_time  = end;
+}
+
+void stage::scheduler_loop()
+{
+	XTR_THREADNAME(std::string("XTR:Impair"));
+	vector<message> due;
+
+	unique_lock<mutex> lck(m_mtx);
+	while (!m_stop)
+	{
+		if (m_queue.empty())
+		{
+			m_cv.wait(lck, [this]() { return m_stop || !m_queue.empty(); });
+			continue;
+		}
+
+		const auto next = m_queue.front().due;
+		if (next > steady_clock::now())
+		{
+			m_cv.wait_until(lck, next, [this, next]() { return m_stop || m_queue.front().due < next; });
+			continue;
+		}
+
+		// Take all the messages already due in one go.
+		const auto now = steady_clock::now();
+		while (!m_queue.empty() && m_queue.front().due <= now)
+		{
+			pop_heap(m_queue.begin(), m_queue.end(), later);
+			due.push_back(std::move(m_queue.back()));
+			m_queue.pop_back();
+		}
+		m_in_flight = due.size();
+		lck.unlock();
+
+		try
+		{
+			for (auto& msg : due)
+			{
+				shape(msg.len);
+				m_sink(const_buffer(msg.data.data(), msg.len));
+				inc(m_out);
+			}
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::error(LOG_SC_IMPAIR "{}", e.what());
+			lck.lock();
+			m_sink_error = current_exception();
+			m_failed     = true;
+			break;
+		}
+
+		lck.lock();
+		for (auto& msg : due)
+			m_spare.push_back(std::move(msg.data));
+		due.clear();
+		m_in_flight = 0;
+	}
+}
+
+stage::stats stage::get_stats() const
+{
+	stats s;
+	s.in          = m_in.load(memory_order_relaxed);
+	s.out         = m_out.load(memory_order_relaxed);
+	s.lost        = m_lost.load(memory_order_relaxed);
+	s.duplicated  = m_duplicated.load(memory_order_relaxed);
+	s.reordered   = m_reordered.load(memory_order_relaxed);
+	s.queue_drops = m_queue_drops.load(memory_order_relaxed);
+	s.shaped_us   = m_shaped_us.load(memory_order_relaxed);
+	return s;
+}
+
+stage::stats stage::stats::operator-(const stats& prev) const
+{
+	stats s;
+	s.in          = in - prev.in;
+	s.out         = out - prev.out;
+	s.lost        = lost - prev.lost;
+	s.duplicated  = duplicated - prev.duplicated;
+	s.reordered   = reordered - prev.reordered;
+	s.queue_drops = queue_drops - prev.queue_drops;
+	s.shaped_us   = shaped_us - prev.shaped_us;
+	return s;
+}
+
+stage::stats stage_stats::next_interval()
+{
+	const auto curr = m_stage->get_stats();
+	const auto s    = curr - m_prev;
+	m_prev          = curr;
+	return s;
+}
+
+const string stage_stats::stats_to_csv(bool print_header)
+{
+	if (print_header)
+		return "pktImpairIn,pktImpairOut,pktImpairLost,pktImpairDuplicated,pktImpairReordered,pktImpairQueueDrops,usImpairShaped";
+
+	const auto s = next_interval();
+	stringstream ss;
+	ss << s.in << ',';
+	ss << s.out << ',';
+	ss << s.lost << ',';
+	ss << s.duplicated << ',';
+	ss << s.reordered << ',';
+	ss << s.queue_drops << ',';
+	ss << s.shaped_us;
+	return ss.str();
+}
+
+const nlohmann::json stage_stats::stats_to_json()
+{
+	const auto s = next_interval();
+	nlohmann::json root;
+	root["pktIn"]         = s.in;
+	root["pktOut"]        = s.out;
+	root["pktLost"]       = s.lost;
+	root["pktDuplicated"] = s.duplicated;
+	root["pktReordered"]  = s.reordered;
+	root["pktQueueDrops"] = s.queue_drops;
+	root["usShaped"]      = s.shaped_us;
+	return root;
+}
+
+} // namespace impairment
+} // namespace xtransmit
@@ -0,0 +1,167 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// xtransmit
+#include "buffer.hpp"
+#include "socket_stats.hpp"
+
+namespace xtransmit
+{
+namespace impairment
+{
+
+struct config
+{
+	int         delay_ms    = 0;         // Fixed delay.
+	int         jitter_ms   = 0;         // Random delay variation.
+	std::string jitter_dist = "uniform"; // Jitter distribution: uniform [-jitter, +jitter], normal (sigma = jitter), pareto (mean = jitter).
+	double      loss        = 0;         // Bernoulli loss probability, %.
+	double      ge_p        = 0;         // Gilbert-Elliott: probability of the transition from the good to the bad state, %.
+	double      ge_r        = 0;         // Gilbert-Elliott: probability of the transition from the bad to the good state, %.
+	double      ge_loss_bad = 100;       // Gilbert-Elliott: loss probability in the bad state, %.
+	double      reorder     = 0;         // Probability of a message to be sent immediately, ahead of the delayed ones, %.
+	double      duplicate   = 0;         // Probability of a message to be duplicated, %.
+	int64_t     rate_bps    = 0;         // Token bucket rate limit, bits per second (0 - no limit).
+	int         burst_bytes = 0;         // Token bucket size (0 - 10 ms at the rate limit).
+	int         queue_limit = 10000;     // The maximum number of messages waiting to be sent.
+	unsigned    seed        = 0;         // Random generator seed (0 - random).
+
+	bool enabled() const
+	{
+		return delay_ms > 0 || jitter_ms > 0 || loss > 0 || ge_p > 0 || reorder > 0 || duplicate > 0 || rate_bps > 0;
+	}
+};
+
+/// Network impairment emulation stage. Messages submitted by one thread are lost, duplicated,
+/// delayed and reordered according to the configuration, and are passed to the sink
+/// by a scheduling thread at their due time, limited by the token bucket rate.
+class stage
+{
+public:
+	using sink_fn = std::function<void(const const_buffer&)>;
+
+	/// @param sink  called by the scheduling thread for every message leaving the stage.
+	///              May throw socket::exception to stop the stage.
+	stage(const config& cfg, size_t message_size, sink_fn sink);
+	~stage();
+
+	stage(const stage&) = delete;
+	stage& operator=(const stage&) = delete;
+
+public:
+	/// Pass a message through the stage. Never blocks on the sink.
+	/// Must be called from one thread only.
+	/// @throws the exception thrown by the sink, if any.
+	void submit(const const_buffer& msg);
+
+	/// Stop the scheduling thread. Messages still waiting in the queue are discarded.
+	void stop();
+
+	struct stats
+	{
+		uint64_t in          = 0; // Messages submitted.
+		uint64_t out         = 0; // Messages passed to the sink.
+		uint64_t lost        = 0; // Messages lost (Bernoulli or Gilbert-Elliott).
+		uint64_t duplicated  = 0;
+		uint64_t reordered   = 0;
+		uint64_t queue_drops = 0; // Messages dropped because the queue was full.
+		uint64_t shaped_us   = 0; // Time the scheduling thread waited for the token bucket.
+
+		stats operator-(const stats& prev) const;
+	};
+
+	/// Get cumulative values. Safe to call from any thread.
+	stats get_stats() const;
+
+private:
+	struct message
+	{
+		std::chrono::steady_clock::time_point due;
+		uint64_t                              seq; // Keeps the submission order for the same due time.
+		std::vector<char>                     data;
+		size_t                                len;
+	};
+
+	/// Heap order: the earliest due time on top, the same due time keeps the submission order.
+	static bool later(const message& a, const message& b);
+
+	bool is_lost();
+	std::chrono::steady_clock::duration random_delay();
+	void enqueue(const const_buffer& msg, std::chrono::steady_clock::time_point due);
+	void scheduler_loop();
+	void shape(size_t len);
+
+	static void inc(std::atomic<uint64_t>& counter, uint64_t val = 1)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+	}
+
+private:
+	const config  m_cfg;
+	const size_t  m_message_size;
+	const sink_fn m_sink;
+
+	// Accessed by the submitting thread only.
+	std::mt19937_64 m_rng;
+	bool            m_ge_bad = false;
+	uint64_t        m_seq    = 0;
+
+	// Accessed by the scheduling thread only.
+	double                                m_tokens = 0;
+	std::chrono::steady_clock::time_point m_tokens_time;
+
+	// Shared between the submitting and the scheduling threads.
+	std::mutex                     m_mtx;
+	std::condition_variable        m_cv;
+	std::vector<message>           m_queue;  // Min-heap by due time.
+	std::vector<std::vector<char>> m_spare;  // Recycled message buffers.
+	size_t                         m_in_flight = 0; // Taken from the queue, not yet sent.
+	bool                           m_stop      = false;
+	std::exception_ptr             m_sink_error;
+	std::atomic_bool               m_failed{false};
+	std::thread                    m_scheduler;
+
+	std::atomic<uint64_t> m_in{0};
+	std::atomic<uint64_t> m_out{0};
+	std::atomic<uint64_t> m_lost{0};
+	std::atomic<uint64_t> m_duplicated{0};
+	std::atomic<uint64_t> m_reordered{0};
+	std::atomic<uint64_t> m_queue_drops{0};
+	std::atomic<uint64_t> m_shaped_us{0};
+};
+
+/// Reports impairment stage statistics to the stats file.
+class stage_stats : public socket::stats_extension
+{
+public:
+	explicit stage_stats(std::shared_ptr<const stage> s)
+		: m_stage(std::move(s))
+	{
+	}
+
+public:
+	const std::string    stats_to_csv(bool print_header) final;
+	const nlohmann::json stats_to_json() final;
+	const char*          json_key() const final { return "ImpairStats"; }
+
+private:
+	stage::stats next_interval();
+
+private:
+	std::shared_ptr<const stage> m_stage;
+	stage::stats                 m_prev;
+};
+
+} // namespace impairment
+} // namespace xtransmit
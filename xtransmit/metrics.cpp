@@ -151,9 +151,66 @@ bool validate_packet_checksum(const const_buffer& payload)
 	return cmpres == 0;
 }
 
-std:: string validator::stats()
+validator::snapshot validator::take_snapshot()
 {
 	std::lock_guard<std::mutex> lock(m_mtx);
+	snapshot s;
+	s.id              = m_id;
+	s.latency_min     = m_latency.get_latency_min();
+	s.latency_max     = m_latency.get_latency_max();
+	s.latency_avg     = m_latency.get_latency_avg();
+	s.jitter          = m_jitter.get_jitter();
+	s.delay_factor    = m_delay_factor.get_delay_factor();
+	s.reorder_stats   = m_reorder.get_stats();
+	s.integrity_stats = m_integrity.get_stats();
+	s.has_srt         = m_has_srt;
+	s.srt_stats       = m_srt.get_stats();
+
+	m_latency.reset();
+	m_delay_factor.reset();
+	m_srt.reset();
+
+	return s;
+}
+
+validator::snapshot validator::merge(const vector<snapshot>& shards, const sharded_loss& loss)
+{
+	snapshot s;
+	if (shards.empty())
+		return s;
+
+	s.id = shards[0].id;
+	long long latency_sum = 0;
+	int       latency_cnt = 0;
+	for (const auto& shard : shards)
+	{
+		s.id           = min(s.id, shard.id);
+		s.latency_min  = min(s.latency_min, shard.latency_min);
+		s.latency_max  = max(s.latency_max, shard.latency_max);
+		s.jitter       = max(s.jitter, shard.jitter);
+		s.delay_factor = max(s.delay_factor, shard.delay_factor);
+		if (shard.latency_avg != -1)
+		{
+			latency_sum += shard.latency_avg;
+			++latency_cnt;
+		}
+
+		s.reorder_stats.pkts_processed += shard.reorder_stats.pkts_processed;
+		s.reorder_stats.pkts_reordered += shard.reorder_stats.pkts_reordered;
+		s.reorder_stats.reorder_dist   = max(s.reorder_stats.reorder_dist, shard.reorder_stats.reorder_dist);
+		s.integrity_stats.pkts_wrong_checksum += shard.integrity_stats.pkts_wrong_checksum;
+		s.integrity_stats.pkts_wrong_len      += shard.integrity_stats.pkts_wrong_len;
+		s.has_srt = s.has_srt || shard.has_srt;
+	}
+
+	if (latency_cnt > 0)
+		s.latency_avg = latency_sum / latency_cnt;
+	s.reorder_stats.pkts_lost = loss.pkts_lost();
+	return s;
+}
+
+std::string validator::to_str(const snapshot& s)
+{
 	std::stringstream ss;
 
 	auto latency_str = [](long long val, long long na_val) -> string {
@@ -162,25 +219,26 @@ std:: string validator::stats()
 		return to_string(val);
 	};
 
-	const auto latency_min = m_latency.get_latency_min();
-	const auto latency_max = m_latency.get_latency_max();
-	
 	ss << "Latency, us: avg ";
-	ss << latency_str(m_latency.get_latency_avg(), -1) << ", min ";
-	ss << latency_str(latency_min, numeric_limits<long long>::max()) << ", max ";
-	ss << latency_str(latency_max, numeric_limits<long long>::min());
-	ss << ". Jitter: " << m_jitter.get_jitter() << "us. ";
-	ss << "Delay Factor: " << m_delay_factor.get_delay_factor() << "us. ";
-	const auto stats = m_reorder.get_stats();
-	ss << "Pkts: rcvd " << stats.pkts_processed << ", reordered " << stats.pkts_reordered;
-	ss << " (dist " << stats.reorder_dist;
-	ss << "), lost " << stats.pkts_lost;
-	const auto intgr_stats = m_integrity.get_stats();
-	ss << ", MD5 err " << intgr_stats.pkts_wrong_checksum;
-	ss << ", bad len " << intgr_stats.pkts_wrong_len << '.';
-
-	m_latency.reset();
-	m_delay_factor.reset();
+	ss << latency_str(s.latency_avg, -1) << ", min ";
+	ss << latency_str(s.latency_min, numeric_limits<long long>::max()) << ", max ";
+	ss << latency_str(s.latency_max, numeric_limits<long long>::min());
+	ss << ". Jitter: " << s.jitter << "us. ";
+	ss << "Delay Factor: " << s.delay_factor << "us. ";
+	ss << "Pkts: rcvd " << s.reorder_stats.pkts_processed << ", reordered " << s.reorder_stats.pkts_reordered;
+	ss << " (dist " << s.reorder_stats.reorder_dist;
+	ss << "), lost " << s.reorder_stats.pkts_lost;
+	ss << ", MD5 err " << s.integrity_stats.pkts_wrong_checksum;
+	ss << ", bad len " << s.integrity_stats.pkts_wrong_len << '.';
+
+	if (s.has_srt)
+	{
+		ss << " SRT delay, us: avg " << latency_str(s.srt_stats.srt_delay_avg, -1) << ", min ";
+		ss << latency_str(s.srt_stats.srt_delay_min, numeric_limits<long long>::max()) << ", max ";
+		ss << latency_str(s.srt_stats.srt_delay_max, numeric_limits<long long>::min());
+		ss << ". App delay, us: avg " << latency_str(s.srt_stats.app_delay_avg, -1);
+		ss << ". SRT dropped " << s.srt_stats.msgs_dropped << '.';
+	}
 
 	return ss.str();
 }
@@ -203,20 +261,24 @@ string validator::stats_csv_header()
 	ss << "pktReordered,";
 	ss << "pktReorderDist,";
 	ss << "pktChecksumError,";
-	ss << "pktLengthError";
+	ss << "pktLengthError,";
+	ss << "usSrtDelayMin,";
+	ss << "usSrtDelayMax,";
+	ss << "usSrtDelayAvg,";
+	ss << "usAppDelayAvg,";
+	ss << "pktSrtDropped";
 	ss << '\n';
 	return ss.str();
 }
 
-string validator::stats_csv()
+string validator::to_csv(const snapshot& s)
 {
 	stringstream ss;
 
-	std::lock_guard<std::mutex> lock(m_mtx);
 #ifdef HAS_PUT_TIME
 	ss << print_timestamp_now() << ',';
 #endif
-	ss << m_id << ',';
+	ss << s.id << ',';
 
 	// Empty string (N/A) on default-initialized latency min and max values.
 	auto latency_str = [](long long val, long long na_val) -> string {
@@ -225,26 +287,33 @@ string validator::stats_csv()
 		return to_string(val);
 	};
 
-	const auto latency_min = m_latency.get_latency_min();
-	ss << latency_str(latency_min, numeric_limits<long long>::max()) << ',';
-	const auto latency_max = m_latency.get_latency_max();
-	ss << latency_str(latency_max, numeric_limits<long long>::min()) << ',';
-	ss << latency_str(m_latency.get_latency_avg(), -1) << ',';
-	ss << m_jitter.get_jitter() << ',';
-	ss << m_delay_factor.get_delay_factor() << ',';
-	const auto stats = m_reorder.get_stats();
-	ss << stats.pkts_processed << ',';
-	ss << stats.pkts_lost << ',';
-	ss << stats.pkts_reordered << ',';
-	ss << stats.reorder_dist << ',';
-	const auto intgr_stats = m_integrity.get_stats();
-	ss << intgr_stats.pkts_wrong_checksum << ',';
-	ss << intgr_stats.pkts_wrong_len;
+	ss << latency_str(s.latency_min, numeric_limits<long long>::max()) << ',';
+	ss << latency_str(s.latency_max, numeric_limits<long long>::min()) << ',';
+	ss << latency_str(s.latency_avg, -1) << ',';
+	ss << s.jitter << ',';
+	ss << s.delay_factor << ',';
+	ss << s.reorder_stats.pkts_processed << ',';
+	ss << s.reorder_stats.pkts_lost << ',';
+	ss << s.reorder_stats.pkts_reordered << ',';
+	ss << s.reorder_stats.reorder_dist << ',';
+	ss << s.integrity_stats.pkts_wrong_checksum << ',';
+	ss << s.integrity_stats.pkts_wrong_len << ',';
+
+	// Empty SRT columns if not received over SRT.
+	if (s.has_srt)
+	{
+		ss << latency_str(s.srt_stats.srt_delay_min, numeric_limits<long long>::max()) << ',';
+		ss << latency_str(s.srt_stats.srt_delay_max, numeric_limits<long long>::min()) << ',';
+		ss << latency_str(s.srt_stats.srt_delay_avg, -1) << ',';
+		ss << latency_str(s.srt_stats.app_delay_avg, -1) << ',';
+		ss << s.srt_stats.msgs_dropped;
+	}
+	else
+	{
+		ss << ",,,,";
+	}
 	ss << '\n';
 
-	m_latency.reset();
-	m_delay_factor.reset();
-
 	return ss.str();
 }
 
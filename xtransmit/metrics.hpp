@@ -15,6 +15,7 @@
 #include "metrics_delay_factor.hpp" // Time-Stamped Delay Factor (TS-DF) (EBU TECH 3337)
 #include "metrics_reorder.hpp"      // RFC 4737
 #include "metrics_integrity.hpp"
+#include "metrics_srt.hpp"          // SRT delay and drops (SRT_MSGCTRL)
 
 namespace xtransmit
 {
@@ -70,9 +71,16 @@ namespace metrics
 	class validator
 	{
 	public:
-		validator(int id) : m_id(id) {}
+		/// @param shard_loss  loss tracking shared with the validators of the other shards
+		///                    receiving the same stream (see sharded_loss). nullptr if not sharded.
+		explicit validator(int id, std::shared_ptr<sharded_loss> shard_loss = nullptr)
+			: m_id(id)
+			, m_reorder(shard_loss == nullptr)
+			, m_shard_loss(std::move(shard_loss))
+		{}
 
-		inline void validate_packet(const const_buffer& payload)
+		/// @param srt_info  SRT message control of the message, nullptr if not received over SRT
+		inline void validate_packet(const const_buffer& payload, const srt_msg_info* srt_info = nullptr)
 		{
 			std::lock_guard<std::mutex> lock(m_mtx);
 			const auto sys_time_now = system_clock::now();
@@ -90,19 +98,59 @@ namespace metrics
 				// Do not calculate other metrics, packet payload is corrupted,
 				// the embeded metadata is probably invalid.
 				m_reorder.inc_pkts_received();
+				if (srt_info)
+				{
+					m_has_srt = true;
+					m_srt.submit_sample(*srt_info, -1);
+				}
 				return;
 			}
 
 			m_latency.submit_sample(sys_timestamp, sys_time_now);
+			if (srt_info)
+			{
+				m_has_srt = true;
+				m_srt.submit_sample(*srt_info, duration_cast<microseconds>(sys_time_now - sys_timestamp).count());
+			}
 			m_jitter.submit_sample(std_timestamp, std_time_now);
 			m_delay_factor.submit_sample(std_timestamp, std_time_now);
 			m_reorder.submit_sample(pktseqno);
+			if (m_shard_loss)
+				m_shard_loss->submit(pktseqno);
 		}
 
-		std::string stats();
-		std::string stats_csv();
+		/// Metric values of a measurement period.
+		struct snapshot
+		{
+			int id = 0;
+			long long latency_min = numeric_limits<long long>::max(); // max() if n/a
+			long long latency_max = numeric_limits<long long>::min(); // min() if n/a
+			long long latency_avg = -1;                               // -1 if n/a
+			uint64_t jitter = 0;
+			int64_t delay_factor = 0;
+			reorder::stats reorder_stats;
+			integrity::stats integrity_stats;
+			bool has_srt = false; // SRT message control was provided.
+			srt_delivery::stats srt_stats;
+		};
+
+		/// Get the values and start a new measurement period.
+		snapshot take_snapshot();
+
+		/// Combine the snapshots of the shards of one stream into a single one.
+		/// Loss is taken from the shared tracker, latency min and max, jitter and delay factor are
+		/// the worst among the shards, the smoothed latency is the average.
+		static snapshot merge(const vector<snapshot>& shards, const sharded_loss& loss);
+
+		static std::string to_str(const snapshot& s);
+		static std::string to_csv(const snapshot& s);
+
+		std::string stats() { return to_str(take_snapshot()); }
+		std::string stats_csv() { return to_csv(take_snapshot()); }
 		static std::string stats_csv_header();
 
+		const std::shared_ptr<sharded_loss>& shard_loss() const { return m_shard_loss; }
+
 	private:
 		const int m_id;
 		latency m_latency;
@@ -110,6 +158,9 @@ namespace metrics
 		delay_factor m_delay_factor;
 		reorder m_reorder;
 		integrity m_integrity;
+		srt_delivery m_srt;
+		bool m_has_srt = false;
+		const std::shared_ptr<sharded_loss> m_shard_loss;
 		mutable std::mutex m_mtx;
 	};
 
@@ -0,0 +1,120 @@
+#include <sstream>
+#include "metrics_histogram.hpp"
+
+// nlohmann_json
+#include <nlohmann/json.hpp>
+
+namespace xtransmit {
+namespace metrics {
+
+using namespace std;
+
+template <size_t N>
+typename basic_histogram<N>::snapshot basic_histogram<N>::get_snapshot() const
+{
+	snapshot s;
+	for (size_t i = 0; i < num_buckets; ++i)
+	{
+		s.buckets[i] = m_buckets[i].load(memory_order_relaxed);
+		s.count += s.buckets[i];
+	}
+	s.sum_us = m_sum_us.load(memory_order_relaxed);
+	return s;
+}
+
+template <size_t N>
+typename basic_histogram<N>::snapshot basic_histogram<N>::snapshot::operator-(const snapshot& prev) const
+{
+	snapshot s;
+	for (size_t i = 0; i < num_buckets; ++i)
+		s.buckets[i] = buckets[i] - prev.buckets[i];
+	s.count  = count - prev.count;
+	s.sum_us = sum_us - prev.sum_us;
+	return s;
+}
+
+template <size_t N>
+long long basic_histogram<N>::snapshot::avg_us() const
+{
+	return count ? static_cast<long long>(sum_us / count) : -1;
+}
+
+template <size_t N>
+long long basic_histogram<N>::snapshot::percentile_us(unsigned pct) const
+{
+	if (count == 0)
+		return -1;
+
+	// The number of samples that must be at or below the percentile (rounded up).
+	const uint64_t rank = (count * pct + 99) / 100;
+	uint64_t       acc  = 0;
+	for (size_t i = 0; i < num_buckets; ++i)
+	{
+		acc += buckets[i];
+		if (acc >= rank && acc > 0)
+			return bucket_upper_us(i);
+	}
+
+	return -1;
+}
+
+template <size_t N>
+string basic_histogram<N>::snapshot::csv_header(const string& prefix)
+{
+	stringstream ss;
+	ss << "pkt" << prefix << ",";
+	ss << "us" << prefix << "Avg,";
+	ss << "us" << prefix << "P50,";
+	ss << "us" << prefix << "P99,";
+	ss << "us" << prefix << "Max";
+	for (size_t i = 0; i < num_buckets; ++i)
+	{
+		const long long upper = bucket_upper_us(i);
+		ss << ",pkt" << prefix;
+		if (upper < 0)
+			ss << "Ge" << (1LL << (i - 1)) << "us";
+		else
+			ss << "Lt" << upper << "us";
+	}
+	return ss.str();
+}
+
+template <size_t N>
+string basic_histogram<N>::snapshot::to_csv() const
+{
+	// Empty string (N/A) if there are no samples.
+	auto na_str = [](long long val) -> string {
+		if (val < 0)
+			return "";
+		return to_string(val);
+	};
+
+	stringstream ss;
+	ss << count << ',';
+	ss << na_str(avg_us()) << ',';
+	ss << na_str(percentile_us(50)) << ',';
+	ss << na_str(percentile_us(99)) << ',';
+	ss << na_str(max_us());
+	for (const uint64_t b : buckets)
+		ss << ',' << b;
+	return ss.str();
+}
+
+template <size_t N>
+nlohmann::json basic_histogram<N>::snapshot::to_json() const
+{
+	nlohmann::json root;
+	root["count"] = count;
+	root["usAvg"] = avg_us();
+	root["usP50"] = percentile_us(50);
+	root["usP99"] = percentile_us(99);
+	root["usMax"] = max_us();
+	root["buckets"] = buckets;
+	return root;
+}
+
+template class basic_histogram<histogram::num_buckets>;
+template class basic_histogram<long_histogram::num_buckets>;
+
+} // namespace metrics
+} // namespace xtransmit
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// nlohmann_json
+#include <nlohmann/json_fwd.hpp>
+
+namespace xtransmit
+{
+namespace metrics
+{
+
+/// Histogram of durations with power-of-two microsecond buckets.
+/// Bucket 0 counts samples below 1 us, bucket i counts samples in [2^(i-1), 2^i) us.
+/// The last bucket (starting at 2^(NumBuckets-2) us) also collects all samples above the range.
+///
+/// Counters are cumulative and are updated by a single writer thread without locking.
+/// A reader takes snapshots and subtracts the previous one to get per-interval values.
+template <size_t NumBuckets>
+class basic_histogram
+{
+public:
+	static constexpr size_t num_buckets = NumBuckets;
+
+	struct snapshot
+	{
+		std::array<uint64_t, num_buckets> buckets = {};
+		uint64_t count  = 0;
+		uint64_t sum_us = 0;
+
+		snapshot operator-(const snapshot& prev) const;
+
+		/// Average sample value, us. -1 if there are no samples.
+		long long avg_us() const;
+
+		/// Upper bound (us) of the bucket holding the given percentile.
+		/// -1 if there are no samples or the percentile falls into the last (open) bucket.
+		long long percentile_us(unsigned pct) const;
+
+		/// Upper bound (us) of the highest non-empty bucket (see percentile_us).
+		long long max_us() const { return percentile_us(100); }
+
+		/// CSV column names (no leading or trailing delimiter), e.g. "pktWrite,usWriteAvg,...".
+		static std::string csv_header(const std::string& prefix);
+		std::string to_csv() const;
+		nlohmann::json to_json() const;
+	};
+
+public:
+	/// Submit new sample. Must be called by one thread only.
+	inline void submit_sample(const std::chrono::steady_clock::duration& d)
+	{
+		const long long us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+		auto& bucket = m_buckets[bucket_index(us)];
+		// Single writer: no need for an atomic read-modify-write.
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		m_sum_us.store(m_sum_us.load(std::memory_order_relaxed) + (us > 0 ? us : 0), std::memory_order_relaxed);
+	}
+
+	/// Get cumulative values. Safe to call from any thread.
+	snapshot get_snapshot() const;
+
+	/// Upper bound (exclusive) of the bucket, us. -1 for the last (open) bucket.
+	static long long bucket_upper_us(size_t idx) { return idx + 1 < num_buckets ? (1LL << idx) : -1; }
+
+private:
+	static inline size_t bucket_index(long long us)
+	{
+		size_t idx = 0;
+		while (us > 0 && idx + 1 < num_buckets)
+		{
+			us >>= 1;
+			++idx;
+		}
+		return idx;
+	}
+
+private:
+	std::array<std::atomic<uint64_t>, num_buckets> m_buckets = {};
+	std::atomic<uint64_t>                          m_sum_us{0};
+};
+
+template <size_t NumBuckets>
+constexpr size_t basic_histogram<NumBuckets>::num_buckets;
+
+/// The last bucket starts at 2^19 us (~0.5 s): write calls, hop latency.
+using histogram = basic_histogram<21>;
+
+/// The last bucket starts at 2^25 us (~33 s): connection handshakes, bounded by the connect timeout.
+using long_histogram = basic_histogram<27>;
+
+} // namespace metrics
+} // namespace xtransmit
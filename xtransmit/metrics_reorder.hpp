@@ -1,6 +1,10 @@
 #pragma once
 #include <algorithm> // std::max
+#include <atomic>
+#include <bitset>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 
 namespace xtransmit
 {
@@ -10,7 +14,12 @@ namespace metrics
 class reorder
 {
 public:
-	reorder() {}
+	/// @param gaps_are_losses  a gap in sequence numbers is a loss. Not the case when packets
+	///                         of a stream are spread between several receivers (see sharded_loss).
+	explicit reorder(bool gaps_are_losses = true)
+		: m_gaps_are_losses(gaps_are_losses)
+	{
+	}
 
 public:
 	struct stats
@@ -36,7 +45,11 @@ public:
 		}
 
 		// Sequence discontinuity (loss)
-		if (pkt_seqno > m_stats.expected_seqno)
+		if (pkt_seqno > m_stats.expected_seqno && !m_gaps_are_losses)
+		{
+			m_stats.expected_seqno = pkt_seqno + 1;
+		}
+		else if (pkt_seqno > m_stats.expected_seqno)
 		{
 			const uint64_t lost = pkt_seqno - m_stats.expected_seqno;
 			m_stats.pkts_lost += lost;
@@ -66,9 +79,105 @@ public:
 	stats get_stats() const { return m_stats; }
 
 private:
-	stats m_stats;
+	const bool m_gaps_are_losses;
+	stats      m_stats;
 };
 
+/// Loss tracking of one stream received by several sockets (shards) read by concurrent threads.
+///
+/// The kernel spreads packets of the stream between the shards, so a sequence number gap seen by
+/// one shard is not a loss. Instead every shard marks received sequence numbers in a shared bitmap
+/// window, and the numbers not marked by the time the window moves past them are counted as lost.
+/// Lock-free. A packet arriving after the window has moved past it is counted as late.
+class sharded_loss
+{
+public:
+	/// @param window  the number of sequence numbers tracked, rounded up to a multiple of 128
+	explicit sharded_loss(size_t window = 1 << 20)
+		: m_words((window + 127) / 128 * 2)
+		, m_bits(new std::atomic<uint64_t>[m_words])
+	{
+		for (size_t i = 0; i < m_words; ++i)
+			m_bits[i].store(0, std::memory_order_relaxed);
+	}
+
+	/// Mark a received sequence number.
+	void submit(uint64_t seqno)
+	{
+		uint64_t base = m_base.load(std::memory_order_acquire);
+		if (base == NOT_STARTED)
+		{
+			// The stream may be joined in the middle: start the window at the first packet received.
+			const uint64_t first = seqno & ~uint64_t(63);
+			if (m_base.compare_exchange_strong(base, first, std::memory_order_acq_rel))
+			{
+				base = first;
+				m_bits[word_idx(seqno)].fetch_or((uint64_t(1) << (seqno & 63)) - 1, std::memory_order_relaxed);
+			}
+		}
+
+		uint64_t high = m_high.load(std::memory_order_relaxed);
+		while (seqno + 1 > high && !m_high.compare_exchange_weak(high, seqno + 1, std::memory_order_relaxed))
+		{
+		}
+
+		// Do not let the window wrap around between the periodic calls of advance().
+		if (seqno >= base + m_words * 64 * 3 / 4)
+		{
+			advance();
+			base = m_base.load(std::memory_order_acquire);
+		}
+
+		if (seqno < base)
+		{
+			m_late.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		m_bits[word_idx(seqno)].fetch_or(uint64_t(1) << (seqno & 63), std::memory_order_relaxed);
+	}
+
+	/// Move the window on up to half a window behind the highest sequence number received,
+	/// counting the numbers not received as lost.
+	void advance()
+	{
+		if (m_advancing.test_and_set(std::memory_order_acquire))
+			return;
+
+		uint64_t base = m_base.load(std::memory_order_acquire);
+		if (base != NOT_STARTED)
+		{
+			const uint64_t high = m_high.load(std::memory_order_relaxed);
+			const uint64_t half = m_words * 64 / 2;
+			uint64_t       lost = 0;
+			while (base + 64 + half <= high)
+			{
+				const uint64_t word = m_bits[word_idx(base)].exchange(0, std::memory_order_acq_rel);
+				lost += 64 - std::bitset<64>(word).count();
+				base += 64;
+			}
+			m_base.store(base, std::memory_order_release);
+			m_lost.fetch_add(lost, std::memory_order_relaxed);
+		}
+
+		m_advancing.clear(std::memory_order_release);
+	}
+
+	uint64_t pkts_lost() const { return m_lost.load(std::memory_order_relaxed); }
+	uint64_t pkts_late() const { return m_late.load(std::memory_order_relaxed); }
+
+private:
+	size_t word_idx(uint64_t seqno) const { return (seqno / 64) % m_words; }
+
+	static constexpr uint64_t NOT_STARTED = UINT64_MAX;
+
+	const size_t                             m_words;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_bits;
+	std::atomic<uint64_t>                    m_base{NOT_STARTED}; // The lowest sequence number not yet decided, a multiple of 64.
+	std::atomic<uint64_t>                    m_high{0};           // The highest sequence number received + 1.
+	std::atomic<uint64_t>                    m_late{0};
+	std::atomic<uint64_t>                    m_lost{0};
+	std::atomic_flag                         m_advancing = ATOMIC_FLAG_INIT;
+};
 
 } // namespace metrics
 } // namespace xtransmit
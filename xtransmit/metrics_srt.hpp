@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm> // std::max
+#include <cstdint>
+#include <limits>
+
+// submodules
+#include "spdlog/spdlog.h"
+
+namespace xtransmit
+{
+namespace metrics
+{
+
+/// SRT message control of a received message (see SRT_MSGCTRL).
+struct srt_msg_info
+{
+	int64_t srctime_us = 0;  // Source time of the message (SRT clock, srt_time_now()).
+	int64_t rcvtime_us = 0;  // The time the message was read (SRT clock).
+	int32_t pktseq     = -1; // Sequence number of the first packet of the message.
+	int32_t msgno      = -1; // Message number.
+};
+
+/// SRT delivery: the delay of a message inside SRT (from the source time to the read,
+/// including the TSBPD latency), the rest of the end-to-end delay taken by the application,
+/// and the messages SRT has dropped (gaps in the message numbers).
+class srt_delivery
+{
+public:
+	srt_delivery() {}
+
+public:
+	struct stats
+	{
+		long long srt_delay_min = std::numeric_limits<long long>::max(); // max() if n/a
+		long long srt_delay_max = std::numeric_limits<long long>::min(); // min() if n/a
+		long long srt_delay_avg = -1;                                    // -1 if n/a
+		long long app_delay_avg = -1;                                    // -1 if n/a
+		uint64_t  msgs_dropped  = 0;
+	};
+
+public:
+	/// Submit new sample for SRT delivery update.
+	/// @param [in] info  message control of the received message
+	/// @param [in] latency_us  end-to-end delay of the message taken from the payload, -1 if n/a
+	void submit_sample(const srt_msg_info& info, long long latency_us)
+	{
+		if (info.srctime_us > 0)
+		{
+			const long long delay = info.rcvtime_us - info.srctime_us;
+			m_stats.srt_delay_min = std::min(m_stats.srt_delay_min, delay);
+			m_stats.srt_delay_max = std::max(m_stats.srt_delay_max, delay);
+			m_stats.srt_delay_avg = smooth(m_stats.srt_delay_avg, delay);
+			if (latency_us >= 0)
+				m_stats.app_delay_avg = smooth(m_stats.app_delay_avg, latency_us - delay);
+		}
+
+		if (info.msgno <= 0)
+			return;
+
+		// Message numbers run from 1 to MSGNO_MAX and wrap around.
+		if (m_expected_msgno > 0)
+		{
+			const int32_t gap = (info.msgno - m_expected_msgno + MSGNO_MAX) % MSGNO_MAX;
+			if (gap >= MSGNO_MAX / 2)
+				return; // A message older than the expected one.
+
+			if (gap > 0)
+			{
+				// A drop burst yields a line per gap: keep it at debug level, the total is in the periodic stats.
+				m_stats.msgs_dropped += gap;
+				spdlog::debug("[METRICS] Detected SRT drop of {} messages (msgno [{}; {}))", gap, m_expected_msgno, info.msgno);
+			}
+		}
+
+		m_expected_msgno = info.msgno % MSGNO_MAX + 1;
+	}
+
+	/// Reset values at the end of the measurement period.
+	/// Smoothed delays and drops are kept.
+	void reset()
+	{
+		m_stats.srt_delay_min = std::numeric_limits<long long>::max();
+		m_stats.srt_delay_max = std::numeric_limits<long long>::min();
+	}
+
+	stats get_stats() const { return m_stats; }
+
+private:
+	/// The same coefficient of 1/16 as for the latency.
+	static long long smooth(long long avg, long long val) { return avg != -1 ? (avg * 15 + val) / 16 : val; }
+
+	static const int32_t MSGNO_MAX = 0x03FFFFFF; // The message number field is 26 bits, 0 is not used.
+
+	stats   m_stats;
+	int32_t m_expected_msgno = 0; // 0 until the first message.
+};
+
+} // namespace metrics
+} // namespace xtransmit
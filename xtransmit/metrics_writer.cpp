@@ -89,6 +89,17 @@ future<void> metrics_writer::launch()
 		const bool         print_to_file = fout.is_open();
 		lock_guard<mutex> lock(stats_lock);
 
+		auto print = [&](SOCKET id, const validator::snapshot& s)
+		{
+			if (print_to_file)
+				fout << validator::to_csv(s) << flush;
+			else
+				spdlog::info("[METRICS] @{}: {}", id, validator::to_str(s));
+		};
+
+		// Shards of one stream are reported as a single stream.
+		map<sharded_loss*, vector<validator::snapshot>> sharded;
+
 		for (auto& it : validators)
 		{
 			if (!it.second)
@@ -105,10 +116,17 @@ future<void> metrics_writer::launch()
 				continue;
 			}
 
-			if (print_to_file)
-				fout << v->stats_csv() << flush;
+			if (v->shard_loss())
+				sharded[v->shard_loss().get()].push_back(v->take_snapshot());
 			else
-				spdlog::info("[METRICS] @{}: {}", it.first, v->stats());
+				print(it.first, v->take_snapshot());
+		}
+
+		for (auto& it : sharded)
+		{
+			it.first->advance();
+			const auto s = validator::merge(it.second, *it.first);
+			print(s.id, s);
 		}
 
 		auto delete_empty = [&validators]()
@@ -1,8 +1,15 @@
 #include <list>
 #include <thread>
+#include <unordered_map>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "misc.hpp"
+#include "metrics_histogram.hpp"
 #include "socket_stats.hpp"
 #include "srt_socket_group.hpp"
+#include "srt_worker.hpp"
 #include "xtr_defs.hpp"
 // submodules
 #include "spdlog/spdlog.h"
@@ -121,7 +128,27 @@ public:
 
 	void add_pipe(shared_sock_t conn, processing_fn_t const& run_pipe, const atomic_bool& break_token)
 	{
-		m_pipes.emplace(conn->id(), ::async(::launch::async, run_pipe, conn, [this](int conn_id) { on_pipe_exit(conn_id); }, ref(break_token)));
+		m_pipes.emplace(conn->id(), ::async(::launch::async, run_pipe, conn, m_stats, [this](int conn_id) { on_pipe_exit(conn_id); }, ref(break_token)));
+	}
+
+	/// Process the connection by a worker thread instead of a thread of its own.
+	void add_task(shared_sock_t conn, unique_ptr<pipe_task> task, srt_worker_pool& workers)
+	{
+		{
+			lock_guard<mutex> lck(m_mtx);
+			m_pipes.emplace(conn->id(), future<void>());
+		}
+
+		try
+		{
+			workers.add(conn, std::move(task), [this](int conn_id) { on_pipe_exit(conn_id); });
+		}
+		catch (const socket::exception&)
+		{
+			lock_guard<mutex> lck(m_mtx);
+			m_pipes.erase(conn->id());
+			throw;
+		}
 	}
 
 	void on_pipe_exit(int conn_id)
@@ -173,9 +200,305 @@ private:
 };
 
 
+namespace
+{
+void pin_thread_to_cpu(int cpu)
+{
+#if defined(__linux__)
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	const int res = pthread_setaffinity_np(pthread_self(), sizeof cpuset, &cpuset);
+	if (res != 0)
+		spdlog::warn(LOG_SC_CONN "Failed to pin the thread to CPU {}: error {}.", cpu, res);
+#else
+	spdlog::warn(LOG_SC_CONN "Pinning threads to CPUs is only supported on Linux.");
+#endif
+}
+
+/// Receive one UDP stream with several sockets sharing the local port (SO_REUSEPORT).
+/// Each socket (shard) is served by its own pipe thread, optionally pinned to a CPU
+/// (shard i to CPU "cpu" + i).
+void run_udp_shards(const UriParser& uri, int num_shards, socket::stats_writer* stats, concurrent_pipes& pipes,
+	const atomic_bool& break_token, const processing_fn_t& processing_fn)
+{
+	const auto& params    = uri.parameters();
+	const int   first_cpu = params.count("cpu") ? stoi(params.at("cpu")) : -1;
+
+	for (int i = 0; i < num_shards; ++i)
+	{
+		shared_sock_t conn = make_shared<socket::udp>(uri);
+		if (stats)
+			stats->add_socket(conn);
+
+		if (first_cpu < 0)
+		{
+			pipes.add_pipe(conn, processing_fn, break_token);
+			continue;
+		}
+
+		const int       cpu    = first_cpu + i;
+		processing_fn_t pinned = [cpu, &processing_fn](shared_sock_t sock, socket::stats_writer* st,
+			std::function<void(int conn_id)> const& on_done, const atomic_bool& brk) {
+			pin_thread_to_cpu(cpu);
+			processing_fn(sock, st, on_done, brk);
+		};
+		pipes.add_pipe(conn, pinned, break_token);
+	}
+
+	spdlog::info(LOG_SC_CONN "Receiving udp://{}:{} with {} shards{}.", uri.host(), uri.port(), num_shards,
+		first_cpu < 0 ? "" : fmt::format(" pinned to CPUs {}-{}", first_cpu, first_cpu + num_shards - 1));
+
+	while (pipes.size() > 0)
+		pipes.wait();
+}
+
+/// Establishes SRT caller connections in parallel: up to `limit` handshakes are in flight,
+/// all waited for with a single SRT epoll. The handshake latency (from srt_connect() to the connected state)
+/// is collected in a histogram.
+class srt_connector
+{
+public:
+	explicit srt_connector(size_t limit)
+		: m_limit(limit)
+		, m_events(limit)
+	{
+		m_eid = srt_epoll_create();
+		if (m_eid == SRT_ERROR)
+			throw socket::exception(fmt::format("Failed to create SRT epoll: {}", srt_getlasterror_str()));
+		srt_epoll_set(m_eid, SRT_EPOLL_ENABLE_EMPTY);
+	}
+
+	~srt_connector()
+	{
+		// Sockets still connecting are closed with m_pending.
+		srt_epoll_release(m_eid);
+	}
+
+	srt_connector(const srt_connector&) = delete;
+	srt_connector& operator=(const srt_connector&) = delete;
+
+public:
+	size_t in_flight() const { return m_pending.size(); }
+	size_t limit() const { return m_limit; }
+	int    connected() const { return m_connected; }
+	int    failed() const { return m_failed; }
+
+	/// Start a new connection.
+	/// @throws socket::exception if the URI is not a non-blocking SRT caller or the connection can't be started.
+	void start(const UriParser& uri)
+	{
+		auto sock = make_shared<socket::srt>(uri);
+		if (sock->mode() != socket::srt::CALLER || sock->is_blocking())
+			throw socket::exception("--parallel-connects requires a non-blocking SRT caller");
+
+		const SRTSOCKET id    = static_cast<SRTSOCKET>(sock->id());
+		const int       modes = SRT_EPOLL_OUT | SRT_EPOLL_ERR;
+		if (srt_epoll_add_usock(m_eid, id, &modes) == SRT_ERROR)
+			throw socket::exception(fmt::format("Failed to add @{} to the connect epoll: {}", id, srt_getlasterror_str()));
+
+		const auto tstart = steady_clock::now();
+		if (m_connected + m_failed == 0 && m_pending.empty())
+			m_first_start = tstart;
+		try
+		{
+			sock->start_connect();
+		}
+		catch (const socket::exception&)
+		{
+			srt_epoll_remove_usock(m_eid, id);
+			throw;
+		}
+		m_pending.emplace(id, pending{std::move(sock), tstart});
+	}
+
+	/// Wait for handshakes to complete and pass established connections to `on_connected`.
+	/// @returns the number of failed handshakes.
+	/// @throws socket::exception thrown by `on_connected`.
+	int wait(int timeout_ms, const function<void(shared_sock_t)>& on_connected)
+	{
+		const int n = srt_epoll_uwait(m_eid, m_events.data(), static_cast<int>(m_events.size()), timeout_ms);
+		const auto now = steady_clock::now();
+
+		int failed = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			const SRTSOCKET id = m_events[i].fd;
+			auto it = m_pending.find(id);
+			if (it == m_pending.end())
+				continue;
+
+			srt_epoll_remove_usock(m_eid, id);
+			shared_ptr<socket::srt> sock = std::move(it->second.sock);
+			const auto tstart = it->second.start;
+			m_pending.erase(it);
+
+			try
+			{
+				sock->finish_connect();
+			}
+			catch (const socket::exception& e)
+			{
+				spdlog::warn(LOG_SC_CONN "{}", e.what());
+				++m_failed;
+				++failed;
+				continue;
+			}
+
+			m_handshake.submit_sample(now - tstart);
+			++m_connected;
+			on_connected(sock);
+		}
+
+		return failed;
+	}
+
+	/// Log the number of connections, the connection rate and the handshake latency histogram.
+	void log_summary() const
+	{
+		const auto s  = m_handshake.get_snapshot();
+		const auto ms = duration_cast<milliseconds>(steady_clock::now() - m_first_start).count();
+
+		auto us_str = [](long long us) { return us < 0 ? string("n/a") : fmt::format("{} us", us); };
+		spdlog::info(LOG_SC_CONN "Handshakes: {} connected, {} failed in {} ms ({:.1f} conn/s). "
+			"Latency avg {}, P50 < {}, P99 < {}, max < {}.",
+			m_connected, m_failed, ms, ms > 0 ? m_connected * 1000.0 / ms : 0.0,
+			us_str(s.avg_us()), us_str(s.percentile_us(50)), us_str(s.percentile_us(99)), us_str(s.max_us()));
+
+		if (s.count == 0)
+			return;
+
+		string buckets;
+		for (size_t i = 0; i < metrics::long_histogram::num_buckets; ++i)
+		{
+			if (s.buckets[i] == 0)
+				continue;
+			const long long upper = metrics::long_histogram::bucket_upper_us(i);
+			buckets += fmt::format("{}{} us: {}", buckets.empty() ? "" : ", ",
+				upper < 0 ? fmt::format(">= {}", 1LL << (i - 1)) : fmt::format("< {}", upper), s.buckets[i]);
+		}
+		spdlog::info(LOG_SC_CONN "Handshake latency histogram: {}.", buckets);
+	}
+
+private:
+	struct pending
+	{
+		shared_ptr<socket::srt>  sock;
+		steady_clock::time_point start;
+	};
+
+	const size_t                           m_limit;
+	int                                    m_eid = -1;
+	unordered_map<SRTSOCKET, pending>      m_pending;
+	vector<SRT_EPOLL_EVENT>                m_events;
+	metrics::long_histogram                m_handshake;
+	int                                    m_connected = 0;
+	int                                    m_failed    = 0;
+	steady_clock::time_point               m_first_start = steady_clock::now();
+};
+
+/// Establish SRT caller connections with up to cfg.parallel_connects handshakes in flight.
+/// Follows the limits of the one by one establishment in common_run(): cfg.max_conns,
+/// cfg.concurrent_streams and cfg.reconnect.
+void run_parallel_connects(const UriParser& uri, const conn_config& cfg, concurrent_pipes& pipes,
+	const atomic_bool& break_token, const function<void(shared_sock_t)>& serve)
+{
+	srt_connector connector(cfg.parallel_connects);
+	spdlog::info(LOG_SC_CONN "Establishing connections to srt://{}:{} with up to {} handshakes in flight.",
+		uri.host(), uri.port(), connector.limit());
+
+	// The initial connections are started at full speed. Any connection started after them
+	// replaces an ended or failed one (the limits below guarantee it) and is paced.
+	int  initial_left   = cfg.max_conns > 0 ? min(cfg.max_conns, cfg.concurrent_streams) : cfg.concurrent_streams;
+	bool establish      = true;  // Keep starting new connections.
+	bool paced          = false; // A reconnection is postponed until next_reconnect.
+	auto next_reconnect = steady_clock::now();
+	auto next_progress  = steady_clock::now() + seconds(1);
+
+	while (!break_token)
+	{
+		paced = false;
+		while (establish && connector.in_flight() < connector.limit())
+		{
+			if (cfg.max_conns > 0 && connector.connected() + static_cast<int>(connector.in_flight()) >= cfg.max_conns)
+			{
+				establish = false;
+				break;
+			}
+
+			if (pipes.size() + connector.in_flight() >= static_cast<size_t>(cfg.concurrent_streams))
+			{
+				establish = cfg.reconnect;
+				break;
+			}
+
+			if (initial_left > 0)
+			{
+				--initial_left;
+			}
+			else
+			{
+				// Slow down reconnection pace to not faster than once per second, as common_run() does.
+				const auto now = steady_clock::now();
+				if (now < next_reconnect)
+				{
+					paced = true;
+					break;
+				}
+				next_reconnect = now + seconds(1);
+			}
+
+			try
+			{
+				connector.start(uri);
+			}
+			catch (const socket::exception& e)
+			{
+				spdlog::warn(LOG_SC_CONN "{}", e.what());
+				establish = false;
+			}
+		}
+
+		if (connector.in_flight() == 0)
+		{
+			if (!establish)
+				break;
+
+			// Wait for the reconnection pace or for a stream to end to reconnect.
+			if (paced)
+				this_thread::sleep_until(next_reconnect);
+			else
+				pipes.wait();
+			continue;
+		}
+
+		try
+		{
+			if (connector.wait(100, serve) > 0 && !cfg.reconnect)
+				establish = false;
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::warn(LOG_SC_CONN "{}", e.what());
+			establish = false;
+		}
+
+		const auto now = steady_clock::now();
+		if (now >= next_progress)
+		{
+			spdlog::info(LOG_SC_CONN "{} connected, {} in flight, {} failed.",
+				connector.connected(), connector.in_flight(), connector.failed());
+			next_progress = now + seconds(1);
+		}
+	}
+
+	connector.log_summary();
+}
+} // namespace
+
 // Use std::bind to pass the run_pipe function, and bind arguments to it.
 void common_run(const vector<string>& urls, const stats_config& cfg_stats, const conn_config& cfg_conn,
-	const atomic_bool& break_token, processing_fn_t& processing_fn)
+	const atomic_bool& break_token, processing_fn_t& processing_fn, const pipe_task_fn_t& task_fn)
 {
 	//XTR_THREADNAME(std::string("XTR:ConnMngmt"));
 	if (urls.empty())
@@ -210,9 +533,74 @@ void common_run(const vector<string>& urls, const stats_config& cfg_stats, const
 	shared_sock_t listening_sock; // A shared pointer to store a listening socket for multiple connections.
 	steady_clock::time_point next_reconnect = steady_clock::now();
 
+	// Worker threads must outlive the pipes.
+	unique_ptr<srt_worker_pool> workers;
+	if (cfg_conn.workers > 0 && task_fn)
+	{
+		try
+		{
+			workers = unique_ptr<srt_worker_pool>(new srt_worker_pool(cfg_conn.workers, break_token));
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::error(LOG_SC_CONN "{}", e.what());
+			return;
+		}
+	}
+
 	concurrent_pipes pipes(stats.get());
 	int conns_cnt = 0;
 
+	const bool sharded = parsed_urls.size() == 1 && parsed_urls[0].type() == UriParser::UDP
+		&& parsed_urls[0].parameters().count("shards") && stoi(parsed_urls[0].parameters().at("shards")) > 1;
+	if (sharded)
+	{
+		try
+		{
+			run_udp_shards(parsed_urls[0], stoi(parsed_urls[0].parameters().at("shards")), stats.get(), pipes, break_token, processing_fn);
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::error(LOG_SC_CONN "{}", e.what());
+			while (pipes.size() > 0)
+				pipes.wait();
+		}
+		return;
+	}
+
+	// Start processing an established connection.
+	auto serve = [&](shared_sock_t conn) {
+		if (stats)
+			stats->add_socket(conn);
+
+		// Non-blocking SRT connections can be served by the worker threads.
+		// TODO: Maybe just run from this thread if cfg_conn.concurrent_streams == 1.
+		const auto*           srt_sock = workers ? dynamic_cast<const socket::srt*>(conn.get()) : nullptr;
+		unique_ptr<pipe_task> task     = srt_sock && !srt_sock->is_blocking() ? task_fn(conn, stats.get()) : nullptr;
+		if (task)
+			pipes.add_task(conn, std::move(task), *workers);
+		else
+			pipes.add_pipe(conn, processing_fn, break_token);
+	};
+
+	const bool parallel = cfg_conn.parallel_connects > 1 && parsed_urls.size() == 1
+		&& parsed_urls[0].type() == UriParser::SRT && !parsed_urls[0].parameters().count("grouptype");
+	if (parallel)
+	{
+		try
+		{
+			run_parallel_connects(parsed_urls[0], cfg_conn, pipes, break_token, serve);
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::error(LOG_SC_CONN "{}", e.what());
+		}
+
+		while (pipes.size() > 0)
+			pipes.wait();
+		return;
+	}
+
 	do {
 		const auto tstart = steady_clock::now();
 		try
@@ -236,11 +624,7 @@ void common_run(const vector<string>& urls, const stats_config& cfg_stats, const
 			if (cfg_conn.close_listener)
 				listening_sock.reset();
 
-			if (stats)
-				stats->add_socket(conn);
-
-			// TODO: Maybe just run from this thread if cfg_conn.concurrent_streams == 1.
-			pipes.add_pipe(conn, processing_fn, break_token);
+			serve(conn);
 			++conns_cnt;
 
 		}
@@ -337,6 +721,10 @@ void apply_cli_opts(CLI::App& sc, conn_config& cfg)
 		->check(CLI::Validator(CLI::PositiveNumber));
 	sc.add_flag("--reconnect,!--no-reconnect", cfg.reconnect, "Reconnect automatically.");
 	sc.add_flag("--close-listener,!--no-close-listener", cfg.close_listener, "Close listener once connection is established.");
+	sc.add_option("--workers", cfg.workers, "Worker threads serving non-blocking SRT connections (default: 0 - a thread per connection).")
+		->check(CLI::Validator(CLI::NonNegativeNumber));
+	sc.add_option("--parallel-connects", cfg.parallel_connects, "SRT caller: the number of connections to establish in parallel (default: 1 - one by one).")
+		->check(CLI::Validator(CLI::PositiveNumber));
 }
 
 } // namespace xtransmit
@@ -70,6 +70,8 @@ struct conn_config
 	                               // SRT Listener: the number of allowed clients to accept.
 	int         concurrent_streams = 1;   // Maximum number of concurrent streams allowed.
 	bool        close_listener = false; // Close listener after all connection have been accepted.
+	int         workers        = 0;     // Worker threads serving non-blocking SRT connections (0 - a thread per connection).
+	int         parallel_connects = 1;  // SRT Caller: the number of handshakes in flight at a time (1 - one by one).
 };
 
 void apply_cli_opts(CLI::App& sc, conn_config& cfg);
@@ -96,7 +98,16 @@ inline shared_sock_t create_connection(const std::vector<UriParser>& uris)
 }
 
 
-typedef std::function<void(shared_sock_t, std::function<void (int conn_id)> const & on_done, const std::atomic_bool&)> processing_fn_t;
+namespace socket { class stats_writer; }
+class pipe_task;
+
+/// @brief Processing function of a connection (pipe).
+/// The stats_writer (nullptr if stats are disabled) can be used to report pipe-specific stats_extension.
+typedef std::function<void(shared_sock_t, socket::stats_writer*, std::function<void (int conn_id)> const & on_done, const std::atomic_bool&)> processing_fn_t;
+
+/// @brief Creates a task processing a connection on a worker thread (see srt_worker_pool),
+/// or returns nullptr to process the connection with processing_fn_t on a thread of its own.
+typedef std::function<std::unique_ptr<pipe_task>(shared_sock_t, socket::stats_writer*)> pipe_task_fn_t;
 
 /// @brief Creates stats writer if needed, establishes a connection, and runs `processing_fn`.
 /// @param urls a list of URLs to to establish a connection
@@ -104,11 +115,13 @@ typedef std::function<void(shared_sock_t, std::function<void (int conn_id)> cons
 /// @param cfg_conn
 /// @param force_break 
 /// @param processing_fn 
+/// @param task_fn  creates tasks for non-blocking SRT connections if cfg_conn.workers > 0 (optional)
 void common_run(const std::vector<std::string>& urls,
 				const stats_config&             cfg_stats,
 				const conn_config&              cfg_conn,
 				const std::atomic_bool&         force_break,
-				processing_fn_t&                processing_fn);
+				processing_fn_t&                processing_fn,
+				const pipe_task_fn_t&           task_fn = pipe_task_fn_t());
 
 /// @brief Create netaddr_any from host and port values.
 netaddr_any create_addr(const std::string& host, unsigned short port, int pref_family = AF_UNSPEC);
@@ -24,6 +24,10 @@ public:
 
 public:
 	virtual void wait(const atomic_bool& force_break) = 0;
+
+	/// The number of times wait() was called when the scheduled sending time had already passed,
+	/// i.e. the sender is falling behind the requested pace.
+	virtual uint64_t deadline_misses() const = 0;
 };
 
 // Definition of Pure Virtual Destructor
@@ -44,8 +48,7 @@ public:
 public:
 	inline void wait(const atomic_bool& force_break) final
 	{
-		const long inter_send_us = m_timedev_us > m_msg_interval_us ? 0 : (m_msg_interval_us - m_timedev_us);
-		const auto next_time     = m_last_snd_time + microseconds(inter_send_us);
+		const auto next_time = next_send_time();
 		std::chrono::steady_clock::time_point time_now;
 
 		if (!m_spin_wait)
@@ -53,19 +56,48 @@ public:
 			time_now = steady_clock::now();
 			if (time_now < next_time)
 				std::this_thread::sleep_until(next_time);
+			else
+				++m_deadline_misses;
 		}
 		else
 		{
-			for (;;)
+			for (bool first_check = true;; first_check = false)
 			{
 				time_now = steady_clock::now();
 				if (time_now >= next_time)
+				{
+					if (first_check)
+						++m_deadline_misses;
 					break;
+				}
 				if (force_break)
 					break;
 			}
 		}
 
+		on_sent(time_now);
+	}
+
+	uint64_t deadline_misses() const final { return m_deadline_misses; }
+
+	/// Non-blocking pacing: the time the next message is due to be sent.
+	inline std::chrono::steady_clock::time_point next_send_time() const
+	{
+		const long inter_send_us = m_timedev_us > m_msg_interval_us ? 0 : (m_msg_interval_us - m_timedev_us);
+		return m_last_snd_time + microseconds(inter_send_us);
+	}
+
+	/// Non-blocking pacing: the sender became ready for the next message at time_now.
+	/// Counts a deadline miss if the message was already due, as wait() does.
+	inline void on_ready(const std::chrono::steady_clock::time_point& time_now)
+	{
+		if (time_now >= next_send_time())
+			++m_deadline_misses;
+	}
+
+	/// Non-blocking pacing: a message due at next_send_time() was sent at time_now.
+	inline void on_sent(const std::chrono::steady_clock::time_point& time_now)
+	{
 		m_timedev_us += (long)duration_cast<microseconds>(time_now - m_last_snd_time).count() - m_msg_interval_us;
 		m_last_snd_time = time_now;
 	}
@@ -82,6 +114,7 @@ private:
 	const long                                    m_msg_interval_us;
 	time_point                                    m_last_snd_time = std::chrono::steady_clock::now();
 	long m_timedev_us = 0; ///< Pacing time deviation (microseconds) is used to adjust the pace
+	uint64_t m_deadline_misses = 0;
 };
 
 class csv_pacer : public ipacer
@@ -103,15 +136,21 @@ public:
 	inline void wait(const atomic_bool& force_break) final
 	{
 		const steady_clock::time_point next_time_ = next_time();
-		for (;;)
+		for (bool first_check = true;; first_check = false)
 		{
 			if (steady_clock::now() >= next_time_)
+			{
+				if (first_check)
+					++m_deadline_misses;
 				break;
+			}
 			if (force_break)
 				break;
 		}
 	}
 
+	uint64_t deadline_misses() const final { return m_deadline_misses; }
+
 private:
 	steady_clock::time_point next_time()
 	{
@@ -132,6 +171,7 @@ private:
 private:
 	std::ifstream            m_srccsv;
 	steady_clock::time_point m_start = steady_clock::now();
+	uint64_t                 m_deadline_misses = 0;
 };
 
 } // namespace xtransmit
@@ -17,6 +17,8 @@
 #include "receive.hpp"
 #include "metrics.hpp"
 #include "metrics_writer.hpp"
+#include "file_sink.hpp"
+#include "srt_worker.hpp"
 #include "xtr_defs.hpp"
 
 // OpenSRT
@@ -63,48 +65,166 @@ void trace_message(const size_t bytes, const vector<char>& buffer, SOCKET conn_i
 	//cout << "SRT HS: " << hs.show() << endl;
 }
 
-void run_pipe(shared_sock src, const config& cfg, unique_ptr<metrics::metrics_writer>& metrics, std::function<void(int conn_id)> const& on_done, const atomic_bool& force_break)
+namespace
 {
-	XTR_THREADNAME(std::string("XTR:Rcv"));
-	socket::isocket& sock = *src.get();
-	const auto conn_id = sock.id();
 
-	vector<char>       buffer(cfg.message_size);
-	metrics::metrics_writer::shared_validator validator;
+/// Processing of the messages received on a connection: printing, capturing to the sink,
+/// metrics validation and replies. Used by a pipe thread or a worker task.
+class receive_pipe
+{
+public:
+	/// @throws socket::exception if the sink can't be created.
+	receive_pipe(shared_sock src, const config& cfg, metrics::metrics_writer* metrics,
+		const std::shared_ptr<metrics::sharded_loss>& shard_loss, socket::stats_writer* stats)
+		: m_sock(std::move(src))
+		, m_cfg(cfg)
+		, m_metrics(metrics)
+		, m_buffer(cfg.message_size)
+		// SRT sockets and groups also give the message control to the validator.
+		, m_srt_sock(metrics ? dynamic_cast<socket::srt_msg_io*>(m_sock.get()) : nullptr)
+	{
+		const auto conn_id = m_sock->id();
+		if (!cfg.sink_url.empty())
+		{
+			const string prefix = "file://";
+			string path = cfg.sink_url.compare(0, prefix.size(), prefix) == 0 ? cfg.sink_url.substr(prefix.size()) : cfg.sink_url;
+			// Multiple connections (or reconnections) should not overwrite each other's capture.
+			if (cfg.max_conns != 1 || cfg.reconnect)
+				path += "." + std::to_string(conn_id);
+
+			m_sink = std::make_shared<sink::file_sink>(path, cfg.sink_block_size, cfg.sink_num_blocks);
+			if (stats)
+				stats->add_extension(conn_id, std::make_shared<sink::file_sink_stats>(m_sink));
+		}
+
+		if (m_metrics)
+		{
+			// Shards of a UDP stream share loss tracking: each of them receives only a part of the packets.
+			const auto* udp_sock = dynamic_cast<const socket::udp*>(m_sock.get());
+			m_validator = std::make_shared<metrics::validator>(conn_id, udp_sock && udp_sock->shards() > 1 ? shard_loss : nullptr);
+			m_metrics->add_validator(m_validator, conn_id);
 
-	if (metrics)
+			const auto* tcp_sock = dynamic_cast<const socket::tcp*>(m_sock.get());
+			if (tcp_sock && !tcp_sock->is_framed())
+				spdlog::warn(LOG_SC_RECEIVE "TCP does not preserve message boundaries: metrics will be wrong. Use tcp://...?framed=1 on both sides.");
+		}
+	}
+
+	~receive_pipe()
 	{
-		validator = std::make_shared<metrics::validator>(conn_id);
-		metrics->add_validator(validator, conn_id);
+		if (m_metrics)
+			m_metrics->remove_validator(m_sock->id());
+
+		if (m_sink)
+			m_sink->close();
 	}
 
-	try
+	/// Read and process a message.
+	/// @returns false if no message was read.
+	/// @throws socket::exception on failure.
+	bool read_message(int timeout_ms)
 	{
-		while (!force_break)
-		{
-			const size_t bytes = sock.read(mutable_buffer(buffer.data(), buffer.size()), -1);
+		socket::isocket& sock  = *m_sock;
+		SRT_MSGCTRL      mctrl = srt_msgctrl_default;
+		const size_t     bytes = m_srt_sock ? m_srt_sock->read_msg(mutable_buffer(m_buffer.data(), m_buffer.size()), mctrl, timeout_ms)
+										    : sock.read(mutable_buffer(m_buffer.data(), m_buffer.size()), timeout_ms);
+		if (bytes == 0)
+			return false;
 
-			if (bytes == 0)
+		if (m_cfg.print_notifications)
+			trace_message(bytes, m_buffer, sock.id());
+		if (m_sink)
+			m_sink->write(const_buffer(m_buffer.data(), bytes));
+		if (m_metrics)
+		{
+			metrics::srt_msg_info srt_info;
+			if (m_srt_sock)
 			{
-				spdlog::debug(LOG_SC_RECEIVE "sock::read() returned 0 bytes (spurious read ready?). Retrying.");
-				continue;
+				srt_info.srctime_us = mctrl.srctime;
+				srt_info.rcvtime_us = srt_time_now();
+				srt_info.pktseq     = mctrl.pktseq;
+				srt_info.msgno      = mctrl.msgno;
 			}
+			m_validator->validate_packet(const_buffer(m_buffer.data(), bytes), m_srt_sock ? &srt_info : nullptr);
+		}
 
-			if (cfg.print_notifications)
-				trace_message(bytes, buffer, sock.id());
-			if (metrics)
-			{
-				validator->validate_packet(const_buffer(buffer.data(), bytes));
-			}
+		if (m_cfg.send_reply)
+		{
+			const string out_message("Message received");
+			sock.write(const_buffer(out_message.data(), out_message.size()), timeout_ms);
 
-			if (cfg.send_reply)
-			{
-				const string out_message("Message received");
-				sock.write(const_buffer(out_message.data(), out_message.size()));
+			if (m_cfg.print_notifications)
+				spdlog::error(LOG_SC_RECEIVE "{} Reply sent on conn ID {}", sock.id(), sock.id());
+		}
 
-				if (cfg.print_notifications)
-					spdlog::error(LOG_SC_RECEIVE "{} Reply sent on conn ID {}", conn_id, sock.id());
-			}
+		return true;
+	}
+
+private:
+	const shared_sock                         m_sock;
+	const config&                             m_cfg;
+	metrics::metrics_writer* const            m_metrics;
+	vector<char>                              m_buffer;
+	socket::srt_msg_io* const                 m_srt_sock;
+	metrics::metrics_writer::shared_validator m_validator;
+	std::shared_ptr<sink::file_sink>          m_sink;
+};
+
+/// Receiving of an SRT connection served by a worker thread (see srt_worker_pool).
+class receive_task : public pipe_task
+{
+public:
+	explicit receive_task(unique_ptr<receive_pipe> pipe)
+		: m_pipe(std::move(pipe))
+	{
+	}
+
+public:
+	bool process(int events) final
+	{
+		// Read the messages available, a limited number at a time not to hold up the other connections of the worker.
+		for (int n = 0; events != 0 && n < 64; ++n)
+		{
+			if (!m_pipe->read_message(0))
+				break;
+		}
+		return true;
+	}
+
+	int interest() const final { return SRT_EPOLL_IN; }
+
+	steady_clock::time_point due() const final { return steady_clock::time_point::max(); }
+
+private:
+	unique_ptr<receive_pipe> m_pipe;
+};
+
+} // namespace
+
+void run_pipe(shared_sock src, const config& cfg, unique_ptr<metrics::metrics_writer>& metrics,
+	const std::shared_ptr<metrics::sharded_loss>& shard_loss, socket::stats_writer* stats, std::function<void(int conn_id)> const& on_done, const atomic_bool& force_break)
+{
+	XTR_THREADNAME(std::string("XTR:Rcv"));
+	const auto conn_id = src->id();
+
+	unique_ptr<receive_pipe> pipe;
+	try
+	{
+		pipe = unique_ptr<receive_pipe>(new receive_pipe(src, cfg, metrics.get(), shard_loss, stats));
+	}
+	catch (const socket::exception& e)
+	{
+		spdlog::error(LOG_SC_RECEIVE "{}", e.what());
+		on_done(conn_id);
+		return;
+	}
+
+	try
+	{
+		while (!force_break)
+		{
+			if (!pipe->read_message(-1))
+				spdlog::debug(LOG_SC_RECEIVE "sock::read() returned 0 bytes (spurious read ready?). Retrying.");
 		}
 	}
 	catch (const socket::exception& e)
@@ -112,8 +232,7 @@ void run_pipe(shared_sock src, const config& cfg, unique_ptr<metrics::metrics_wr
 		spdlog::warn(LOG_SC_RECEIVE "{}", e.what());
 	}
 
-	if (metrics)
-		metrics->remove_validator(conn_id);
+	pipe.reset();
 
 	if (force_break)
 	{
@@ -145,8 +264,24 @@ void xtransmit::receive::run(const std::vector<std::string>& src_urls,
 		}
 	}
 
-	processing_fn_t process_fn = std::bind(run_pipe, _1, cfg, std::ref(metrics), _2, _3);
-	common_run(src_urls, cfg, cfg, force_break, process_fn);
+	std::shared_ptr<metrics::sharded_loss> shard_loss;
+	if (metrics && src_urls.size() == 1 && UriParser(src_urls[0]).parameters().count("shards"))
+		shard_loss = std::make_shared<metrics::sharded_loss>();
+
+	processing_fn_t process_fn = std::bind(run_pipe, _1, cfg, std::ref(metrics), shard_loss, _2, _3, _4);
+	const pipe_task_fn_t task_fn = [&](shared_sock sock, socket::stats_writer* stats) -> unique_ptr<pipe_task> {
+		try
+		{
+			unique_ptr<receive_pipe> pipe(new receive_pipe(sock, cfg, metrics.get(), shard_loss, stats));
+			return unique_ptr<pipe_task>(new receive_task(std::move(pipe)));
+		}
+		catch (const socket::exception&)
+		{
+			// Let a pipe thread report the failure.
+			return nullptr;
+		}
+	};
+	common_run(src_urls, cfg, cfg, force_break, process_fn, task_fn);
 }
 
 CLI::App* xtransmit::receive::add_subcommand(CLI::App& app, config& cfg, std::vector<std::string>& src_urls)
@@ -166,6 +301,10 @@ CLI::App* xtransmit::receive::add_subcommand(CLI::App& app, config& cfg, std::ve
 	sc_receive->add_option("--metricsfreq", cfg.metrics_freq_ms, fmt::format("Metrics report frequency, ms (default {})", cfg.metrics_freq_ms))
 		->transform(CLI::AsNumberWithUnit(to_ms, CLI::AsNumberWithUnit::CASE_SENSITIVE));
 	sc_receive->add_flag("--twoway", cfg.send_reply, "Both send and receive data");
+	sc_receive->add_option("--sink", cfg.sink_url, "Capture received messages to a file (file://path). Message boundaries are written to path.idx");
+	sc_receive->add_option("--sink-blocksize", cfg.sink_block_size, fmt::format("Size of a capture buffer block, bytes (default {})", cfg.sink_block_size));
+	sc_receive->add_option("--sink-blocks", cfg.sink_num_blocks, fmt::format("Number of capture buffer blocks (default {})", cfg.sink_num_blocks))
+		->check(CLI::Range(2, 64));
 
 	apply_cli_opts(*sc_receive, cfg);
 
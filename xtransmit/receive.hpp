@@ -22,6 +22,9 @@ struct config : stats_config, conn_config
 	std::string metrics_file;
 	int         max_connections = 1; // Maximum number of connections on a socket
 	int         message_size    = 1316;
+	std::string sink_url;                             // Capture received data: file://path
+	size_t      sink_block_size = 4 * 1024 * 1024;    // Size of a capture buffer block
+	int         sink_num_blocks = 3;                  // Number of capture buffer blocks
 };
 
 void run(const std::vector<std::string>& src_urls, const config& cfg, const std::atomic_bool& force_break);
@@ -1,27 +1,47 @@
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <ctime>
 #include <future>
 #include <iomanip>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 // submodules
 #include "spdlog/spdlog.h"
 
 // xtransmit
 #include "srt_socket.hpp"
 #include "udp_socket.hpp"
+#include "tcp_socket.hpp"
 #include "misc.hpp"
 #include "route.hpp"
+#include "route_engine.hpp"
 #include "socket_stats.hpp"
+#include "spsc_ring.hpp"
+#include "buffer_pool.hpp"
+#include "dedup_window.hpp"
+#include "impairment.hpp"
+#include "metrics.hpp"
+#include "metrics_histogram.hpp"
 
 // OpenSRT
 #include "apputil.hpp"
 #include "uriparser.hpp"
 #include "xtr_defs.hpp"
 
+// nlohmann_json
+#include <nlohmann/json.hpp>
+
 using namespace std;
 using namespace xtransmit;
 using namespace xtransmit::route;
@@ -37,20 +57,534 @@ namespace xtransmit
 namespace route
 {
 
-	void route(shared_sock src, shared_sock dst,
-		const config& cfg, const string&& desc, const atomic_bool& force_break)
+	/// A message buffered between the reading and the writing threads.
+	struct ring_slot
 	{
-		XTR_THREADNAME(std::string("XTR:Route"));
-		vector<char> buffer(cfg.message_size);
+		vector<char>             data;
+		size_t                   len = 0;
+		steady_clock::time_point read_end; // Set if the hop latency is measured.
+	};
+
+	using route_ring = spsc_ring<ring_slot>;
+
+	/// Ring statistics of a decoupled route direction. Updated by the reading thread.
+	struct ring_stats
+	{
+		atomic<uint64_t> pushed{0};
+		atomic<uint64_t> dropped{0};
+		atomic<size_t>   max_occupancy{0}; // Since the last report.
+
+		static void inc(atomic<uint64_t>& counter)
+		{
+			counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+		}
+
+		void update_occupancy(size_t occupancy)
+		{
+			if (occupancy > max_occupancy.load(memory_order_relaxed))
+				max_occupancy.store(occupancy, memory_order_relaxed);
+		}
+	};
+
+	/// Reports ring statistics to the stats file along with the statistics of the socket it is registered for.
+	template <class Ring>
+	class ring_stats_report : public socket::stats_extension
+	{
+	public:
+		ring_stats_report(shared_ptr<const Ring> ring, shared_ptr<ring_stats> rs)
+			: m_ring(std::move(ring))
+			, m_rs(std::move(rs))
+		{
+		}
+
+	public:
+		const string stats_to_csv(bool print_header) final
+		{
+			if (print_header)
+				return "pktRingPushed,pktRingDropped,pktRingOccupancy,pktRingOccupancyMax,pktRingDepth";
+
+			const auto s = next_interval();
+			stringstream ss;
+			ss << s.pushed << ',' << s.dropped << ',' << s.occupancy << ',' << s.max_occupancy << ',' << m_ring->capacity();
+			return ss.str();
+		}
+
+		const nlohmann::json stats_to_json() final
+		{
+			const auto s = next_interval();
+			nlohmann::json root;
+			root["pktPushed"]       = s.pushed;
+			root["pktDropped"]      = s.dropped;
+			root["pktOccupancy"]    = s.occupancy;
+			root["pktOccupancyMax"] = s.max_occupancy;
+			root["pktDepth"]        = m_ring->capacity();
+			return root;
+		}
+
+		const char* json_key() const final { return "RingStats"; }
+
+	private:
+		struct interval
+		{
+			uint64_t pushed;
+			uint64_t dropped;
+			size_t   occupancy;
+			size_t   max_occupancy;
+		};
+
+		interval next_interval()
+		{
+			const uint64_t pushed  = m_rs->pushed.load(memory_order_relaxed);
+			const uint64_t dropped = m_rs->dropped.load(memory_order_relaxed);
+			const interval s = {pushed - m_prev_pushed, dropped - m_prev_dropped, m_ring->size(),
+				m_rs->max_occupancy.exchange(0, memory_order_relaxed)};
+			m_prev_pushed  = pushed;
+			m_prev_dropped = dropped;
+			return s;
+		}
+
+	private:
+		shared_ptr<const Ring> m_ring;
+		shared_ptr<ring_stats> m_rs;
+		uint64_t               m_prev_pushed  = 0;
+		uint64_t               m_prev_dropped = 0;
+	};
 
+	/// Forwarding latency of a route direction. Updated by the writing thread.
+	/// Only two clock readings per message are needed: when the reading and when the writing ends.
+	struct hop_latency
+	{
+		metrics::histogram       dwell; // From the end of reading to the end of writing a message.
+		metrics::histogram       write; // Writing a message.
+		steady_clock::time_point prev_write_end;
+
+		void submit(const steady_clock::time_point& read_end, const steady_clock::time_point& write_end)
+		{
+			dwell.submit_sample(write_end - read_end);
+			// The writing starts when the message is read or when the previous message is written, whichever is later.
+			write.submit_sample(write_end - max(read_end, prev_write_end));
+			prev_write_end = write_end;
+		}
+
+		void log_summary(const string& desc) const
+		{
+			const auto d = dwell.get_snapshot();
+			const auto w = write.get_snapshot();
+			spdlog::info(LOG_SC_ROUTE "{} Hop latency, us: dwell avg {} p99 {}, write avg {} p99 {}.", desc,
+				d.avg_us(), d.percentile_us(99), w.avg_us(), w.percentile_us(99));
+		}
+	};
+
+	/// Reports per-interval hop latency histograms to the stats file along with the source socket statistics.
+	class hop_latency_report : public socket::stats_extension
+	{
+	public:
+		explicit hop_latency_report(shared_ptr<const hop_latency> hop)
+			: m_hop(std::move(hop))
+		{
+		}
+
+	public:
+		const string stats_to_csv(bool print_header) final
+		{
+			if (print_header)
+				return metrics::histogram::snapshot::csv_header("HopDwell") + ',' + metrics::histogram::snapshot::csv_header("HopWrite");
+
+			next_interval();
+			return m_dwell.to_csv() + ',' + m_write.to_csv();
+		}
+
+		const nlohmann::json stats_to_json() final
+		{
+			next_interval();
+			nlohmann::json root;
+			root["Dwell"] = m_dwell.to_json();
+			root["Write"] = m_write.to_json();
+			return root;
+		}
+
+		const char* json_key() const final { return "HopLatency"; }
+
+	private:
+		void next_interval()
+		{
+			const auto dwell = m_hop->dwell.get_snapshot();
+			const auto write = m_hop->write.get_snapshot();
+			m_dwell          = dwell - m_prev_dwell;
+			m_write          = write - m_prev_write;
+			m_prev_dwell     = dwell;
+			m_prev_write     = write;
+		}
+
+	private:
+		shared_ptr<const hop_latency>  m_hop;
+		metrics::histogram::snapshot   m_prev_dwell, m_prev_write;
+		metrics::histogram::snapshot   m_dwell, m_write;
+	};
+
+	/// Measure the hop latency if the statistics are collected.
+	shared_ptr<hop_latency> create_hop_latency(socket::stats_writer* stats, SOCKET src_id)
+	{
+		if (!stats)
+			return nullptr;
+
+		auto hop = make_shared<hop_latency>();
+		stats->add_extension(src_id, make_shared<hop_latency_report>(hop));
+		return hop;
+	}
+
+	/// Route with reading and writing done by separate threads, connected by a ring of messages.
+	/// A destination stall does not stop reading from the source until the ring is full.
+	void route_decoupled(shared_sock src, shared_sock dst, const config& cfg, const string& desc,
+		socket::stats_writer* stats, const atomic_bool& force_break)
+	{
 		socket::isocket& sock_src = *src.get();
 		socket::isocket& sock_dst = *dst.get();
 
-		spdlog::info(LOG_SC_ROUTE "{0} Started", desc);
+		auto ring = make_shared<route_ring>(cfg.ring_depth, ring_slot{vector<char>(cfg.message_size), 0});
+		auto rs   = make_shared<ring_stats>();
+		if (stats)
+			stats->add_extension(sock_src.id(), make_shared<ring_stats_report<route_ring>>(ring, rs));
+		auto hop = create_hop_latency(stats, sock_src.id());
 
-		while (!force_break)
+		const bool  block_when_full = cfg.ring_full == "block";
+		atomic_bool reader_done(false);
+		atomic_bool writer_failed(false);
+
+		spdlog::info(LOG_SC_ROUTE "{0} Started (ring depth {1}, {2} when full)", desc, ring->capacity(),
+			block_when_full ? "block" : "drop");
+
+		auto writer = ::async(::launch::async, [&]() {
+			XTR_THREADNAME(std::string("XTR:RouteWr"));
+			try
+			{
+				while (!force_break)
+				{
+					ring_slot* s = ring->front();
+					if (!s)
+					{
+						if (reader_done && !ring->front())
+							break;
+						ring->wait([&]() { return ring->front() != nullptr || reader_done || force_break; },
+							milliseconds(100));
+						continue;
+					}
+
+					// SRT can return 0 on SRT_EASYNCSND. Rare for sending. However might be worth to retry.
+					const int bytes_sent = sock_dst.write(const_buffer(s->data.data(), s->len));
+					if (hop)
+						hop->submit(s->read_end, steady_clock::now());
+					if (bytes_sent != static_cast<int>(s->len))
+						spdlog::info("{} write returned {} bytes, expected {}", desc, bytes_sent, s->len);
+
+					ring->pop();
+				}
+			}
+			catch (const socket::exception&)
+			{
+				writer_failed = true;
+				ring->notify();
+				throw;
+			}
+		});
+
+		vector<char> scratch(cfg.message_size); // Used to drain the source when the ring is full.
+		try
 		{
-			const size_t bytes_read = sock_src.read(mutable_buffer(buffer.data(), buffer.size()), -1);
+			while (!force_break && !writer_failed)
+			{
+				ring_slot* s = ring->free_slot();
+				if (!s && block_when_full)
+				{
+					ring->wait([&]() { return ring->free_slot() != nullptr || force_break || writer_failed; },
+						milliseconds(100));
+					continue;
+				}
+
+				char* const  buf        = s ? s->data.data() : scratch.data();
+				const size_t bytes_read = sock_src.read(mutable_buffer(buf, cfg.message_size), -1);
+				const auto   read_end   = hop ? steady_clock::now() : steady_clock::time_point();
+
+				if (bytes_read == 0)
+				{
+					spdlog::info(LOG_SC_ROUTE "{} read 0 bytes on a socket (spurious read-ready?). Retrying.", desc);
+					continue;
+				}
+
+				if (!s)
+				{
+					// The writer may have released a slot while reading.
+					s = ring->free_slot();
+					if (!s)
+					{
+						ring_stats::inc(rs->dropped);
+						continue;
+					}
+					memcpy(s->data.data(), scratch.data(), bytes_read);
+				}
+
+				s->len      = bytes_read;
+				s->read_end = read_end;
+				ring->push();
+				ring_stats::inc(rs->pushed);
+				rs->update_occupancy(ring->size());
+			}
+		}
+		catch (const socket::exception&)
+		{
+			reader_done = true;
+			ring->notify();
+			writer.wait();
+			spdlog::info(LOG_SC_ROUTE "{0} Ring: {1} messages passed, {2} dropped.", desc, rs->pushed.load(), rs->dropped.load());
+			if (hop)
+				hop->log_summary(desc);
+			throw;
+		}
+
+		reader_done = true;
+		ring->notify();
+		spdlog::info(LOG_SC_ROUTE "{0} Ring: {1} messages passed, {2} dropped.", desc, rs->pushed.load(), rs->dropped.load());
+		if (hop)
+			hop->log_summary(desc);
+		writer.get(); // Rethrows the writer's exception if any.
+	}
+
+	using shared_buffer = shared_buffer_pool::buffer*;
+	using fanout_ring   = spsc_ring<shared_buffer>;
+
+	/// A destination of a fan-out route with its own writing thread and queue.
+	struct fanout_dst
+	{
+		fanout_dst(shared_sock s, size_t depth, const string& d)
+			: sock(std::move(s))
+			, queue(make_shared<fanout_ring>(depth, nullptr))
+			, stats(make_shared<ring_stats>())
+			, desc(d)
+		{
+		}
+
+		shared_sock                 sock;
+		shared_ptr<fanout_ring>     queue;
+		shared_ptr<ring_stats>      stats;
+		string                      desc;
+		unique_ptr<atomic_bool>     failed{new atomic_bool(false)};
+		future<void>                writer;
+	};
+
+	void fanout_write(fanout_dst& dst, const atomic_bool& reader_done, const atomic_bool& force_break)
+	{
+		XTR_THREADNAME(std::string("XTR:RouteWr"));
+		fanout_ring& queue = *dst.queue;
+		try
+		{
+			while (!force_break)
+			{
+				shared_buffer* slot = queue.front();
+				if (!slot)
+				{
+					if (reader_done && !queue.front())
+						break;
+					queue.wait([&]() { return queue.front() != nullptr || reader_done || force_break; },
+						milliseconds(100));
+					continue;
+				}
+
+				shared_buffer b = *slot;
+				const int bytes_sent = dst.sock->write(const_buffer(b->data.data(), b->len));
+				if (bytes_sent != static_cast<int>(b->len))
+					spdlog::info("{} write returned {} bytes, expected {}", dst.desc, bytes_sent, b->len);
+
+				b->release();
+				queue.pop();
+			}
+		}
+		catch (const socket::exception& e)
+		{
+			// Buffers still referenced by the queue are never released. The pool is sized to allow that.
+			spdlog::error(LOG_SC_ROUTE "{} {}", dst.desc, e.what());
+			*dst.failed = true;
+		}
+	}
+
+	/// Route from one source to several destinations.
+	/// A received message is stored once in a shared buffer and queued to every destination.
+	/// Each destination is written by its own thread. If the queue of a destination is full,
+	/// the message is dropped for this destination only, so a slow destination does not stall the others.
+	void route_fanout(shared_sock src, const vector<shared_sock>& dsts, const config& cfg,
+		socket::stats_writer* stats, const atomic_bool& force_break)
+	{
+		XTR_THREADNAME(std::string("XTR:Route"));
+		const size_t depth = cfg.ring_depth > 0 ? cfg.ring_depth : 256;
+
+		// A buffer is held by at most one queue slot of each destination, plus one is being filled.
+		shared_buffer_pool pool(dsts.size() * depth + 1, cfg.message_size);
+
+		atomic_bool reader_done(false);
+		vector<fanout_dst> out;
+		out.reserve(dsts.size());
+		for (size_t i = 0; i < dsts.size(); ++i)
+		{
+			out.emplace_back(dsts[i], depth, "[SRC->DST" + to_string(i + 1) + "]");
+			if (stats)
+				stats->add_extension(dsts[i]->id(), make_shared<ring_stats_report<fanout_ring>>(out[i].queue, out[i].stats));
+		}
+
+		for (auto& d : out)
+			d.writer = ::async(::launch::async, fanout_write, ref(d), cref(reader_done), cref(force_break));
+
+		spdlog::info(LOG_SC_ROUTE "[SRC->DST] Started fan-out to {} destinations (queue depth {}, {} shared buffers)",
+			out.size(), depth, pool.size());
+
+		auto stop_writers = [&]() {
+			reader_done = true;
+			for (auto& d : out)
+			{
+				d.queue->notify();
+				d.writer.wait();
+				spdlog::info(LOG_SC_ROUTE "{} {} messages queued, {} dropped.", d.desc,
+					d.stats->pushed.load(), d.stats->dropped.load());
+			}
+		};
+
+		socket::isocket& sock_src = *src.get();
+		vector<char> scratch(cfg.message_size); // Used to drain the source if no buffer is free.
+		vector<shared_buffer*> slots(out.size());
+		try
+		{
+			while (!force_break)
+			{
+				if (all_of(out.begin(), out.end(), [](const fanout_dst& d) { return d.failed->load(); }))
+				{
+					spdlog::error(LOG_SC_ROUTE "[SRC->DST] All destinations failed.");
+					break;
+				}
+
+				shared_buffer b = pool.acquire();
+				char* const buf = b ? b->data.data() : scratch.data();
+				const size_t bytes_read = sock_src.read(mutable_buffer(buf, cfg.message_size), -1);
+
+				if (bytes_read == 0)
+				{
+					spdlog::info(LOG_SC_ROUTE "[SRC->DST] read 0 bytes on a socket (spurious read-ready?). Retrying.");
+					continue;
+				}
+
+				// Reserve a queue slot of every destination first: the buffer must be shared before it is published.
+				int num_consumers = 0;
+				for (size_t i = 0; i < out.size(); ++i)
+				{
+					slots[i] = (b && !*out[i].failed) ? out[i].queue->free_slot() : nullptr;
+					if (slots[i])
+						++num_consumers;
+					else if (!*out[i].failed)
+						ring_stats::inc(out[i].stats->dropped);
+				}
+
+				if (!b)
+					continue;
+
+				b->len = bytes_read;
+				shared_buffer_pool::share(b, num_consumers);
+				for (size_t i = 0; i < out.size(); ++i)
+				{
+					if (!slots[i])
+						continue;
+					*slots[i] = b;
+					out[i].queue->push();
+					ring_stats::inc(out[i].stats->pushed);
+					out[i].stats->update_occupancy(out[i].queue->size());
+				}
+			}
+		}
+		catch (const socket::exception&)
+		{
+			stop_writers();
+			throw;
+		}
+
+		stop_writers();
+	}
+
+	/// Per-source statistics of a merge route. Updated by the reading thread of the source.
+	struct merge_stats
+	{
+		atomic<uint64_t> won{0};       // Messages forwarded from this source (the first copy).
+		atomic<uint64_t> duplicate{0}; // Messages already forwarded from another source.
+		atomic<uint64_t> late{0};      // Messages older than the dedup window.
+		atomic<uint64_t> short_msg{0}; // Messages too short to carry a sequence number (seqno dedup only).
+	};
+
+	/// Reports merge statistics to the stats file along with the source socket statistics.
+	class merge_stats_report : public socket::stats_extension
+	{
+	public:
+		explicit merge_stats_report(shared_ptr<const merge_stats> ms)
+			: m_ms(std::move(ms))
+		{
+		}
+
+	public:
+		const string stats_to_csv(bool print_header) final
+		{
+			if (print_header)
+				return "pktMergeWon,pktMergeDuplicate,pktMergeLate,pktMergeShort";
+
+			const auto s = next_interval();
+			stringstream ss;
+			ss << s[0] << ',' << s[1] << ',' << s[2] << ',' << s[3];
+			return ss.str();
+		}
+
+		const nlohmann::json stats_to_json() final
+		{
+			const auto s = next_interval();
+			nlohmann::json root;
+			root["pktWon"]       = s[0];
+			root["pktDuplicate"] = s[1];
+			root["pktLate"]      = s[2];
+			root["pktShort"]     = s[3];
+			return root;
+		}
+
+		const char* json_key() const final { return "MergeStats"; }
+
+	private:
+		array<uint64_t, 4> next_interval()
+		{
+			const array<uint64_t, 4> curr = {m_ms->won.load(memory_order_relaxed),
+				m_ms->duplicate.load(memory_order_relaxed), m_ms->late.load(memory_order_relaxed),
+				m_ms->short_msg.load(memory_order_relaxed)};
+			const array<uint64_t, 4> s = {
+				curr[0] - m_prev[0], curr[1] - m_prev[1], curr[2] - m_prev[2], curr[3] - m_prev[3]};
+			m_prev = curr;
+			return s;
+		}
+
+	private:
+		shared_ptr<const merge_stats> m_ms;
+		array<uint64_t, 4>            m_prev = {};
+	};
+
+	void merge_read(socket::isocket& src, socket::isocket& dst, mutex& dst_mtx, dedup_window& window, merge_stats& ms,
+		const config& cfg, const string& desc, atomic_bool& dst_failed, const atomic_bool& force_break)
+	{
+		XTR_THREADNAME(std::string("XTR:RouteRd"));
+		const bool   by_seqno = cfg.dedup_key == "seqno";
+		vector<char> buffer(cfg.message_size);
+
+		while (!force_break && !dst_failed)
+		{
+			size_t bytes_read = 0;
+			try
+			{
+				bytes_read = src.read(mutable_buffer(buffer.data(), buffer.size()), -1);
+			}
+			catch (const socket::exception& e)
+			{
+				// A failed source does not affect the others.
+				spdlog::error(LOG_SC_ROUTE "{} {}", desc, e.what());
+				return;
+			}
 
 			if (bytes_read == 0)
 			{
@@ -58,16 +592,390 @@ namespace route
 				continue;
 			}
 
-			// SRT can return 0 on SRT_EASYNCSND. Rare for sending. However might be worth to retry.
-			const int bytes_sent = sock_dst.write(const_buffer(buffer.data(), bytes_read));
+			// The sequence number is the first field of the metrics header. A shorter message has none,
+			// and a content hash in the same window could collide with a sequence number, so it is dropped.
+			if (by_seqno && bytes_read < sizeof(uint64_t))
+			{
+				ring_stats::inc(ms.short_msg);
+				continue;
+			}
 
-			if (bytes_sent != bytes_read)
+			const uint64_t key = by_seqno ? metrics::read_packet_seqno(const_buffer(buffer.data(), bytes_read))
+				: dedup_window::content_hash(buffer.data(), bytes_read);
+
+			const auto res = window.submit(key);
+			if (res != dedup_window::FIRST)
 			{
-				spdlog::info("{} write returned {} bytes, expected {}", desc, bytes_sent, bytes_read);
+				ring_stats::inc(res == dedup_window::DUPLICATE ? ms.duplicate : ms.late);
 				continue;
 			}
+
+			ring_stats::inc(ms.won);
+			try
+			{
+				lock_guard<mutex> lck(dst_mtx);
+				const int bytes_sent = dst.write(const_buffer(buffer.data(), bytes_read));
+				if (bytes_sent != static_cast<int>(bytes_read))
+					spdlog::info("{} write returned {} bytes, expected {}", desc, bytes_sent, bytes_read);
+			}
+			catch (const socket::exception& e)
+			{
+				// Failure to write stops all the sources.
+				spdlog::error(LOG_SC_ROUTE "{} {}", desc, e.what());
+				dst_failed = true;
+			}
 		}
 	}
+
+	/// Route from several sources carrying the same stream to one destination.
+	/// Each source is read by its own thread, and only the first copy of a message is forwarded.
+	void route_merge(const vector<shared_sock>& srcs, shared_sock dst, const config& cfg,
+		socket::stats_writer* stats, const atomic_bool& force_break)
+	{
+		XTR_THREADNAME(std::string("XTR:Route"));
+		dedup_window window(cfg.dedup_window, cfg.dedup_key == "seqno");
+		mutex        dst_mtx;
+		atomic_bool  dst_failed(false);
+
+		vector<shared_ptr<merge_stats>> ms;
+		vector<string>                  descs;
+		for (size_t i = 0; i < srcs.size(); ++i)
+		{
+			ms.push_back(make_shared<merge_stats>());
+			descs.push_back("[SRC" + to_string(i + 1) + "->DST]");
+			if (stats)
+				stats->add_extension(srcs[i]->id(), make_shared<merge_stats_report>(ms[i]));
+		}
+
+		spdlog::info(LOG_SC_ROUTE "[SRC->DST] Started merging {} sources (dedup by {}, window {})", srcs.size(),
+			cfg.dedup_key, window.size());
+
+		vector<future<void>> readers;
+		for (size_t i = 0; i < srcs.size(); ++i)
+		{
+			readers.push_back(::async(::launch::async, merge_read, ref(*srcs[i]), ref(*dst), ref(dst_mtx), ref(window),
+				ref(*ms[i]), cref(cfg), cref(descs[i]), ref(dst_failed), cref(force_break)));
+		}
+
+		for (size_t i = 0; i < readers.size(); ++i)
+		{
+			readers[i].wait();
+			spdlog::info(LOG_SC_ROUTE "{} {} messages won, {} duplicates, {} late, {} too short.", descs[i],
+				ms[i]->won.load(), ms[i]->duplicate.load(), ms[i]->late.load(), ms[i]->short_msg.load());
+		}
+	}
+
+	/// Bytes moved by a route direction with --splice. Updated by the routing thread.
+	struct splice_stats
+	{
+		atomic<uint64_t> spliced{0}; // Moved between the sockets inside the kernel.
+		atomic<uint64_t> copied{0};  // Copied through a user space buffer (fallback).
+
+		static void add(atomic<uint64_t>& counter, uint64_t val)
+		{
+			counter.store(counter.load(memory_order_relaxed) + val, memory_order_relaxed);
+		}
+	};
+
+	/// Reports splice statistics to the stats file along with the source socket statistics.
+	class splice_stats_report : public socket::stats_extension
+	{
+	public:
+		explicit splice_stats_report(shared_ptr<const splice_stats> ss)
+			: m_ss(std::move(ss))
+		{
+		}
+
+	public:
+		const string stats_to_csv(bool print_header) final
+		{
+			if (print_header)
+				return "byteSpliced,byteCopied";
+
+			const auto s = next_interval();
+			return to_string(s.first) + ',' + to_string(s.second);
+		}
+
+		const nlohmann::json stats_to_json() final
+		{
+			const auto s = next_interval();
+			nlohmann::json root;
+			root["byteSpliced"] = s.first;
+			root["byteCopied"]  = s.second;
+			return root;
+		}
+
+		const char* json_key() const final { return "SpliceStats"; }
+
+	private:
+		pair<uint64_t, uint64_t> next_interval()
+		{
+			const uint64_t spliced = m_ss->spliced.load(memory_order_relaxed);
+			const uint64_t copied  = m_ss->copied.load(memory_order_relaxed);
+			const auto     s       = make_pair(spliced - m_prev_spliced, copied - m_prev_copied);
+			m_prev_spliced = spliced;
+			m_prev_copied  = copied;
+			return s;
+		}
+
+	private:
+		shared_ptr<const splice_stats> m_ss;
+		uint64_t                       m_prev_spliced = 0;
+		uint64_t                       m_prev_copied  = 0;
+	};
+
+#if defined(__linux__)
+	/// Wait until the socket is ready for reading (POLLIN) or writing (POLLOUT).
+	/// @returns false on timeout.
+	bool poll_socket(int fd, short events, int timeout_ms)
+	{
+		pollfd pfd = {fd, events, 0};
+		const int res = ::poll(&pfd, 1, timeout_ms);
+		if (res == -1 && errno != EINTR)
+			throw socket::exception("route::poll error " + to_string(errno));
+		return res > 0;
+	}
+
+	/// Move data from one TCP socket to another through a pipe with splice(), without copying it to user space.
+	/// @returns false if splice() is not supported for these sockets and nothing has been moved.
+	/// @throws socket::exception on a connection failure.
+	bool route_splice(int src_fd, int dst_fd, const string& desc, splice_stats& ss, const atomic_bool& force_break)
+	{
+		int pipefd[2];
+		if (::pipe2(pipefd, O_CLOEXEC | O_NONBLOCK) == -1)
+		{
+			spdlog::warn(LOG_SC_ROUTE "{} Failed to create a pipe for splice: error {}.", desc, errno);
+			return false;
+		}
+
+		struct pipe_guard
+		{
+			int* fds;
+			~pipe_guard()
+			{
+				::close(fds[0]);
+				::close(fds[1]);
+			}
+		} guard = {pipefd};
+
+		// A larger pipe allows moving more data per call. The default is 64 KB.
+		const int    pipe_size = ::fcntl(pipefd[1], F_SETPIPE_SZ, 1024 * 1024);
+		const size_t chunk     = pipe_size > 0 ? pipe_size : 65536;
+		// No SPLICE_F_MORE: on the destination socket it acts as MSG_MORE and would hold back
+		// the sub-MSS tail of every burst until more data arrives.
+		const unsigned flags   = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+
+		spdlog::info(LOG_SC_ROUTE "{0} Started (splice, pipe {1} bytes)", desc, chunk);
+
+		while (!force_break)
+		{
+			const ssize_t in = ::splice(src_fd, nullptr, pipefd[1], nullptr, chunk, flags);
+			if (in == 0)
+				throw socket::exception("route::splice: connection closed by the source");
+
+			if (in == -1)
+			{
+				if (errno == EAGAIN || errno == EINTR)
+				{
+					poll_socket(src_fd, POLLIN, 100);
+					continue;
+				}
+
+				if ((errno == EINVAL || errno == ENOSYS) && ss.spliced.load(memory_order_relaxed) == 0)
+				{
+					spdlog::info(LOG_SC_ROUTE "{} splice is not supported: error {}. Copying.", desc, errno);
+					return false;
+				}
+
+				throw socket::exception("route::splice from the source: error " + to_string(errno));
+			}
+
+			// Drain the pipe to the destination.
+			size_t pending = static_cast<size_t>(in);
+			while (pending > 0 && !force_break)
+			{
+				const ssize_t out = ::splice(pipefd[0], nullptr, dst_fd, nullptr, pending, flags);
+				if (out == -1)
+				{
+					if (errno != EAGAIN && errno != EINTR)
+						throw socket::exception("route::splice to the destination: error " + to_string(errno));
+					poll_socket(dst_fd, POLLOUT, 100);
+					continue;
+				}
+
+				pending -= static_cast<size_t>(out);
+				splice_stats::add(ss.spliced, static_cast<uint64_t>(out));
+			}
+		}
+
+		return true;
+	}
+#endif
+
+	/// Route between two TCP sockets moving the data inside the kernel where possible.
+	/// Falls back to copying through a user space buffer.
+	void route_zero_copy(shared_sock src, shared_sock dst, const config& cfg, const string& desc,
+		socket::stats_writer* stats, const atomic_bool& force_break)
+	{
+		auto ss = make_shared<splice_stats>();
+		if (stats)
+			stats->add_extension(src->id(), make_shared<splice_stats_report>(ss));
+
+		auto log_summary = [&]() {
+			spdlog::info(LOG_SC_ROUTE "{0} {1} bytes spliced, {2} bytes copied.", desc, ss->spliced.load(),
+				ss->copied.load());
+		};
+
+		try
+		{
+#if defined(__linux__)
+			const bool both_tcp = dynamic_cast<socket::tcp*>(src.get()) && dynamic_cast<socket::tcp*>(dst.get());
+			if (!both_tcp)
+			{
+				spdlog::info(LOG_SC_ROUTE "{} splice is only supported between TCP sockets. Copying.", desc);
+			}
+			else if (route_splice(src->id(), dst->id(), desc, *ss, force_break))
+			{
+				log_summary();
+				return;
+			}
+#else
+			spdlog::info(LOG_SC_ROUTE "{} splice is not supported on this platform. Copying.", desc);
+#endif
+
+			vector<char> buffer(cfg.message_size);
+			while (!force_break)
+			{
+				const size_t bytes_read = src->read(mutable_buffer(buffer.data(), buffer.size()), -1);
+				if (bytes_read == 0)
+					continue;
+
+				// TCP may accept only a part of the data.
+				size_t sent = 0;
+				while (sent < bytes_read && !force_break)
+				{
+					const int res = dst->write(const_buffer(buffer.data() + sent, bytes_read - sent));
+					sent += res > 0 ? res : 0;
+				}
+				splice_stats::add(ss->copied, sent);
+			}
+		}
+		catch (const socket::exception&)
+		{
+			log_summary();
+			throw;
+		}
+
+		log_summary();
+	}
+
+	/// Route passing messages through the network impairment emulation stage before writing them.
+	void route_impaired(shared_sock src, shared_sock dst, const config& cfg, const string& desc,
+		socket::stats_writer* stats, const atomic_bool& force_break)
+	{
+		socket::isocket& sock_src = *src.get();
+		socket::isocket& sock_dst = *dst.get();
+
+		auto stage = make_shared<impairment::stage>(cfg.impair, cfg.message_size, [&](const const_buffer& msg) {
+			const int bytes_sent = sock_dst.write(msg);
+			if (bytes_sent != static_cast<int>(msg.size()))
+				spdlog::info("{} write returned {} bytes, expected {}", desc, bytes_sent, msg.size());
+		});
+		if (stats)
+			stats->add_extension(sock_src.id(), make_shared<impairment::stage_stats>(stage));
+
+		spdlog::info(LOG_SC_ROUTE "{0} Started (impairment emulation)", desc);
+
+		vector<char> buffer(cfg.message_size);
+		try
+		{
+			while (!force_break)
+			{
+				const size_t bytes_read = sock_src.read(mutable_buffer(buffer.data(), buffer.size()), -1);
+
+				if (bytes_read == 0)
+				{
+					spdlog::info(LOG_SC_ROUTE "{} read 0 bytes on a socket (spurious read-ready?). Retrying.", desc);
+					continue;
+				}
+
+				stage->submit(const_buffer(buffer.data(), bytes_read));
+			}
+		}
+		catch (const socket::exception&)
+		{
+			stage->stop();
+			throw;
+		}
+
+		stage->stop();
+	}
+
+	void route(shared_sock src, shared_sock dst,
+		const config& cfg, const string&& desc, socket::stats_writer* stats, const atomic_bool& force_break)
+	{
+		XTR_THREADNAME(std::string("XTR:Route"));
+		if (cfg.splice)
+		{
+			route_zero_copy(src, dst, cfg, desc, stats, force_break);
+			return;
+		}
+
+		if (cfg.impair.enabled())
+		{
+			route_impaired(src, dst, cfg, desc, stats, force_break);
+			return;
+		}
+
+		if (cfg.ring_depth > 0)
+		{
+			route_decoupled(src, dst, cfg, desc, stats, force_break);
+			return;
+		}
+
+		vector<char> buffer(cfg.message_size);
+
+		socket::isocket& sock_src = *src.get();
+		socket::isocket& sock_dst = *dst.get();
+		auto             hop      = create_hop_latency(stats, sock_src.id());
+
+		spdlog::info(LOG_SC_ROUTE "{0} Started", desc);
+
+		try
+		{
+			while (!force_break)
+			{
+				const size_t bytes_read = sock_src.read(mutable_buffer(buffer.data(), buffer.size()), -1);
+				const auto   read_end   = hop ? steady_clock::now() : steady_clock::time_point();
+
+				if (bytes_read == 0)
+				{
+					spdlog::info(LOG_SC_ROUTE "{} read 0 bytes on a socket (spurious read-ready?). Retrying.", desc);
+					continue;
+				}
+
+				// SRT can return 0 on SRT_EASYNCSND. Rare for sending. However might be worth to retry.
+				const int bytes_sent = sock_dst.write(const_buffer(buffer.data(), bytes_read));
+				if (hop)
+					hop->submit(read_end, steady_clock::now());
+
+				if (bytes_sent != bytes_read)
+				{
+					spdlog::info("{} write returned {} bytes, expected {}", desc, bytes_sent, bytes_read);
+					continue;
+				}
+			}
+		}
+		catch (const socket::exception&)
+		{
+			if (hop)
+				hop->log_summary(desc);
+			throw;
+		}
+
+		if (hop)
+			hop->log_summary(desc);
+	}
 }
 }
 
@@ -75,6 +983,12 @@ namespace route
 void xtransmit::route::run(const vector<string>& src_urls, const vector<string>& dst_urls,
 	const config& cfg, const atomic_bool& force_break)
 {
+	if (!cfg.routes_file.empty())
+	{
+		run_engine(cfg, force_break);
+		return;
+	}
+
 	vector<UriParser> parsed_src_urls;
 	for (const string& url : src_urls)
 	{
@@ -88,6 +1002,24 @@ void xtransmit::route::run(const vector<string>& src_urls, const vector<string>&
 	}
 
 
+	if ((cfg.fanout || cfg.merge) && cfg.bidir)
+	{
+		spdlog::error(LOG_SC_ROUTE "Bidirectional transmission is not supported with fan-out or merge.");
+		return;
+	}
+
+	if (cfg.fanout && cfg.merge)
+	{
+		spdlog::error(LOG_SC_ROUTE "Fan-out and merge can't be combined.");
+		return;
+	}
+
+	if (cfg.impair.enabled() && (cfg.splice || cfg.fanout || cfg.merge))
+	{
+		spdlog::error(LOG_SC_ROUTE "Impairment emulation can't be combined with splice, fan-out or merge.");
+		return;
+	}
+
 	try {
 		const bool write_stats = cfg.stats_file != "" && cfg.stats_freq_ms > 0;
 		// make_unique is not supported by GCC 4.8, only starting from GCC 4.9 :(
@@ -95,6 +1027,58 @@ void xtransmit::route::run(const vector<string>& src_urls, const vector<string>&
 			? unique_ptr<socket::stats_writer>(new socket::stats_writer(cfg.stats_file, cfg.stats_format, milliseconds(cfg.stats_freq_ms)))
 			: nullptr;
 
+		if (cfg.fanout)
+		{
+			// Each destination URI is a separate connection.
+			vector<shared_sock>   dsts;
+			vector<shared_sock_t> listening_socks(parsed_dst_urls.size() + 1);
+			for (size_t i = 0; i < parsed_dst_urls.size(); ++i)
+			{
+				dsts.push_back(cfg.close_listener
+					? create_connection({parsed_dst_urls[i]})
+					: create_connection({parsed_dst_urls[i]}, listening_socks[i]));
+			}
+			shared_sock src = cfg.close_listener
+				? create_connection(parsed_src_urls)
+				: create_connection(parsed_src_urls, listening_socks.back());
+
+			if (stats)
+			{
+				stats->add_socket(src);
+				for (auto& dst : dsts)
+					stats->add_socket(dst);
+			}
+
+			route_fanout(src, dsts, cfg, stats.get(), force_break);
+			return;
+		}
+
+		if (cfg.merge)
+		{
+			// Each source URI is a separate connection.
+			vector<shared_sock>   srcs;
+			vector<shared_sock_t> listening_socks(parsed_src_urls.size() + 1);
+			shared_sock dst = cfg.close_listener
+				? create_connection(parsed_dst_urls)
+				: create_connection(parsed_dst_urls, listening_socks.back());
+			for (size_t i = 0; i < parsed_src_urls.size(); ++i)
+			{
+				srcs.push_back(cfg.close_listener
+					? create_connection({parsed_src_urls[i]})
+					: create_connection({parsed_src_urls[i]}, listening_socks[i]));
+			}
+
+			if (stats)
+			{
+				stats->add_socket(dst);
+				for (auto& src : srcs)
+					stats->add_socket(src);
+			}
+
+			route_merge(srcs, dst, cfg, stats.get(), force_break);
+			return;
+		}
+
 		shared_sock_t listening_sock_a; // A shared pointer to store a listening socket for multiple connections.
 		shared_sock_t listening_sock_b; // A shared pointer to store a listening socket for multiple connections.
 		shared_sock dst = cfg.close_listener
@@ -111,10 +1095,10 @@ void xtransmit::route::run(const vector<string>& src_urls, const vector<string>&
 		}
 
 		future<void> route_bkwd = cfg.bidir
-			? ::async(::launch::async, route, dst, src, cfg, "[DST->SRC]", ref(force_break))
+			? ::async(::launch::async, route, dst, src, cfg, "[DST->SRC]", stats.get(), ref(force_break))
 			: future<void>();
 
-		route(src, dst, cfg, "[SRC->DST]", force_break);
+		route(src, dst, cfg, "[SRC->DST]", stats.get(), force_break);
 
 		route_bkwd.wait();
 	}
@@ -127,6 +1111,7 @@ void xtransmit::route::run(const vector<string>& src_urls, const vector<string>&
 CLI::App* xtransmit::route::add_subcommand(CLI::App& app, config& cfg, vector<string>& src_urls, vector<string>& dst_urls)
 {
 	const map<string, int> to_ms{ {"s", 1000}, {"ms", 1} };
+	const map<string, int> to_bps{{"kbps", 1000}, {"Mbps", 1000000}, {"Gbps", 1000000000}};
 
 	CLI::App* sc_route = app.add_subcommand("route", "Route data (SRT, UDP)")->fallthrough();
 	sc_route->add_option("-i,--input",  src_urls, "Source URIs");
@@ -138,6 +1123,46 @@ CLI::App* xtransmit::route::add_subcommand(CLI::App& app, config& cfg, vector<st
 	sc_route->add_option("--statsformat", cfg.stats_format, "output stats report format (json, csv)");
 	sc_route->add_option("--statsfreq", cfg.stats_freq_ms, "output stats report frequency (ms)")
 		->transform(CLI::AsNumberWithUnit(to_ms, CLI::AsNumberWithUnit::CASE_SENSITIVE));
+	sc_route->add_option("--routes", cfg.routes_file, "File with routes to serve, a line per route: <src-uri> <dst-uri> [bidir]. Replaces -i and -o");
+	sc_route->add_option("--threads", cfg.threads, fmt::format("Routes file: the number of event loop threads per socket type (default {})", cfg.threads))
+		->check(CLI::PositiveNumber);
+	sc_route->add_flag("--splice", cfg.splice, "Move data between TCP sockets inside the kernel (Linux splice) instead of copying");
+	sc_route->add_flag("--fanout", cfg.fanout, "Send to each of the output URIs separately instead of an SRT group");
+	sc_route->add_flag("--merge", cfg.merge, "Receive the same stream from each of the input URIs separately and forward the first copy of a message");
+	sc_route->add_option("--dedup-key", cfg.dedup_key, "Merge: identify messages by the metrics sequence number (seqno, default) or content hash (hash)")
+		->check(CLI::IsMember({"seqno", "hash"}));
+	sc_route->add_option("--dedup-window", cfg.dedup_window, "Merge: the number of recent messages remembered to detect duplicates (default 65536)")
+		->check(CLI::PositiveNumber);
+	sc_route->add_option("--ring-depth", cfg.ring_depth, "Read and write in separate threads with a ring of N messages in between (default 0 - single thread)")
+		->check(CLI::NonNegativeNumber);
+	sc_route->add_option("--ring-full", cfg.ring_full, "When the ring is full: drop newly read messages (default) or block reading")
+		->check(CLI::IsMember({"drop", "block"}));
+
+	impairment::config& imp = cfg.impair;
+	sc_route->add_option("--impair-delay", imp.delay_ms, "Impairment: fixed delay, ms")
+		->transform(CLI::AsNumberWithUnit(to_ms, CLI::AsNumberWithUnit::CASE_SENSITIVE));
+	sc_route->add_option("--impair-jitter", imp.jitter_ms, "Impairment: delay variation, ms")
+		->transform(CLI::AsNumberWithUnit(to_ms, CLI::AsNumberWithUnit::CASE_SENSITIVE));
+	sc_route->add_option("--impair-jitter-dist", imp.jitter_dist, "Impairment: jitter distribution (uniform - default, normal, pareto)")
+		->check(CLI::IsMember({"uniform", "normal", "pareto"}));
+	sc_route->add_option("--impair-loss", imp.loss, "Impairment: random (Bernoulli) loss, %")
+		->check(CLI::Range(0.0, 100.0));
+	sc_route->add_option("--impair-ge-p", imp.ge_p, "Impairment: Gilbert-Elliott loss, good to bad state transition probability, %")
+		->check(CLI::Range(0.0, 100.0));
+	sc_route->add_option("--impair-ge-r", imp.ge_r, "Impairment: Gilbert-Elliott loss, bad to good state transition probability, %")
+		->check(CLI::Range(0.0, 100.0));
+	sc_route->add_option("--impair-ge-loss", imp.ge_loss_bad, "Impairment: Gilbert-Elliott loss, loss probability in the bad state, % (default 100)")
+		->check(CLI::Range(0.0, 100.0));
+	sc_route->add_option("--impair-reorder", imp.reorder, "Impairment: probability of a message to be sent without delay, ahead of others, %")
+		->check(CLI::Range(0.0, 100.0));
+	sc_route->add_option("--impair-dup", imp.duplicate, "Impairment: duplication probability, %")
+		->check(CLI::Range(0.0, 100.0));
+	sc_route->add_option("--impair-rate", imp.rate_bps, "Impairment: bandwidth limit (default 0 - no limit)")
+		->transform(CLI::AsNumberWithUnit(to_bps, CLI::AsNumberWithUnit::CASE_SENSITIVE));
+	sc_route->add_option("--impair-burst", imp.burst_bytes, "Impairment: bandwidth limit token bucket size, bytes (default 10 ms at the rate)");
+	sc_route->add_option("--impair-queue", imp.queue_limit, fmt::format("Impairment: the maximum number of delayed messages (default {})", imp.queue_limit))
+		->check(CLI::PositiveNumber);
+	sc_route->add_option("--impair-seed", imp.seed, "Impairment: random generator seed (default 0 - random)");
 
 	return sc_route;
 }
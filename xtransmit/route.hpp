@@ -5,6 +5,9 @@
 // Third party libraries
 #include "CLI/CLI.hpp"
 
+// xtransmit
+#include "impairment.hpp"
+
 
 namespace xtransmit {
 	namespace route {
@@ -17,6 +20,16 @@ namespace xtransmit {
 			int stats_freq_ms = 0;
 			std::string stats_file;
 			std::string stats_format = "csv";
+			std::string routes_file;        // Serve all the routes listed in the file with event loop threads.
+			int threads = 2;                // Routes file: the number of event loop threads per socket type.
+			bool splice = false;            // Move data between TCP sockets with splice() (Linux), copy otherwise.
+			bool fanout = false;            // Each output URI is a separate destination with its own writing thread.
+			bool merge = false;             // Each input URI is a separate source of the same stream.
+			std::string dedup_key = "seqno"; // Merge: identify messages by "seqno" (metrics header) or content "hash".
+			int dedup_window = 65536;       // Merge: the number of recent messages remembered.
+			int ring_depth = 0;             // Messages buffered between the reading and the writing thread (0 - single thread).
+			std::string ring_full = "drop"; // Ring full policy: "drop" newly read messages or "block" reading.
+			impairment::config impair;      // Network impairment emulation applied before writing.
 		};
 
 
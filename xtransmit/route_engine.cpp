@@ -0,0 +1,420 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+// submodules
+#include "spdlog/spdlog.h"
+
+// xtransmit
+#include "misc.hpp"
+#include "route_engine.hpp"
+#include "socket_stats.hpp"
+#include "tcp_socket.hpp"
+#include "udp_socket.hpp"
+
+// OpenSRT
+#include "srt.h"
+#include "uriparser.hpp"
+#include "xtr_defs.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+using shared_sock = std::shared_ptr<xtransmit::socket::isocket>;
+
+#define LOG_SC_ENGINE "ENGINE "
+
+namespace xtransmit
+{
+namespace route
+{
+
+namespace
+{
+
+struct route_desc
+{
+	string src_url;
+	string dst_url;
+	bool   bidir = false;
+};
+
+/// One direction of a route served by an event loop.
+struct direction
+{
+	shared_sock src;
+	shared_sock dst;
+	string      desc;
+	bool        closed = false;
+	uint64_t    msgs   = 0;
+	uint64_t    bytes  = 0;
+	uint64_t    drops  = 0; // Messages dropped because the destination was not write-ready.
+};
+
+using shared_direction = shared_ptr<direction>;
+
+vector<route_desc> read_routes_file(const string& path)
+{
+	ifstream file(path);
+	if (!file)
+		throw socket::exception("Failed to open routes file " + path);
+
+	vector<route_desc> routes;
+	string             line;
+	int                line_no = 0;
+	while (getline(file, line))
+	{
+		++line_no;
+		istringstream ss(line);
+		route_desc    r;
+		if (!(ss >> r.src_url) || r.src_url[0] == '#')
+			continue;
+
+		string opt;
+		if (!(ss >> r.dst_url) || ((ss >> opt) && opt != "bidir"))
+			throw socket::exception(path + ":" + to_string(line_no) + ": expected \"<src-uri> <dst-uri> [bidir]\"");
+		r.bidir = opt == "bidir";
+		routes.push_back(r);
+	}
+
+	return routes;
+}
+
+bool is_system_socket(const shared_sock& s)
+{
+	return dynamic_cast<socket::udp*>(s.get()) || dynamic_cast<socket::tcp*>(s.get());
+}
+
+/// @throws socket::exception if the readiness of the socket can't be waited for with epoll.
+void check_source(const shared_sock& s)
+{
+	// A multishot receive drains the socket into the buffers of the ring, so the socket never reports readiness.
+	const auto* udp = dynamic_cast<socket::udp*>(s.get());
+	const auto* tcp = dynamic_cast<socket::tcp*>(s.get());
+	if ((udp && udp->uses_uring()) || (tcp && tcp->uses_uring()))
+		throw socket::exception("engine=uring source is not supported");
+}
+
+/// @throws socket::exception if a message dropped on the way to the socket would corrupt the stream.
+void check_destination(const shared_sock& s)
+{
+	const auto* tcp = dynamic_cast<socket::tcp*>(s.get());
+	if (tcp && !tcp->is_framed())
+		throw socket::exception("unframed TCP destination is not supported (a dropped message would leave a hole "
+			"in the byte stream), use framed=1");
+}
+
+/// Event loop thread serving route directions.
+/// Waits for the source sockets to become readable, forwards one message per read-ready event.
+/// Neither reads nor writes wait, so a slow destination drops its own messages instead of stalling
+/// the other routes of the loop. A socket with "blocking=true" in its URI still blocks the whole loop.
+class event_loop
+{
+public:
+	/// @param srt  wait for SRT sockets with SRT epoll, otherwise for system sockets with Linux epoll
+	event_loop(bool srt, int msg_size)
+		: m_srt(srt)
+		, m_buffer(msg_size)
+	{
+	}
+
+	~event_loop() { release(); }
+
+	void add(shared_direction d) { m_dirs.push_back(std::move(d)); }
+	bool empty() const { return m_dirs.empty(); }
+
+	void run(const atomic_bool& force_break)
+	{
+		XTR_THREADNAME(std::string(m_srt ? "XTR:EngSRT" : "XTR:EngSys"));
+		try
+		{
+			create();
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::error(LOG_SC_ENGINE "{}", e.what());
+			return;
+		}
+
+		size_t active = m_dirs.size();
+		while (!force_break && active > 0)
+		{
+			for (direction* d : wait(100))
+			{
+				if (!forward(*d))
+				{
+					remove(*d);
+					--active;
+				}
+			}
+		}
+	}
+
+private:
+	void create()
+	{
+		if (m_srt)
+		{
+			m_eid = srt_epoll_create();
+			if (m_eid == SRT_ERROR)
+				throw socket::exception("Failed to create SRT epoll");
+			srt_epoll_set(m_eid, SRT_EPOLL_ENABLE_EMPTY);
+
+			const int events = SRT_EPOLL_IN | SRT_EPOLL_ERR;
+			for (auto& d : m_dirs)
+			{
+				srt_epoll_add_usock(m_eid, static_cast<SRTSOCKET>(d->src->id()), &events);
+				m_by_id[d->src->id()] = d.get();
+			}
+			m_srt_events.resize(m_dirs.size());
+			return;
+		}
+
+#if defined(__linux__)
+		m_epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (m_epfd == -1)
+			throw socket::exception("Failed to create epoll: error " + to_string(errno));
+
+		for (auto& d : m_dirs)
+		{
+			epoll_event ev = {};
+			ev.events      = EPOLLIN | EPOLLERR | EPOLLHUP;
+			ev.data.ptr    = d.get();
+			epoll_ctl(m_epfd, EPOLL_CTL_ADD, static_cast<int>(d->src->id()), &ev);
+		}
+		m_sys_events.resize(m_dirs.size());
+#else
+		throw socket::exception("Routes from UDP and TCP sockets are only supported on Linux");
+#endif
+	}
+
+	void release()
+	{
+		if (m_eid != -1)
+			srt_epoll_release(m_eid);
+		m_eid = -1;
+#if defined(__linux__)
+		if (m_epfd != -1)
+			::close(m_epfd);
+		m_epfd = -1;
+#endif
+	}
+
+	/// @returns directions with the source socket ready (or failed).
+	vector<direction*> wait(int timeout_ms)
+	{
+		vector<direction*> ready;
+		if (m_srt)
+		{
+			const int n = srt_epoll_uwait(m_eid, m_srt_events.data(), static_cast<int>(m_srt_events.size()), timeout_ms);
+			for (int i = 0; i < n; ++i)
+			{
+				auto it = m_by_id.find(m_srt_events[i].fd);
+				if (it != m_by_id.end())
+					ready.push_back(it->second);
+			}
+			return ready;
+		}
+
+#if defined(__linux__)
+		const int n = epoll_wait(m_epfd, m_sys_events.data(), static_cast<int>(m_sys_events.size()), timeout_ms);
+		for (int i = 0; i < n; ++i)
+			ready.push_back(static_cast<direction*>(m_sys_events[i].data.ptr));
+#endif
+		return ready;
+	}
+
+	void remove(direction& d)
+	{
+		d.closed = true;
+		if (m_srt)
+		{
+			srt_epoll_remove_usock(m_eid, static_cast<SRTSOCKET>(d.src->id()));
+			m_by_id.erase(d.src->id());
+			return;
+		}
+#if defined(__linux__)
+		epoll_ctl(m_epfd, EPOLL_CTL_DEL, static_cast<int>(d.src->id()), nullptr);
+#endif
+	}
+
+	/// Forward one message of the direction.
+	/// @returns false if the direction has failed.
+	bool forward(direction& d)
+	{
+		try
+		{
+			// The socket is read-ready: do not wait.
+			const size_t bytes_read = d.src->read(mutable_buffer(m_buffer.data(), m_buffer.size()), 0);
+			if (bytes_read == 0)
+				return true;
+
+			// Do not wait for the destination either: the loop thread is shared by other routes.
+			const int bytes_sent = d.dst->write(const_buffer(m_buffer.data(), bytes_read), 0);
+			if (bytes_sent == 0)
+			{
+				if (d.drops++ == 0)
+					spdlog::warn(LOG_SC_ENGINE "{} destination is not write-ready, dropping messages.", d.desc);
+				return true;
+			}
+
+			// A framed TCP or a message socket writes the whole message or nothing.
+			if (bytes_sent != static_cast<int>(bytes_read))
+				spdlog::info(LOG_SC_ENGINE "{} write returned {} bytes, expected {}", d.desc, bytes_sent, bytes_read);
+
+			++d.msgs;
+			d.bytes += bytes_read;
+			return true;
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::warn(LOG_SC_ENGINE "{} {}. Closed.", d.desc, e.what());
+			return false;
+		}
+	}
+
+private:
+	const bool                          m_srt;
+	vector<char>                        m_buffer;
+	vector<shared_direction>            m_dirs;
+	int                                 m_eid = -1;
+	vector<SRT_EPOLL_EVENT>             m_srt_events;
+	unordered_map<SOCKET, direction*>   m_by_id;
+#if defined(__linux__)
+	int                                 m_epfd = -1;
+	vector<epoll_event>                 m_sys_events;
+#endif
+};
+
+} // namespace
+
+void run_engine(const config& cfg, const atomic_bool& force_break)
+{
+	vector<route_desc> routes;
+	try
+	{
+		routes = read_routes_file(cfg.routes_file);
+	}
+	catch (const socket::exception& e)
+	{
+		spdlog::error(LOG_SC_ENGINE "{}", e.what());
+		return;
+	}
+
+	// Connection establishment may block (e.g. waiting for a caller), so routes are connected in parallel.
+	using conn_pair = pair<shared_sock, shared_sock>;
+	vector<future<conn_pair>> connecting;
+	for (const auto& r : routes)
+	{
+		connecting.push_back(::async(::launch::async, [&r]() {
+			shared_sock dst = create_connection({UriParser(r.dst_url)});
+			shared_sock src = create_connection({UriParser(r.src_url)});
+			return make_pair(src, dst);
+		}));
+	}
+
+	const bool write_stats = cfg.stats_file != "" && cfg.stats_freq_ms > 0;
+	unique_ptr<socket::stats_writer> stats = write_stats
+		? unique_ptr<socket::stats_writer>(new socket::stats_writer(cfg.stats_file, cfg.stats_format, milliseconds(cfg.stats_freq_ms)))
+		: nullptr;
+
+	vector<shared_direction> dirs;
+	size_t                   num_served = 0; // Routes connected, each serves one or two directions.
+	for (size_t i = 0; i < routes.size(); ++i)
+	{
+		conn_pair conn;
+		try
+		{
+			conn = connecting[i].get();
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::error(LOG_SC_ENGINE "Route {} ({} -> {}): {}", i + 1, routes[i].src_url, routes[i].dst_url, e.what());
+			continue;
+		}
+
+		if (!conn.first || !conn.second)
+			continue;
+
+		try
+		{
+			check_source(conn.first);
+			check_destination(conn.second);
+			if (routes[i].bidir)
+			{
+				check_source(conn.second);
+				check_destination(conn.first);
+			}
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::error(LOG_SC_ENGINE "Route {} ({} -> {}): {}", i + 1, routes[i].src_url, routes[i].dst_url, e.what());
+			continue;
+		}
+
+		if (stats)
+		{
+			stats->add_socket(conn.first);
+			stats->add_socket(conn.second);
+		}
+
+		const string name = "[R" + to_string(i + 1);
+		dirs.push_back(make_shared<direction>(direction{conn.first, conn.second, name + " SRC->DST]"}));
+		++num_served;
+		if (routes[i].bidir)
+			dirs.push_back(make_shared<direction>(direction{conn.second, conn.first, name + " DST->SRC]"}));
+	}
+
+	// Distribute the directions round-robin between the loops of the matching type.
+	const size_t       num_threads = cfg.threads > 0 ? cfg.threads : 1;
+	vector<unique_ptr<event_loop>> srt_loops, sys_loops;
+	for (size_t i = 0; i < num_threads; ++i)
+	{
+		srt_loops.emplace_back(new event_loop(true, cfg.message_size));
+		sys_loops.emplace_back(new event_loop(false, cfg.message_size));
+	}
+
+	size_t next_srt = 0, next_sys = 0;
+	for (auto& d : dirs)
+	{
+		if (is_system_socket(d->src))
+			sys_loops[next_sys++ % num_threads]->add(d);
+		else
+			srt_loops[next_srt++ % num_threads]->add(d);
+	}
+
+	spdlog::info(LOG_SC_ENGINE "Serving {} of {} routes ({} directions) with up to {} SRT and {} system socket loop threads.",
+		num_served, routes.size(), dirs.size(), min(num_threads, next_srt), min(num_threads, next_sys));
+
+	vector<future<void>> threads;
+	for (auto* loops : {&srt_loops, &sys_loops})
+	{
+		for (auto& loop : *loops)
+		{
+			if (!loop->empty())
+				threads.push_back(::async(::launch::async, &event_loop::run, loop.get(), cref(force_break)));
+		}
+	}
+
+	for (auto& t : threads)
+		t.wait();
+
+	for (const auto& d : dirs)
+		spdlog::info(LOG_SC_ENGINE "{} {} messages ({} bytes) forwarded, {} dropped{}.", d->desc, d->msgs, d->bytes, d->drops,
+			d->closed ? ", closed" : "");
+}
+
+} // namespace route
+} // namespace xtransmit
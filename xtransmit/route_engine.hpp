@@ -0,0 +1,23 @@
+#pragma once
+#include <atomic>
+
+// xtransmit
+#include "route.hpp"
+
+namespace xtransmit
+{
+namespace route
+{
+
+/// Run all routes listed in the cfg.routes_file on a small pool of event loop threads.
+///
+/// Each non-empty line of the file describes a route: "<src-uri> <dst-uri> [bidir]".
+/// Lines starting with '#' are comments.
+/// Routes are connected at start. A route direction is served by a loop thread
+/// selected by the type of the socket it reads from: SRT sockets are waited with an SRT epoll,
+/// UDP and TCP sockets with a Linux epoll. A failed route is closed and not reconnected.
+/// A message the destination is not ready to accept is dropped rather than waited for.
+void run_engine(const config& cfg, const std::atomic_bool& force_break);
+
+} // namespace route
+} // namespace xtransmit
@@ -1,8 +1,12 @@
 #pragma once
+#include <algorithm>
+#include <cstring>
 #include <map>
+#include <vector>
 
 #if !defined(_WIN32)
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 typedef int SOCKET;
 #define INVALID_SOCKET ((SOCKET)-1)
 #define closesocket close
@@ -33,6 +37,32 @@ private:
 	const std::string m_error_msg;
 };
 
+#if !defined(_WIN32)
+/// The maximum number of buffers in a sequence passed to a system socket at once.
+constexpr size_t MAX_IOV = 16;
+
+/// Describe a buffer sequence with an array of iovec to be passed to a system call.
+///
+/// @returns The number of iovec filled.
+///
+/// @throws socket::exception if the sequence has more than max_iov buffers.
+template <class Buffer>
+size_t to_iovec(const buffer_sequence<Buffer> &buffers, iovec *iov, size_t max_iov = MAX_IOV)
+{
+	if (buffers.count() > max_iov)
+		throw socket::exception("Too many buffers in a sequence: " + std::to_string(buffers.count()));
+
+	size_t n = 0;
+	for (const Buffer &b : buffers)
+	{
+		iov[n].iov_base = const_cast<void *>(static_cast<const void *>(b.data()));
+		iov[n].iov_len  = b.size();
+		++n;
+	}
+	return n;
+}
+#endif
+
 class isocket
 {
 
@@ -56,6 +86,57 @@ public:
 	 */
 	virtual int write(const const_buffer &buffer, int timeout_ms = -1) = 0;
 
+	/** Read a message from socket scattering it into a sequence of buffers.
+	 *
+	 * The default implementation reads into a scratch buffer and copies the data out.
+	 * System sockets override it with a scatter read.
+	 *
+	 * @returns The number of bytes read.
+	 *
+	 * @throws socket::exception Thrown on failure.
+	 */
+	virtual size_t read(const mutable_buffer_sequence &buffers, int timeout_ms = -1)
+	{
+		if (buffers.count() == 1)
+			return read(buffers[0], timeout_ms);
+
+		std::vector<char> &scratch = scratch_buffer(buffers.size());
+		const size_t       len     = read(mutable_buffer(scratch.data(), buffers.size()), timeout_ms);
+
+		size_t copied = 0;
+		for (const mutable_buffer &b : buffers)
+		{
+			const size_t n = std::min(b.size(), len - copied);
+			std::memcpy(b.data(), scratch.data() + copied, n);
+			copied += n;
+		}
+		return len;
+	}
+
+	/** Write a message gathered from a sequence of buffers to socket.
+	 *
+	 * The default implementation copies the buffers into a scratch buffer to write them at once.
+	 * System sockets override it with a gather write.
+	 *
+	 * @returns The number of bytes written.
+	 *
+	 * @throws socket::exception Thrown on failure.
+	 */
+	virtual int write(const const_buffer_sequence &buffers, int timeout_ms = -1)
+	{
+		if (buffers.count() == 1)
+			return write(buffers[0], timeout_ms);
+
+		std::vector<char> &scratch = scratch_buffer(buffers.size());
+		size_t             len     = 0;
+		for (const const_buffer &b : buffers)
+		{
+			std::memcpy(scratch.data() + len, b.data(), b.size());
+			len += b.size();
+		}
+		return write(const_buffer(scratch.data(), len), timeout_ms);
+	}
+
 public:
 	/** Check if statistics is supported by a socket implementation.
 	 *
@@ -74,6 +155,16 @@ public:
 
 
 	virtual SOCKET id() const = 0;
+
+private:
+	/// Per-thread buffer of at least the given size for the copying read and write.
+	static std::vector<char> &scratch_buffer(size_t size)
+	{
+		thread_local std::vector<char> scratch;
+		if (scratch.size() < size)
+			scratch.resize(size);
+		return scratch;
+	}
 };
 
 } // namespace socket
@@ -1,10 +1,14 @@
 #include <thread>
 #include "socket_stats.hpp"
+#include "misc.hpp"
 #include "xtr_defs.hpp"
 
 // submodules
 #include "spdlog/spdlog.h"
 
+// nlohmann_json
+#include <nlohmann/json.hpp>
+
 using namespace std;
 using namespace xtransmit;
 using namespace std::chrono;
@@ -43,10 +47,29 @@ void xtransmit::socket::stats_writer::add_socket(shared_sock sock)
 	m_stat_future = launch();
 }
 
+void xtransmit::socket::stats_writer::add_extension(SOCKET sockid, shared_ext ext)
+{
+	if (!ext)
+		return;
+
+	m_lock.lock();
+	m_ext[sockid].push_back(std::move(ext));
+	m_lock.unlock();
+
+	spdlog::trace("STATS: Added extension for socket {}.", sockid);
+
+	if (m_stat_future.valid())
+		return;
+
+	m_stop        = false;
+	m_stat_future = launch();
+}
+
 void xtransmit::socket::stats_writer::remove_socket(SOCKET sockid)
 {
 	m_lock.lock();
 	const size_t n = m_sock.erase(sockid);
+	m_ext.erase(sockid);
 	m_lock.unlock();
 
 	if (n == 1)
@@ -63,6 +86,7 @@ void xtransmit::socket::stats_writer::clear()
 {
 	m_lock.lock();
 	m_sock.clear();
+	m_ext.clear();
 	m_lock.unlock();
 }
 
@@ -74,19 +98,183 @@ void xtransmit::socket::stats_writer::stop()
 }
 
 
+namespace
+{
+using shared_ext = shared_ptr<xtransmit::socket::stats_extension>;
+
+/// Appends extension statistics (if any) to the statistics record of a socket.
+/// The socket record is empty if the socket does not support statistics.
+string merge_extension(string sock_stats, SOCKET sockid, const vector<shared_ext>* exts,
+	const string& format, bool print_header)
+{
+	if (!exts || exts->empty())
+		return sock_stats;
+
+	if (format == "json")
+	{
+		// JSON format doesn't have header.
+		if (print_header)
+			return sock_stats;
+
+		nlohmann::json root;
+		if (!sock_stats.empty())
+		{
+			root = nlohmann::json::parse(sock_stats);
+		}
+		else
+		{
+#ifdef HAS_PUT_TIME
+			root["Timepoint"] = print_timestamp_now();
+#endif
+			root["SocketID"] = sockid;
+		}
+		for (const auto& ext : *exts)
+			root[ext->json_key()] = ext->stats_to_json();
+		return root.dump() + "\n";
+	}
+
+	while (!sock_stats.empty() && (sock_stats.back() == '\n' || sock_stats.back() == '\r'))
+		sock_stats.pop_back();
+
+	if (sock_stats.empty())
+	{
+		stringstream ss;
+		if (print_header)
+		{
+#ifdef HAS_PUT_TIME
+			ss << "Timepoint,";
+#endif
+			ss << "SocketID";
+		}
+		else
+		{
+#ifdef HAS_PUT_TIME
+			ss << print_timestamp_now() << ',';
+#endif
+			ss << sockid;
+		}
+		sock_stats = ss.str();
+	}
+
+	for (const auto& ext : *exts)
+		sock_stats += ',' + ext->stats_to_csv(print_header);
+	return sock_stats + '\n';
+}
+
+/// Rows of different CSV shapes (e.g. UDP and SRT sockets, sockets with and without extensions)
+/// written under one header: the union of their columns. Fields a row does not have are left empty.
+class csv_columns
+{
+public:
+	/// Map the columns of a row header to the union, adding the new ones.
+	/// @returns true if columns were added and the header has to be printed again.
+	bool add(const string& header)
+	{
+		if (m_index.count(header))
+			return false;
+
+		bool           grown = false;
+		vector<size_t> index;
+		map<string, size_t> seen; // The same name can repeat in a row, e.g. from two extensions.
+		for (const string& name : split(header))
+		{
+			size_t nth = seen[name]++;
+			size_t i   = 0;
+			while (i < m_names.size() && !(m_names[i] == name && nth-- == 0))
+				++i;
+			if (i == m_names.size())
+			{
+				m_names.push_back(name);
+				grown = true;
+			}
+			index.push_back(i);
+		}
+
+		m_index.emplace(header, std::move(index));
+		return grown;
+	}
+
+	string header() const { return join(m_names); }
+
+	/// Place the values of a row added with add(header) into the columns of the union.
+	string row(const string& header, const string& values) const
+	{
+		const vector<size_t>& index = m_index.at(header);
+		const vector<string>  vals  = split(values);
+		vector<string>        fields(m_names.size());
+		for (size_t i = 0; i < vals.size() && i < index.size(); ++i)
+			fields[index[i]] = vals[i];
+		return join(fields);
+	}
+
+private:
+	static vector<string> split(const string& line)
+	{
+		vector<string> fields;
+		size_t         end = line.find_last_not_of("\r\n");
+		if (end == string::npos)
+			return fields;
+
+		for (size_t pos = 0;;)
+		{
+			const size_t comma = line.find(',', pos);
+			if (comma == string::npos || comma > end)
+			{
+				fields.push_back(line.substr(pos, end + 1 - pos));
+				return fields;
+			}
+			fields.push_back(line.substr(pos, comma - pos));
+			pos = comma + 1;
+		}
+	}
+
+	static string join(const vector<string>& fields)
+	{
+		string line;
+		for (size_t i = 0; i < fields.size(); ++i)
+			line += (i ? "," : "") + fields[i];
+		return line + '\n';
+	}
+
+private:
+	vector<string>                 m_names; // The union of the columns in the order of appearance.
+	map<string, vector<size_t>>    m_index; // Row header -> the union column of each of its columns.
+};
+} // namespace
+
 future<void> xtransmit::socket::stats_writer::launch()
 {
+	/// The CSV header of a socket. Getting the header of an SRT socket resets its statistics,
+	/// so it is requested once per socket.
+	struct sock_header
+	{
+		weak_ptr<socket::isocket> sock;
+		string                    header;
+	};
+
+	// Sockets and extensions may have different columns: rows are written under the union
+	// of all the columns seen so far. The header is printed again only when the union grows.
 	auto print_stats = [](map<SOCKET, shared_sock>& sock_vector,
+		map<SOCKET, vector<shared_ext>>& ext_vector,
 		ofstream& out,
 		mutex& stats_lock,
 		const string& format,
-		bool print_header)
+		map<SOCKET, sock_header>& sock_headers,
+		csv_columns& columns)
 	{
 #ifdef ENABLE_CXX17
 		scoped_lock<mutex> lock(stats_lock);
 #else
 		lock_guard<mutex> lock(stats_lock);
 #endif
+		auto find_ext = [&ext_vector](SOCKET id) -> const vector<shared_ext>* {
+			const auto it = ext_vector.find(id);
+			return it != ext_vector.end() ? &it->second : nullptr;
+		};
+
+		// Rows of the interval (header, values). The header is empty in JSON format.
+		vector<pair<string, string>> rows;
+
 		for (auto& it : sock_vector)
 		{
 			if (!it.second)
@@ -96,13 +284,16 @@ future<void> xtransmit::socket::stats_writer::launch()
 			}
 
 			const auto* s = it.second.get();
+			const auto* ext = find_ext(it.first);
 
 			try
 			{
-				if (print_header)
-					out << s->get_statistics(format, true);
-				out << s->get_statistics(format, false) << flush;
-				print_header = false;
+				sock_header& h = sock_headers[it.first];
+				if (h.sock.lock() != it.second)
+					h = {it.second, s->get_statistics(format, true)};
+
+				rows.emplace_back(merge_extension(h.header, it.first, ext, format, true),
+					merge_extension(s->get_statistics(format, false), it.first, ext, format, false));
 			}
 			catch (const socket::exception& e)
 			{
@@ -126,20 +317,47 @@ future<void> xtransmit::socket::stats_writer::launch()
 		{
 		}
 
-		return print_header;
+		for (auto it = sock_headers.begin(); it != sock_headers.end();)
+		{
+			if (sock_vector.count(it->first))
+				++it;
+			else
+				it = sock_headers.erase(it);
+		}
+
+		// Extensions of sockets not supporting statistics.
+		for (auto& it : ext_vector)
+		{
+			if (it.second.empty() || sock_vector.count(it.first))
+				continue;
+
+			rows.emplace_back(merge_extension(string(), it.first, &it.second, format, true),
+				merge_extension(string(), it.first, &it.second, format, false));
+		}
+
+		bool grown = false;
+		for (const auto& row : rows)
+			grown = (!row.first.empty() && columns.add(row.first)) || grown;
+		if (grown)
+			out << columns.header();
+		for (const auto& row : rows)
+			out << (row.first.empty() ? row.second : columns.row(row.first, row.second));
+		out << flush;
 	};
 
-	auto stats_func = [&print_stats](map<SOCKET, shared_sock>& sock_vector,
+	auto stats_func = [print_stats](map<SOCKET, shared_sock>& sock_vector,
+						 map<SOCKET, vector<shared_ext>>& ext_vector,
 						 ofstream&            out,
 						 const string&        format,
 						 const milliseconds   interval,
 						 mutex&               stats_lock,
 						 const atomic_bool&   stop_stats) {
-		bool print_header = true;
+		map<SOCKET, sock_header> sock_headers;
+		csv_columns              columns;
 
 		while (!stop_stats)
 		{
-			print_header = print_stats(sock_vector, out, stats_lock, format, print_header);
+			print_stats(sock_vector, ext_vector, out, stats_lock, format, sock_headers, columns);
 
 			// No lock on stats_lock while sleeping
 			this_thread::sleep_for(interval);
@@ -147,5 +365,5 @@ future<void> xtransmit::socket::stats_writer::launch()
 	};
 
 	XTR_THREADNAME(std::string("XTR:Stats"));
-	return async(::launch::async, stats_func, ref(m_sock), ref(m_logfile), ref(m_format), m_interval, ref(m_lock), ref(m_stop));
+	return async(::launch::async, stats_func, ref(m_sock), ref(m_ext), ref(m_logfile), ref(m_format), m_interval, ref(m_lock), ref(m_stop));
 }
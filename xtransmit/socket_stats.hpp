@@ -11,12 +11,31 @@
 // xtransmit
 #include "socket.hpp"
 
+// nlohmann_json
+#include <nlohmann/json_fwd.hpp>
+
 
 namespace xtransmit
 {
 namespace socket
 {
 
+/// Application-level statistics of a connection (e.g. of a processing pipe),
+/// reported by the stats_writer along with the statistics of the socket.
+/// Every call to stats_to_csv(false) or stats_to_json() starts a new measurement interval.
+class stats_extension
+{
+public:
+	virtual ~stats_extension() {}
+
+public:
+	/// CSV columns or the CSV header (no leading delimiter, no line end).
+	virtual const std::string stats_to_csv(bool print_header) = 0;
+	virtual const nlohmann::json stats_to_json() = 0;
+	/// The key of the JSON object holding stats_to_json().
+	virtual const char* json_key() const = 0;
+};
+
 class stats_writer
 {
 public:
@@ -25,6 +44,10 @@ public:
 
 public:
 	void add_socket(std::shared_ptr<socket::isocket> sock);
+	/// Report extra statistics for the socket. The socket itself may not support statistics.
+	/// Several extensions of a socket are reported in the order they were added.
+	void add_extension(SOCKET sockid, std::shared_ptr<stats_extension> ext);
+	/// Removes the socket and its extensions if any.
 	void remove_socket(SOCKET sockid);
 	void clear();
 	void stop();
@@ -34,10 +57,12 @@ private:
 
 private:
 	using shared_sock = std::shared_ptr<socket::isocket>;
+	using shared_ext  = std::shared_ptr<stats_extension>;
 	std::atomic<bool> m_stop;
 	std::ofstream m_logfile;
 	std::string m_format;
 	std::map<SOCKET, shared_sock> m_sock;
+	std::map<SOCKET, std::vector<shared_ext>> m_ext;
 	std::future<void> m_stat_future;
 	const std::chrono::milliseconds m_interval;
 	std::mutex m_lock;
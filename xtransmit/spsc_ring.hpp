@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xtransmit
+{
+
+/// Bounded lock-free single-producer single-consumer ring of preallocated slots.
+///
+/// The producer fills the slot returned by free_slot() in place and publishes it with push().
+/// The consumer processes the slot returned by front() in place and releases it with pop().
+/// Neither push() nor pop() take a lock unless the other side is waiting in wait().
+template <class T>
+class spsc_ring
+{
+public:
+	/// @param depth  the number of slots
+	/// @param init   initial value of each slot (e.g. a preallocated buffer)
+	spsc_ring(size_t depth, const T& init = T())
+		: m_slots(depth > 0 ? depth : 1, init)
+	{
+	}
+
+	spsc_ring(const spsc_ring&) = delete;
+	spsc_ring& operator=(const spsc_ring&) = delete;
+
+public:
+	/// Producer: the slot to fill, nullptr if the ring is full.
+	T* free_slot()
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+			return nullptr;
+		return &m_slots[tail % m_slots.size()];
+	}
+
+	/// Producer: publish the slot returned by free_slot().
+	void push()
+	{
+		m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		notify();
+	}
+
+	/// Consumer: the oldest published slot, nullptr if the ring is empty.
+	T* front()
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return nullptr;
+		return &m_slots[head % m_slots.size()];
+	}
+
+	/// Consumer: release the slot returned by front().
+	void pop()
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		notify();
+	}
+
+	/// The number of published slots. Exact if called by the producer or the consumer.
+	size_t size() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+
+	size_t capacity() const { return m_slots.size(); }
+
+	/// Wait until the predicate (e.g. a slot is available) is true or the timeout expires.
+	/// Spins briefly before going to sleep. The other side wakes the waiter on push() or pop().
+	template <class Pred>
+	bool wait(Pred ready, const std::chrono::milliseconds& timeout)
+	{
+		for (int i = 0; i < 64; ++i)
+		{
+			if (ready())
+				return true;
+			std::this_thread::yield();
+		}
+
+		m_waiters.fetch_add(1);
+		bool res;
+		{
+			std::unique_lock<std::mutex> lck(m_mtx);
+			res = m_cv.wait_for(lck, timeout, ready);
+		}
+		m_waiters.fetch_sub(1);
+		return res;
+	}
+
+	/// Wake up the other side if it is waiting.
+	void notify()
+	{
+		// Order the preceding head/tail update before checking for waiters (see wait()).
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_waiters.load(std::memory_order_relaxed) == 0)
+			return;
+
+		std::lock_guard<std::mutex> lck(m_mtx);
+		m_cv.notify_all();
+	}
+
+private:
+	// Consumer and producer positions are kept on separate cache lines to avoid false sharing.
+	static const size_t CACHE_LINE = 64;
+
+	std::vector<T>      m_slots;
+	char                m_pad0[CACHE_LINE];
+	std::atomic<size_t> m_head{0}; // Consumer position.
+	char                m_pad1[CACHE_LINE - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> m_tail{0}; // Producer position.
+	char                m_pad2[CACHE_LINE - sizeof(std::atomic<size_t>)];
+
+	std::atomic<int>        m_waiters{0};
+	std::mutex              m_mtx;
+	std::condition_variable m_cv;
+};
+
+} // namespace xtransmit
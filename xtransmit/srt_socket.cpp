@@ -46,21 +46,16 @@ socket::srt::srt(const UriParser &src_uri)
 	if (SRT_SUCCESS != configure_pre(m_bind_socket))
 		throw socket::exception(srt_getlasterror_str());
 
-	if (!m_blocking_mode)
+	// A caller creates the connection epoll in connect(), it is not needed when connecting with start_connect().
+	if (!m_blocking_mode && m_mode == connection_mode::LISTENER)
 	{
 		m_epoll_connect = srt_epoll_create();
 		if (m_epoll_connect == -1)
 			throw socket::exception(srt_getlasterror_str());
 
-		const bool to_accept = m_mode == connection_mode::LISTENER;
-		int modes = SRT_EPOLL_ERR | (to_accept ? SRT_EPOLL_IN : SRT_EPOLL_OUT);
+		int modes = SRT_EPOLL_ERR | SRT_EPOLL_IN;
 		if (SRT_ERROR == srt_epoll_add_usock(m_epoll_connect, m_bind_socket, &modes))
 			throw socket::exception(srt_getlasterror_str());
-
-		m_epoll_io = srt_epoll_create();
-		modes      = SRT_EPOLL_IN | SRT_EPOLL_OUT | SRT_EPOLL_ERR;
-		if (SRT_ERROR == srt_epoll_add_usock(m_epoll_io, m_bind_socket, &modes))
-			throw socket::exception(srt_getlasterror_str());
 	}
 	
 	// Do binding after PRE options are configured in the above call.
@@ -71,13 +66,6 @@ socket::srt::srt(const int sock, bool blocking)
 	: m_bind_socket(sock)
 	, m_blocking_mode(blocking)
 {
-	if (!m_blocking_mode)
-	{
-		m_epoll_io = srt_epoll_create();
-		int modes  = SRT_EPOLL_IN | SRT_EPOLL_OUT | SRT_EPOLL_ERR;
-		if (SRT_ERROR == srt_epoll_add_usock(m_epoll_io, m_bind_socket, &modes))
-			throw socket::exception(srt_getlasterror_str());
-	}
 }
 
 socket::srt::~srt()
@@ -87,7 +75,8 @@ socket::srt::~srt()
 		spdlog::debug(LOG_SOCK_SRT "@{} Releasing epolls before closing", m_bind_socket);
 		if (m_epoll_connect != -1)
 			srt_epoll_release(m_epoll_connect);
-		srt_epoll_release(m_epoll_io);
+		if (m_epoll_io != -1)
+			srt_epoll_release(m_epoll_io);
 	}
 	spdlog::debug(LOG_SOCK_SRT "@{} Closing", m_bind_socket);
 	srt_close(m_bind_socket);
@@ -168,6 +157,35 @@ void socket::srt::raise_exception(const string &&place, const string &&reason) c
 }
 
 shared_srt socket::srt::connect()
+{
+	if (!m_blocking_mode)
+	{
+		m_epoll_connect = srt_epoll_create();
+		if (m_epoll_connect == -1)
+			raise_exception("connect::epoll_create");
+
+		int modes = SRT_EPOLL_ERR | SRT_EPOLL_OUT;
+		if (SRT_ERROR == srt_epoll_add_usock(m_epoll_connect, m_bind_socket, &modes))
+			raise_exception("connect::epoll_add");
+	}
+
+	start_connect();
+
+	// Wait for REAL connected state if nonblocking mode
+	if (!m_blocking_mode)
+	{
+		// Socket readiness for connection is checked by polling on WRITE allowed sockets.
+		int       len = 2;
+		SRTSOCKET ready[2];
+		if (srt_epoll_wait(m_epoll_connect, 0, 0, ready, &len, -1, 0, 0, 0, 0) == -1)
+			raise_exception("connect.epoll_wait");
+	}
+
+	finish_connect();
+	return shared_from_this();
+}
+
+void socket::srt::start_connect()
 {
 	netaddr_any sa;
 	try
@@ -182,35 +200,25 @@ shared_srt socket::srt::connect()
 	spdlog::debug(LOG_SOCK_SRT "@{} {} Connecting to srt://{}:{:d}",
 		m_bind_socket, m_blocking_mode ? "SYNC" : "ASYNC", m_host, m_port);
 
+	const int res = srt_connect(m_bind_socket, sa.get(), sa.size());
+	if (res == SRT_ERROR)
 	{
-		const int res = srt_connect(m_bind_socket, sa.get(), sa.size());
-		if (res == SRT_ERROR)
-		{
-			// srt_getrejectreason() added in v1.3.4
-			const auto reason = srt_getrejectreason(m_bind_socket);
-			srt_close(m_bind_socket);
-			raise_exception("connect failed", string(srt_getlasterror_str()) + ". Reject reason: " + srt_rejectreason_str(reason));
-		}
+		// srt_getrejectreason() added in v1.3.4
+		const auto reason = srt_getrejectreason(m_bind_socket);
+		srt_close(m_bind_socket);
+		raise_exception("connect failed", string(srt_getlasterror_str()) + ". Reject reason: " + srt_rejectreason_str(reason));
 	}
+}
 
-	// Wait for REAL connected state if nonblocking mode
+void socket::srt::finish_connect()
+{
 	if (!m_blocking_mode)
 	{
-		// Socket readiness for connection is checked by polling on WRITE allowed sockets.
-		int       len = 2;
-		SRTSOCKET ready[2];
-		if (srt_epoll_wait(m_epoll_connect, 0, 0, ready, &len, -1, 0, 0, 0, 0) != -1)
+		const SRT_SOCKSTATUS state = srt_getsockstate(m_bind_socket);
+		if (state != SRTS_CONNECTED)
 		{
-			const SRT_SOCKSTATUS state = srt_getsockstate(m_bind_socket);
-			if (state != SRTS_CONNECTED)
-			{
-				const auto reason = srt_getrejectreason(m_bind_socket);
-				raise_exception("connect failed", srt_rejectreason_str(reason));
-			}
-		}
-		else
-		{
-			raise_exception("connect.epoll_wait");
+			const auto reason = srt_getrejectreason(m_bind_socket);
+			raise_exception("connect failed", srt_rejectreason_str(reason));
 		}
 	}
 
@@ -220,11 +228,16 @@ shared_srt socket::srt::connect()
 			raise_exception("connect::onfigure_post");
 	}
 
+	// The connection epoll is not needed any more. Keep the epoll IDs for sockets with many connections.
+	if (m_epoll_connect != -1)
+	{
+		srt_epoll_release(m_epoll_connect);
+		m_epoll_connect = -1;
+	}
+
 	spdlog::info(LOG_SOCK_SRT "@{} {} Connected to srt://{}:{:d}. {}.",
 		m_bind_socket, m_blocking_mode ? "SYNC" : "ASYNC", m_host, m_port,
 		print_negotiated_config(m_bind_socket));
-
-	return shared_from_this();
 }
 
 std::future<shared_srt> socket::srt::async_connect()
@@ -499,8 +512,36 @@ void socket::srt::handle_hosts()
 
 size_t socket::srt::read(const mutable_buffer &buffer, int timeout_ms)
 {
-	if (!m_blocking_mode)
+	SRT_MSGCTRL mctrl = srt_msgctrl_default;
+	return read_msg(buffer, mctrl, timeout_ms);
+}
+
+void socket::srt::create_io_epoll()
+{
+	// A socket can be read and written by different threads.
+	call_once(m_epoll_io_once, [this]() {
+		const int eid = srt_epoll_create();
+		if (eid == SRT_ERROR)
+			raise_exception("epoll_create");
+
+		const int modes = SRT_EPOLL_IN | SRT_EPOLL_OUT | SRT_EPOLL_ERR;
+		if (SRT_ERROR == srt_epoll_add_usock(eid, m_bind_socket, &modes))
+		{
+			srt_epoll_release(eid);
+			raise_exception("epoll_add");
+		}
+		m_epoll_io = eid;
+	});
+}
+
+size_t socket::srt::read_msg(const mutable_buffer &buffer, SRT_MSGCTRL& mctrl, int timeout_ms)
+{
+	// Without waiting a non-blocking socket is read directly: sockets served by a worker
+	// (see srt_worker_pool) don't need an epoll of their own.
+	if (!m_blocking_mode && timeout_ms != 0)
 	{
+		create_io_epoll();
+
 		int ready[2] = {SRT_INVALID_SOCK, SRT_INVALID_SOCK};
 		int len      = 2;
 
@@ -514,7 +555,7 @@ size_t socket::srt::read(const mutable_buffer &buffer, int timeout_ms)
 		}
 	}
 
-	const int res = srt_recvmsg2(m_bind_socket, static_cast<char *>(buffer.data()), (int)buffer.size(), nullptr);
+	const int res = srt_recvmsg2(m_bind_socket, static_cast<char *>(buffer.data()), (int)buffer.size(), &mctrl);
 	if (SRT_ERROR == res)
 	{
 		if (srt_getlasterror(nullptr) != SRT_EASYNCRCV)
@@ -529,8 +570,16 @@ size_t socket::srt::read(const mutable_buffer &buffer, int timeout_ms)
 
 int socket::srt::write(const const_buffer &buffer, int timeout_ms)
 {
-	if (!m_blocking_mode)
+	SRT_MSGCTRL mctrl = srt_msgctrl_default;
+	return write_msg(buffer, mctrl, timeout_ms);
+}
+
+int socket::srt::write_msg(const const_buffer &buffer, SRT_MSGCTRL& mctrl, int timeout_ms)
+{
+	if (!m_blocking_mode && timeout_ms != 0)
 	{
+		create_io_epoll();
+
 		int ready[2] = {SRT_INVALID_SOCK, SRT_INVALID_SOCK};
 		int len      = 2;
 		int rready[2] = {SRT_INVALID_SOCK, SRT_INVALID_SOCK};
@@ -541,7 +590,7 @@ int socket::srt::write(const const_buffer &buffer, int timeout_ms)
 			raise_exception("write::epoll");
 	}
 
-	const int res = srt_sendmsg2(m_bind_socket, static_cast<const char*>(buffer.data()), static_cast<int>(buffer.size()), nullptr);
+	const int res = srt_sendmsg2(m_bind_socket, static_cast<const char*>(buffer.data()), static_cast<int>(buffer.size()), &mctrl);
 	if (res == SRT_ERROR)
 	{
 		if (srt_getlasterror(nullptr) == SRT_EASYNCSND)
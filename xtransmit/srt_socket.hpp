@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <unordered_set>
 
 // xtransmit
@@ -25,9 +26,30 @@ namespace xtransmit
 namespace socket
 {
 
+/// Reading and writing SRT messages with the message control (SRT_MSGCTRL):
+/// the source time, the sequence number of the first packet and the message number.
+/// Implemented by SRT sockets and groups.
+class srt_msg_io
+{
+public:
+	virtual ~srt_msg_io() = default;
+
+	/// Read a message. On success mctrl holds the source time (srt_time_now() clock),
+	/// the packet sequence number and the message number of the message.
+	/// @returns the number of bytes received, 0 on timeout.
+	/// @throws socket::exception on failure.
+	virtual size_t read_msg(const mutable_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms = -1) = 0;
+
+	/// Write a message. mctrl.srctime sets the source time of the message (0 - the time of the call).
+	/// @returns the number of bytes sent, 0 if the sender buffer is full (non-blocking mode).
+	/// @throws socket::exception on failure.
+	virtual int write_msg(const const_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms = -1) = 0;
+};
+
 class srt
 	: public std::enable_shared_from_this<srt>
 	, public isocket
+	, public srt_msg_io
 {
 	using string     = std::string;
 	using shared_srt = std::shared_ptr<srt>;
@@ -46,6 +68,16 @@ public:
 	shared_srt connect();
 	shared_srt accept();
 
+	/// Start connecting without waiting for the handshake to complete (non-blocking mode).
+	/// The socket reports SRT_EPOLL_OUT once the handshake is done, or SRT_EPOLL_ERR if it has failed.
+	/// Then finish_connect() must be called. connect() does both.
+	/// @throws socket::exception if the connection can't be started.
+	void start_connect();
+
+	/// Complete the connection started with start_connect().
+	/// @throws socket::exception if the connection has failed.
+	void finish_connect();
+
 	/**
 	 * Start listening on the incomming connection requests.
 	 *
@@ -83,6 +115,13 @@ public:
 	size_t read(const mutable_buffer& buffer, int timeout_ms = -1) final;
 	int    write(const const_buffer& buffer, int timeout_ms = -1) final;
 
+	size_t read_msg(const mutable_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms = -1) final;
+	int    write_msg(const const_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms = -1) final;
+
+	// Buffer sequences are copied into a contiguous message.
+	using isocket::read;
+	using isocket::write;
+
 	enum connection_mode
 	{
 		FAILURE    = -1,
@@ -94,6 +133,7 @@ public:
 	connection_mode mode() const;
 
 	bool is_caller() const final { return m_mode == CALLER; }
+	bool is_blocking() const { return m_blocking_mode; }
 
 public:
 	SOCKET						id() const final { return m_bind_socket; }
@@ -107,10 +147,14 @@ private:
 	void raise_exception(const string&& place) const;
 	void raise_exception(const string&& place, const string&& reason) const;
 
+	/// Create the epoll to wait for reading and writing, if not yet.
+	void create_io_epoll();
+
 private:
 	SRTSOCKET m_bind_socket = SRT_INVALID_SOCK;
 	int m_epoll_connect = -1;
-	int m_epoll_io      = -1;
+	int m_epoll_io      = -1; // Created on the first read or write with waiting.
+	std::once_flag m_epoll_io_once;
 
 	connection_mode          m_mode          = FAILURE;
 	bool                     m_blocking_mode = false;
@@ -742,6 +742,12 @@ int socket::srt_group::configure_post(SRTSOCKET sock, int link_index)
 }
 
 size_t socket::srt_group::read(const mutable_buffer& buffer, int timeout_ms)
+{
+	SRT_MSGCTRL mctrl = srt_msgctrl_default;
+	return read_msg(buffer, mctrl, timeout_ms);
+}
+
+size_t socket::srt_group::read_msg(const mutable_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms)
 {
 	if (!m_blocking_mode)
 	{
@@ -758,7 +764,7 @@ size_t socket::srt_group::read(const mutable_buffer& buffer, int timeout_ms)
 		}
 	}
 
-	const int res = srt_recvmsg2(m_bind_socket, static_cast<char*>(buffer.data()), (int)buffer.size(), nullptr);
+	const int res = srt_recvmsg2(m_bind_socket, static_cast<char*>(buffer.data()), (int)buffer.size(), &mctrl);
 	if (SRT_ERROR == res)
 	{
 		if (srt_getlasterror(nullptr) != SRT_EASYNCRCV)
@@ -772,6 +778,12 @@ size_t socket::srt_group::read(const mutable_buffer& buffer, int timeout_ms)
 }
 
 int socket::srt_group::write(const const_buffer& buffer, int timeout_ms)
+{
+	SRT_MSGCTRL mctrl = srt_msgctrl_default;
+	return write_msg(buffer, mctrl, timeout_ms);
+}
+
+int socket::srt_group::write_msg(const const_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms)
 {
 	if (!m_blocking_mode)
 	{
@@ -786,7 +798,7 @@ int socket::srt_group::write(const const_buffer& buffer, int timeout_ms)
 	}
 
 	const int res =
-		srt_sendmsg2(m_bind_socket, static_cast<const char*>(buffer.data()), static_cast<int>(buffer.size()), nullptr);
+		srt_sendmsg2(m_bind_socket, static_cast<const char*>(buffer.data()), static_cast<int>(buffer.size()), &mctrl);
 	if (res == SRT_ERROR)
 	{
 		if (srt_getlasterror(nullptr) == SRT_EASYNCSND)
@@ -11,6 +11,7 @@
 #include "buffer.hpp"
 #include "socket.hpp"
 #include "scheduler.hpp"
+#include "srt_socket.hpp"
 
 // OpenSRT
 #include "srt.h"
@@ -27,6 +28,7 @@ namespace socket
 class srt_group
 	: public std::enable_shared_from_this<srt_group>
 	, public isocket
+	, public srt_msg_io
 {
 	using string           = std::string;
 	using shared_srt_group = std::shared_ptr<srt_group>;
@@ -87,6 +89,13 @@ public:
 	size_t read(const mutable_buffer& buffer, int timeout_ms = -1) final;
 	int    write(const const_buffer& buffer, int timeout_ms = -1) final;
 
+	size_t read_msg(const mutable_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms = -1) final;
+	int    write_msg(const const_buffer& buffer, SRT_MSGCTRL& mctrl, int timeout_ms = -1) final;
+
+	// Buffer sequences are copied into a contiguous message.
+	using isocket::read;
+	using isocket::write;
+
 	enum connection_mode
 	{
 		FAILURE    = -1,
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+
+// submodules
+#include "spdlog/spdlog.h"
+
+// xtransmit
+#include "srt_worker.hpp"
+#include "xtr_defs.hpp"
+
+// OpenSRT
+#include "srt.h"
+
+using namespace std;
+using namespace std::chrono;
+
+#define LOG_SC_WORKER "WORKER "
+
+namespace xtransmit
+{
+
+/// A worker thread with its own SRT epoll.
+class srt_worker_pool::worker
+{
+public:
+	worker(int idx, const atomic_bool& force_break)
+		: m_idx(idx)
+		, m_force_break(force_break)
+	{
+		m_eid = srt_epoll_create();
+		if (m_eid == SRT_ERROR)
+			throw socket::exception("Failed to create SRT epoll");
+		srt_epoll_set(m_eid, SRT_EPOLL_ENABLE_EMPTY);
+		m_thread = thread(&worker::run, this);
+	}
+
+	~worker()
+	{
+		m_stop = true;
+		m_thread.join();
+		srt_epoll_release(m_eid);
+	}
+
+	size_t count() const { return m_count; }
+
+	void add(connection conn)
+	{
+		// A connected socket is writable: the epoll wakes up the worker to take the connection.
+		const SRTSOCKET id    = static_cast<SRTSOCKET>(conn.sock->id());
+		const int       modes = SRT_EPOLL_IN | SRT_EPOLL_OUT | SRT_EPOLL_ERR;
+		if (srt_epoll_add_usock(m_eid, id, &modes) == SRT_ERROR)
+			throw socket::exception(fmt::format("Failed to add @{} to the worker epoll: {}", id, srt_getlasterror_str()));
+
+		lock_guard<mutex> lck(m_mtx);
+		m_incoming.push_back(std::move(conn));
+		++m_count;
+	}
+
+private:
+	using time_point = steady_clock::time_point;
+	using timer      = pair<time_point, SRTSOCKET>;
+
+	void run()
+	{
+		XTR_THREADNAME(fmt::format("XTR:Worker{}", m_idx));
+
+		unordered_map<SRTSOCKET, connection>                    conns;
+		priority_queue<timer, vector<timer>, greater<timer>>    timers; // Can hold outdated entries.
+		vector<SRT_EPOLL_EVENT>                                 events(256);
+		vector<SRTSOCKET>                                       due;
+
+		// Let the task process events, update the epoll and the timers.
+		auto process = [&](SRTSOCKET id, int ev) {
+			auto it = conns.find(id);
+			if (it == conns.end())
+				return;
+
+			connection& c  = it->second;
+			bool        ok = false;
+			try
+			{
+				ok = !m_force_break && c.task->process(ev);
+			}
+			catch (const socket::exception& e)
+			{
+				spdlog::warn(LOG_SC_WORKER "{} @{} {}", m_idx, id, e.what());
+			}
+
+			if (!ok)
+			{
+				srt_epoll_remove_usock(m_eid, id);
+				c.task.reset();
+				c.on_done(id);
+				conns.erase(it);
+				--m_count;
+				return;
+			}
+
+			const int interest = c.task->interest();
+			if (interest != c.interest)
+			{
+				const int modes = interest | SRT_EPOLL_ERR;
+				srt_epoll_update_usock(m_eid, id, &modes);
+				c.interest = interest;
+			}
+
+			const time_point t = c.task->due();
+			if (t != time_point::max())
+				timers.emplace(t, id);
+		};
+
+		while (!m_stop || !conns.empty())
+		{
+			deque<connection> incoming;
+			{
+				lock_guard<mutex> lck(m_mtx);
+				incoming.swap(m_incoming);
+			}
+
+			for (auto& c : incoming)
+			{
+				const SRTSOCKET id = static_cast<SRTSOCKET>(c.sock->id());
+				c.interest         = SRT_EPOLL_IN | SRT_EPOLL_OUT;
+				conns.emplace(id, std::move(c));
+				// Let the task start and set its interest and due time.
+				process(id, 0);
+			}
+
+			if (m_force_break)
+			{
+				vector<SRTSOCKET> ids;
+				for (const auto& c : conns)
+					ids.push_back(c.first);
+				for (const SRTSOCKET id : ids)
+					process(id, 0);
+				this_thread::sleep_for(milliseconds(10));
+				continue;
+			}
+
+			// Wake up on the nearest due time (SRT epoll has a millisecond resolution).
+			int timeout_ms = 100;
+			if (!timers.empty())
+			{
+				const auto wait = ceil<milliseconds>(timers.top().first - steady_clock::now()).count();
+				timeout_ms      = static_cast<int>(max<long long>(0, min<long long>(wait, timeout_ms)));
+			}
+
+			const int n = srt_epoll_uwait(m_eid, events.data(), static_cast<int>(events.size()), timeout_ms);
+			for (int i = 0; i < n; ++i)
+				process(events[i].fd, events[i].events);
+
+			// Tasks are processed after taking all the due timers, because a task can be due again immediately.
+			const time_point now = steady_clock::now();
+			due.clear();
+			while (!timers.empty() && timers.top().first <= now)
+			{
+				due.push_back(timers.top().second);
+				timers.pop();
+			}
+
+			for (const SRTSOCKET id : due)
+			{
+				auto it = conns.find(id);
+				if (it != conns.end() && it->second.task->due() <= now)
+					process(id, 0);
+			}
+		}
+	}
+
+	template <class To, class Rep, class Period>
+	static To ceil(const duration<Rep, Period>& d)
+	{
+		To t = duration_cast<To>(d);
+		return t < d ? t + To(1) : t;
+	}
+
+private:
+	const int          m_idx;
+	const atomic_bool& m_force_break;
+	int                m_eid = -1;
+	atomic_bool        m_stop{false};
+	atomic<size_t>     m_count{0};
+	mutex              m_mtx;
+	deque<connection>  m_incoming;
+	thread             m_thread;
+};
+
+srt_worker_pool::srt_worker_pool(int num_workers, const atomic_bool& force_break)
+{
+	for (int i = 0; i < num_workers; ++i)
+		m_workers.emplace_back(new worker(i, force_break));
+	spdlog::info(LOG_SC_WORKER "Serving SRT connections with {} worker threads.", num_workers);
+}
+
+srt_worker_pool::~srt_worker_pool() {}
+
+void srt_worker_pool::add(shared_ptr<socket::isocket> sock, unique_ptr<pipe_task> task, function<void(int conn_id)> on_done)
+{
+	auto w = min_element(m_workers.begin(), m_workers.end(),
+		[](const unique_ptr<worker>& a, const unique_ptr<worker>& b) { return a->count() < b->count(); });
+
+	connection c;
+	c.sock    = std::move(sock);
+	c.task    = std::move(task);
+	c.on_done = std::move(on_done);
+	(*w)->add(std::move(c));
+}
+
+} // namespace xtransmit
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// xtransmit
+#include "socket.hpp"
+
+namespace xtransmit
+{
+
+/// A connection processed step by step without blocking by a worker thread (see srt_worker_pool).
+class pipe_task
+{
+public:
+	virtual ~pipe_task() = default;
+
+	/// Process the connection. Called when the socket has the events of interest() or an error,
+	/// and when the due() time has come. Must not block.
+	/// @param events  SRT epoll events of the socket (SRT_EPOLL_IN, SRT_EPOLL_OUT, SRT_EPOLL_ERR), 0 on due time
+	/// @returns false when the pipe is done: the work is complete or the connection has failed.
+	virtual bool process(int events) = 0;
+
+	/// SRT epoll events the pipe waits for (0 - none, only the due time).
+	virtual int interest() const = 0;
+
+	/// The time to call process() regardless of the events, time_point::max() if none.
+	virtual std::chrono::steady_clock::time_point due() const = 0;
+};
+
+/// A few worker threads serving many non-blocking SRT connections.
+/// Each worker waits for the sockets of its connections with a single SRT epoll
+/// and runs their pipe tasks. A connection is assigned to the worker with the fewest connections.
+class srt_worker_pool
+{
+public:
+	srt_worker_pool(int num_workers, const std::atomic_bool& force_break);
+	~srt_worker_pool();
+
+	srt_worker_pool(const srt_worker_pool&) = delete;
+	srt_worker_pool& operator=(const srt_worker_pool&) = delete;
+
+public:
+	/// Start processing a connection.
+	/// @param on_done  called by the worker once the task is done and destroyed
+	/// @throws socket::exception if the socket can't be added to the SRT epoll.
+	void add(std::shared_ptr<socket::isocket> sock, std::unique_ptr<pipe_task> task,
+		std::function<void(int conn_id)> on_done);
+
+private:
+	struct connection
+	{
+		std::shared_ptr<socket::isocket> sock;
+		std::unique_ptr<pipe_task>       task;
+		std::function<void(int conn_id)> on_done;
+		int                              interest = 0;
+	};
+
+	class worker;
+
+	std::vector<std::unique_ptr<worker>> m_workers;
+};
+
+} // namespace xtransmit
@@ -4,6 +4,14 @@
 
 #ifndef _WIN32
 #include <netinet/tcp.h>
+#include <poll.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define XTR_TCP_ZEROCOPY 1
+#endif
 #endif
 
 // submodules
@@ -15,6 +23,22 @@ using shared_tcp = shared_ptr<socket::tcp>;
 
 #define LOG_SOCK_TCP "SOCKET::TCP "
 
+namespace
+{
+// Framed mode: every message is preceded by its length as a 32-bit big-endian value.
+const size_t FRAME_HDR_SIZE = 4;
+const size_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+const size_t RX_BUFFER_SIZE = 64 * 1024;
+
+// Zero-copy mode: the number of buffers that can be in flight.
+const size_t ZC_POOL_SIZE = 64;
+
+void inc(std::atomic<uint64_t>& counter, uint64_t val = 1)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+} // namespace
+
 socket::tcp::tcp(const UriParser& src_uri)
 	: m_host(src_uri.host())
 	, m_port(src_uri.portno())
@@ -35,6 +59,33 @@ socket::tcp::tcp(const UriParser& src_uri)
 	}
 	set_blocking_flags(m_blocking_mode);
 
+	if (m_options.count("framed"))
+	{
+		m_framed = !false_names.count(m_options.at("framed"));
+		m_options.erase("framed");
+#if defined(_WIN32)
+		if (m_framed)
+			throw socket::exception("Framed TCP mode is not supported on Windows");
+#endif
+	}
+
+	if (m_options.count("zerocopy"))
+	{
+		m_zerocopy = !false_names.count(m_options.at("zerocopy"));
+		m_options.erase("zerocopy");
+		if (m_zerocopy && m_framed)
+			throw socket::exception("TCP zero-copy can't be used together with framing");
+	}
+	if (m_zerocopy)
+		enable_zerocopy();
+
+	// A stream can deliver more than a message at once: larger receive buffers.
+	m_uring_cfg.num_bufs = 64;
+	m_uring_cfg.buf_size = 64 * 1024;
+	m_uring_requested    = uring_io::parse_options(m_options, m_uring_cfg);
+	if (m_uring_requested && (m_framed || m_zerocopy))
+		throw socket::exception("TCP io_uring engine can't be used together with framing or zero-copy");
+
 	int yes = 1;
 	::setsockopt(m_bind_socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof yes);
 
@@ -94,14 +145,23 @@ socket::tcp::tcp(const UriParser& src_uri)
 	}
 }
 
-socket::tcp::tcp(const int sock, bool blocking)
+socket::tcp::tcp(const int sock, bool blocking, bool framed, bool zerocopy)
 	: m_bind_socket(sock)
 	, m_blocking_mode(blocking)
+	, m_framed(framed)
+	, m_zerocopy(zerocopy)
 {
 	set_blocking_flags(m_blocking_mode);
+	if (m_zerocopy)
+		enable_zerocopy();
 }
 
-socket::tcp::~tcp() { closesocket(m_bind_socket); }
+socket::tcp::~tcp()
+{
+	// Pending io_uring requests refer to the socket.
+	m_uring.reset();
+	closesocket(m_bind_socket);
+}
 
 void socket::tcp::listen()
 {
@@ -167,6 +227,9 @@ shared_tcp socket::tcp::connect()
 	spdlog::debug(LOG_SOCK_TCP "0x{:X} {} Connected to tcp://{}:{:d}",
 		m_bind_socket, m_blocking_mode ? "SYNC" : "ASYNC", m_host, m_port);
 
+	if (m_uring_requested)
+		enable_uring(m_uring_cfg);
+
 	return shared_from_this();
 }
 
@@ -209,7 +272,23 @@ shared_tcp socket::tcp::accept()
 	spdlog::debug(LOG_SOCK_TCP "0x{:X} {} Accepted connection 0x{:X} from {}",
 		m_bind_socket, m_blocking_mode ? "SYNC" : "ASYNC", sock, sa.str());
 
-	return make_shared<tcp>(sock, m_blocking_mode);
+	auto conn = make_shared<tcp>(sock, m_blocking_mode, m_framed, m_zerocopy);
+	if (m_uring_requested)
+		conn->enable_uring(m_uring_cfg);
+	return conn;
+}
+
+void socket::tcp::enable_uring(const uring_io::config& cfg)
+{
+	try
+	{
+		m_uring.reset(new uring_io(m_bind_socket, true, cfg));
+		spdlog::info(LOG_SOCK_TCP "0x{:X} Using io_uring engine.", m_bind_socket);
+	}
+	catch (const socket::exception& e)
+	{
+		spdlog::warn(LOG_SOCK_TCP "0x{:X} {}. Falling back to the socket API.", m_bind_socket, e.what());
+	}
 }
 
 void socket::tcp::raise_exception(const string&& place, const string&& reason) const
@@ -241,24 +320,26 @@ void socket::tcp::set_blocking_flags(bool is_blocking) const
 	}
 }
 
-size_t socket::tcp::read(const mutable_buffer& buffer, int timeout_ms)
+bool socket::tcp::wait_ready(bool for_write, int timeout_ms) const
 {
 	while (!m_blocking_mode)
 	{
-		fd_set fdread;
+		fd_set fdready;
 		fd_set fderror;
 		timeval tv;
-		FD_ZERO(&fdread);
-		FD_SET(m_bind_socket, &fdread);
+		FD_ZERO(&fdready);
+		FD_SET(m_bind_socket, &fdready);
 		FD_ZERO(&fderror);
 		FD_SET(m_bind_socket, &fderror);
 		tv.tv_sec = 0;
-		tv.tv_usec = 10000;
-		const int select_ret = ::select((int)(m_bind_socket + 1), &fdread, NULL, &fderror, &tv);
+		tv.tv_usec = timeout_ms == 0 ? 0 : 10000; // Only poll the state if not allowed to wait.
+		const int select_ret = for_write
+			? ::select((int)m_bind_socket + 1, nullptr, &fdready, &fderror, &tv)
+			: ::select((int)(m_bind_socket + 1), &fdready, NULL, &fderror, &tv);
 
 		if (select_ret == -1)
 		{
-			raise_exception("tcp::read::select", fmt::format("{}", get_last_error()));
+			raise_exception(for_write ? "tcp::write::select" : "tcp::read::select", fmt::format("{}", get_last_error()));
 		}
 
 		if (select_ret != 0)    // ready
@@ -269,9 +350,23 @@ size_t socket::tcp::read(const mutable_buffer& buffer, int timeout_ms)
 		}
 
 		if (timeout_ms >= 0)   // timeout
-			return 0;
+			return false;
 	}
 
+	return true;
+}
+
+size_t socket::tcp::read(const mutable_buffer& buffer, int timeout_ms)
+{
+	if (m_framed)
+		return read_frame(buffer, timeout_ms);
+
+	if (m_uring)
+		return m_uring->recv(buffer, timeout_ms);
+
+	if (!wait_ready(false, timeout_ms))
+		return 0;
+
 	const int res =
 		::recv(m_bind_socket, static_cast<char*>(buffer.data()), (int)buffer.size(), 0);
 	if (res == -1)
@@ -296,35 +391,23 @@ size_t socket::tcp::read(const mutable_buffer& buffer, int timeout_ms)
 
 int socket::tcp::write(const const_buffer& buffer, int timeout_ms)
 {
-	while (!m_blocking_mode)
-	{
-		fd_set fdwrite;
-		fd_set fderror;
-		timeval tv;
-		FD_ZERO(&fdwrite);
-		FD_SET(m_bind_socket, &fdwrite);
-		FD_ZERO(&fderror);
-		FD_SET(m_bind_socket, &fderror);
-		tv.tv_sec = 0;
-		tv.tv_usec = 10000;
-		const int select_ret = ::select((int)m_bind_socket + 1, nullptr, &fdwrite, &fderror, &tv);
-
-		if (select_ret == -1)
-		{
-			raise_exception("tcp::write::select", fmt::format("{}", get_last_error()));
-		}
+	if (m_framed)
+		return write_frame(const_buffer_sequence(&buffer, 1), timeout_ms);
 
-		if (select_ret != 0)    // ready
-		{
-			if (FD_ISSET(m_bind_socket, &fderror))
-				spdlog::info(LOG_SOCK_TCP "0x{:X} select signalled error.", m_bind_socket);
-			break;
-		}
+	if (m_uring)
+		return m_uring->send(buffer, nullptr, 0);
 
-		if (timeout_ms >= 0)   // timeout
-			return 0;
+	if (m_zerocopy)
+	{
+		const int res = write_zerocopy(buffer, timeout_ms);
+		if (res >= 0)
+			return res;
+		inc(m_copied_sends);
 	}
 
+	if (!wait_ready(true, timeout_ms))
+		return 0;
+
 	const int res = ::sendto(m_bind_socket,
 		static_cast<const char*>(buffer.data()),
 		(int)buffer.size(),
@@ -356,9 +439,398 @@ int socket::tcp::write(const const_buffer& buffer, int timeout_ms)
 	return static_cast<size_t>(res);
 }
 
+size_t socket::tcp::read(const mutable_buffer_sequence& buffers, int timeout_ms)
+{
+#if defined(_WIN32)
+	return isocket::read(buffers, timeout_ms);
+#else
+	if (m_framed || m_uring)
+		return isocket::read(buffers, timeout_ms);
+
+	if (!wait_ready(false, timeout_ms))
+		return 0;
+
+	iovec iov[MAX_IOV];
+	const ssize_t res = ::readv(m_bind_socket, iov, static_cast<int>(to_iovec(buffers, iov)));
+	if (res == -1)
+	{
+		const int err = get_last_error();
+		if (err != EAGAIN && err != EINTR && err != ECONNREFUSED)
+			raise_exception("tcp::read::readv", to_string(err));
+
+		spdlog::info("TCP reading failed: error {0}. Again.", err);
+		return 0;
+	}
+	else if (res == 0 && buffers.size() != 0)
+	{
+		raise_exception("tcp::read", "zero bytes read (connection broken)");
+	}
+
+	return static_cast<size_t>(res);
+#endif
+}
+
+int socket::tcp::write(const const_buffer_sequence& buffers, int timeout_ms)
+{
+#if defined(_WIN32)
+	return isocket::write(buffers, timeout_ms);
+#else
+	if (m_framed)
+		return write_frame(buffers, timeout_ms);
+
+	if (m_uring)
+		return isocket::write(buffers, timeout_ms);
+
+	if (!wait_ready(true, timeout_ms))
+		return 0;
+
+	iovec  iov[MAX_IOV];
+	msghdr msg     = {};
+	msg.msg_iov    = iov;
+	msg.msg_iovlen = to_iovec(buffers, iov);
+
+	// ::sendmsg() rather than ::writev() to avoid SIGPIPE on a broken connection.
+	const ssize_t res = ::sendmsg(m_bind_socket, &msg, MSG_NOSIGNAL);
+	if (res == -1)
+	{
+		const int err = get_last_error();
+		if (err != EAGAIN && err != EINTR && err != ECONNREFUSED)
+		{
+			spdlog::info("tcp::write::sendmsg: error {0}.", err);
+			throw socket::exception("tcp::write::sendmsg error");
+		}
+
+		spdlog::info("tcp::sendmsg failed: error {0}. Again.", err);
+		return 0;
+	}
+
+	return static_cast<int>(res);
+#endif
+}
+
+size_t socket::tcp::read_frame(const mutable_buffer& buffer, int timeout_ms)
+{
+#if defined(_WIN32)
+	raise_exception("tcp::read", "framed mode is not supported");
+	return 0;
+#else
+	if (m_rx_buffer.empty())
+		m_rx_buffer.resize(RX_BUFFER_SIZE);
+
+	// Receive until the length prefix is complete. Nothing is lost on timeout:
+	// the received bytes stay in the reassembly buffer until the next call.
+	while (m_rx_tail - m_rx_head < FRAME_HDR_SIZE)
+	{
+		if (m_rx_head > 0)
+		{
+			memmove(m_rx_buffer.data(), m_rx_buffer.data() + m_rx_head, m_rx_tail - m_rx_head);
+			m_rx_tail -= m_rx_head;
+			m_rx_head = 0;
+		}
+
+		if (!wait_ready(false, timeout_ms))
+			return 0;
+
+		const ssize_t res = ::recv(m_bind_socket, m_rx_buffer.data() + m_rx_tail, m_rx_buffer.size() - m_rx_tail, 0);
+		if (res == -1)
+		{
+			const int err = get_last_error();
+			if (err != EAGAIN && err != EINTR && err != ECONNREFUSED)
+				raise_exception("tcp::read::recv", to_string(err));
+			return 0;
+		}
+		else if (res == 0)
+		{
+			raise_exception("tcp::read", "zero bytes read (connection broken)");
+		}
+		m_rx_tail += static_cast<size_t>(res);
+	}
+
+	const unsigned char* hdr = reinterpret_cast<const unsigned char*>(m_rx_buffer.data() + m_rx_head);
+	const size_t len = (size_t(hdr[0]) << 24) | (size_t(hdr[1]) << 16) | (size_t(hdr[2]) << 8) | size_t(hdr[3]);
+	if (len > buffer.size())
+		raise_exception("tcp::read", fmt::format("framed message of {} bytes does not fit into {} bytes", len, buffer.size()));
+	m_rx_head += FRAME_HDR_SIZE;
+
+	char* dst = static_cast<char*>(buffer.data());
+	const size_t buffered = min(m_rx_tail - m_rx_head, len);
+	memcpy(dst, m_rx_buffer.data() + m_rx_head, buffered);
+	m_rx_head += buffered;
+	if (buffered == len)
+		return len;
+
+	// The reassembly buffer is empty now. The rest of the message is received directly into
+	// the user buffer, and whatever follows it into the reassembly buffer.
+	m_rx_head = m_rx_tail = 0;
+	size_t received = buffered;
+	while (received < len)
+	{
+		// The rest of the message is already on the way: wait for it regardless of the timeout.
+		wait_ready(false, -1);
+
+		iovec iov[2];
+		iov[0].iov_base = dst + received;
+		iov[0].iov_len  = len - received;
+		iov[1].iov_base = m_rx_buffer.data();
+		iov[1].iov_len  = m_rx_buffer.size();
+
+		const ssize_t res = ::readv(m_bind_socket, iov, 2);
+		if (res == -1)
+		{
+			const int err = get_last_error();
+			if (err != EAGAIN && err != EINTR)
+				raise_exception("tcp::read::readv", to_string(err));
+			continue;
+		}
+		else if (res == 0)
+		{
+			raise_exception("tcp::read", "zero bytes read (connection broken)");
+		}
+
+		const size_t n = static_cast<size_t>(res);
+		if (n > len - received)
+			m_rx_tail = n - (len - received);
+		received += min(n, len - received);
+	}
+
+	return len;
+#endif
+}
+
+int socket::tcp::write_frame(const const_buffer_sequence& buffers, int timeout_ms)
+{
+#if defined(_WIN32)
+	raise_exception("tcp::write", "framed mode is not supported");
+	return 0;
+#else
+	const size_t len = buffers.size();
+	if (len > MAX_FRAME_SIZE)
+		raise_exception("tcp::write", fmt::format("message of {} bytes is too long for a frame", len));
+
+	if (!wait_ready(true, timeout_ms))
+		return 0;
+
+	unsigned char hdr[FRAME_HDR_SIZE] = {
+		static_cast<unsigned char>(len >> 24), static_cast<unsigned char>(len >> 16),
+		static_cast<unsigned char>(len >> 8), static_cast<unsigned char>(len)};
+
+	iovec iov[MAX_IOV + 1];
+	iov[0].iov_base = hdr;
+	iov[0].iov_len  = FRAME_HDR_SIZE;
+
+	msghdr msg     = {};
+	msg.msg_iov    = iov;
+	msg.msg_iovlen = 1 + to_iovec(buffers, iov + 1);
+
+	size_t remaining = FRAME_HDR_SIZE + len;
+	for (;;)
+	{
+		const ssize_t res = ::sendmsg(m_bind_socket, &msg, MSG_NOSIGNAL);
+		if (res == -1)
+		{
+			const int err = get_last_error();
+			if (err != EAGAIN && err != EINTR)
+			{
+				spdlog::info("tcp::write::sendmsg: error {0}.", err);
+				throw socket::exception("tcp::write::sendmsg error");
+			}
+
+			// Nothing of the frame has been sent yet: let the caller retry.
+			if (remaining == FRAME_HDR_SIZE + len)
+				return 0;
+		}
+		else
+		{
+			remaining -= static_cast<size_t>(res);
+			if (remaining == 0)
+				break;
+
+			// Skip what has been sent.
+			size_t sent = static_cast<size_t>(res);
+			while (sent >= msg.msg_iov->iov_len)
+			{
+				sent -= msg.msg_iov->iov_len;
+				++msg.msg_iov;
+				--msg.msg_iovlen;
+			}
+			msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + sent;
+			msg.msg_iov->iov_len -= sent;
+		}
+
+		// The receiver expects the rest of the frame: complete it regardless of the timeout.
+		wait_ready(true, -1);
+	}
+
+	return static_cast<int>(len);
+#endif
+}
+
+void socket::tcp::enable_zerocopy()
+{
+#if XTR_TCP_ZEROCOPY
+	int yes = 1;
+	if (::setsockopt(m_bind_socket, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof yes) == 0)
+	{
+		m_zc_pool.resize(ZC_POOL_SIZE);
+		return;
+	}
+	spdlog::warn(LOG_SOCK_TCP "0x{:X} Failed to enable SO_ZEROCOPY (error {}). Writes will be copied.", m_bind_socket,
+		get_last_error());
+#else
+	spdlog::warn(LOG_SOCK_TCP "0x{:X} Zero-copy is not supported on this platform. Writes will be copied.", m_bind_socket);
+#endif
+	m_zerocopy = false;
+}
+
+std::vector<char>* socket::tcp::zerocopy_buffer(size_t size, const atomic_bool& force_break)
+{
+	if (!m_zerocopy)
+		return nullptr;
+
+	reap_completions(0);
+	while (!force_break)
+	{
+		// Buffers are completed in the order they were sent, so the search starts after the current one.
+		for (size_t i = 1; i <= m_zc_pool.size(); ++i)
+		{
+			const size_t idx = (m_zc_current + i) % m_zc_pool.size();
+			if (m_zc_pool[idx].inflight != 0)
+				continue;
+
+			m_zc_current = idx;
+			m_zc_pool[idx].data.resize(size);
+			return &m_zc_pool[idx].data;
+		}
+
+		const auto wait_start = chrono::steady_clock::now();
+		reap_completions(10);
+		inc(m_zc_wait_us, chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - wait_start).count());
+
+		// Completions never come if the connection has failed.
+#if XTR_TCP_ZEROCOPY
+		int       err = 0;
+		socklen_t len = sizeof err;
+		if (::getsockopt(m_bind_socket, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err != 0)
+			raise_exception("tcp::zerocopy_buffer", to_string(err));
+#endif
+	}
+
+	return nullptr;
+}
+
+int socket::tcp::write_zerocopy(const const_buffer& buffer, int timeout_ms)
+{
+#if XTR_TCP_ZEROCOPY
+	// Only the buffer handed out by zerocopy_buffer() is guaranteed to stay untouched until completion.
+	const auto& zc = m_zc_pool[m_zc_current].data;
+	const char* ptr = static_cast<const char*>(buffer.data());
+	if (zc.empty() || ptr < zc.data() || ptr + buffer.size() > zc.data() + zc.size())
+		return -1;
+
+	reap_completions(0);
+	if (!wait_ready(true, timeout_ms))
+		return 0;
+
+	const ssize_t res = ::send(m_bind_socket, ptr, buffer.size(), MSG_NOSIGNAL | MSG_ZEROCOPY);
+	if (res == -1)
+	{
+		const int err = get_last_error();
+		// Out of option memory to track the pinned pages.
+		if (err == ENOBUFS)
+			return -1;
+		if (err != EAGAIN && err != EINTR)
+			raise_exception("tcp::write::send", to_string(err));
+		return 0;
+	}
+
+	// Each successful zero-copy send gets the next notification ID.
+	m_zc_inflight.emplace_back(m_zc_next_id++, m_zc_current);
+	++m_zc_pool[m_zc_current].inflight;
+	inc(m_zc_sends);
+	return static_cast<int>(res);
+#else
+	return -1;
+#endif
+}
+
+void socket::tcp::reap_completions(int timeout_ms)
+{
+#if XTR_TCP_ZEROCOPY
+	if (timeout_ms > 0)
+	{
+		// POLLERR is always reported: the error queue is not empty.
+		pollfd pfd = {};
+		pfd.fd     = m_bind_socket;
+		::poll(&pfd, 1, timeout_ms);
+	}
+
+	for (;;)
+	{
+		char   control[128];
+		msghdr msg         = {};
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof control;
+
+		// Reading the error queue never blocks.
+		if (::recvmsg(m_bind_socket, &msg, MSG_ERRQUEUE) == -1)
+			return;
+
+		for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+		{
+			const bool is_recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+				|| (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+			if (!is_recverr)
+				continue;
+
+			sock_extended_err serr;
+			memcpy(&serr, CMSG_DATA(cm), sizeof serr);
+			if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			// The notification covers the range of IDs [ee_info, ee_data].
+			const uint32_t lo = serr.ee_info;
+			const uint32_t n  = serr.ee_data - lo + 1;
+			inc(m_zc_completed, n);
+			if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				inc(m_zc_copied, n);
+
+			for (auto it = m_zc_inflight.begin(); it != m_zc_inflight.end();)
+			{
+				if (it->first - lo < n)
+				{
+					--m_zc_pool[it->second].inflight;
+					it = m_zc_inflight.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+	}
+#endif
+}
+
+string socket::tcp::zerocopy_to_csv(bool print_header) const
+{
+	if (!m_zerocopy)
+		return "";
+
+	if (print_header)
+		return "pktZcSent,pktZcCompleted,pktZcCopied,pktCopiedSent,usZcWait";
+
+	std::ostringstream output;
+	output << m_zc_sends.load(memory_order_relaxed) << ',';
+	output << m_zc_completed.load(memory_order_relaxed) << ',';
+	output << m_zc_copied.load(memory_order_relaxed) << ',';
+	output << m_copied_sends.load(memory_order_relaxed) << ',';
+	output << m_zc_wait_us.load(memory_order_relaxed);
+	return output.str();
+}
+
 #ifdef ENABLE_TCP_STATS
 namespace detail {
-string tcp_info_to_csv(int socketid, const tcp_info& stats, bool print_header)
+string tcp_info_to_csv(int socketid, const tcp_info& stats, bool print_header, const string& extra_csv)
 {
 	std::ostringstream output;
 
@@ -369,6 +841,8 @@ string tcp_info_to_csv(int socketid, const tcp_info& stats, bool print_header)
 #endif
 		output << "Time,SocketID,";
 		output << "rtt,rttvar,retransmits,snd_mss,rcv_mss,lost,retrans,snd_cwnd,rcv_rtt,rcv_space,unacked";
+		if (!extra_csv.empty())
+			output << ',' << extra_csv;
 		output << endl;
 		return output.str();
 	}
@@ -394,6 +868,8 @@ string tcp_info_to_csv(int socketid, const tcp_info& stats, bool print_header)
 	//output << stats.tcpi_bytes_received << ',';
 	//output << stats.tcpi_delivery_rate << ',';
 	output << stats.tcpi_unacked;
+	if (!extra_csv.empty())
+		output << ',' << extra_csv;
 
 	output << endl;
 
@@ -418,11 +894,23 @@ const string socket::tcp::get_statistics(std::string stats_format, bool print_he
 	if (ret == -1)
 		raise_exception("statistics", fmt::format("Error {}", get_last_error()));
 
-	return detail::tcp_info_to_csv(m_bind_socket, tcp_stats, print_header);
+	return detail::tcp_info_to_csv(m_bind_socket, tcp_stats, print_header, zerocopy_to_csv(print_header));
 
 #else
-	raise_exception("TCP statistics", "Not implemented");
-	return "";
+	if (!m_zerocopy)
+		raise_exception("TCP statistics", "Not implemented");
+
+	if (stats_format != "csv")
+		spdlog::warn("TCP {} format is not supported. 'csv' format will be used instead.", stats_format);
+
+	// Only zero-copy counters are available.
+	std::ostringstream output;
+#ifdef HAS_PUT_TIME
+	output << (print_header ? string("Timepoint") : print_timestamp_now()) << ',';
+#endif
+	output << (print_header ? string("SocketID") : to_string(m_bind_socket)) << ',';
+	output << zerocopy_to_csv(print_header) << endl;
+	return output.str();
 #endif
 }
 
@@ -1,11 +1,16 @@
 #pragma once
+#include <atomic>
+#include <deque>
 #include <map>
+#include <memory>
 #include <future>
 #include <string>
+#include <vector>
 
 // xtransmit
 #include "buffer.hpp"
 #include "socket.hpp"
+#include "uring_io.hpp"
 
 // OpenSRT
 #include "uriparser.hpp"
@@ -24,7 +29,7 @@ class tcp
 
 public:
 	explicit tcp(const UriParser& src_uri);
-	tcp(const int sock, bool blocking);
+	tcp(const int sock, bool blocking, bool framed = false, bool zerocopy = false);
 	~tcp();
 
 public:
@@ -38,6 +43,12 @@ public:
 
 	SOCKET id() const final { return m_bind_socket; }
 
+	/// Messages are sent with a length prefix to preserve their boundaries.
+	bool is_framed() const { return m_framed; }
+
+	/// The socket I/O is done with io_uring (engine=uring).
+	bool uses_uring() const { return m_uring != nullptr; }
+
 public:
 	/**
 	 * @returns The number of bytes received.
@@ -47,13 +58,26 @@ public:
 	size_t read(const mutable_buffer& buffer, int timeout_ms = -1) final;
 	int    write(const const_buffer& buffer, int timeout_ms = -1) final;
 
+	/// Scatter read with ::readv().
+	size_t read(const mutable_buffer_sequence& buffers, int timeout_ms = -1) final;
+	/// Gather write with ::sendmsg().
+	int    write(const const_buffer_sequence& buffers, int timeout_ms = -1) final;
+
+	/// Zero-copy mode: get a buffer owned by the socket to fill with the next message to write.
+	/// Writes from this buffer are sent with MSG_ZEROCOPY, and the buffer is not handed out again
+	/// until the kernel reports their completion. Waits for a completion if all buffers are in flight.
+	///
+	/// @returns nullptr if zero-copy mode is not enabled or the wait is interrupted by force_break.
+	/// @throws socket::exception if the connection has failed while waiting.
+	std::vector<char>* zerocopy_buffer(size_t size, const std::atomic_bool& force_break);
+
 public:
 	bool supports_statistics() const final
 	{
 #ifdef ENABLE_TCP_STATS
 		return true;
 #else
-		return false;
+		return m_zerocopy;
 #endif
 	}
 
@@ -69,14 +93,72 @@ private:
 	/// @param is_blocking true if blocking mode is requested.
 	void set_blocking_flags(bool is_blocking) const;
 
+	/// Wait for the socket to become ready in non-blocking mode.
+	/// @returns false on timeout.
+	bool wait_ready(bool for_write, int timeout_ms) const;
+
+	/// Read one whole framed message. Bytes following the message are kept in the reassembly buffer.
+	/// @throws socket::exception if the message does not fit into the buffer.
+	size_t read_frame(const mutable_buffer& buffer, int timeout_ms);
+
+	/// Write the length prefix and the message in one go. A partially sent frame is always completed.
+	int write_frame(const const_buffer_sequence& buffers, int timeout_ms);
+
+	/// Enable SO_ZEROCOPY on the socket. Falls back to copying writes if not supported.
+	void enable_zerocopy();
+
+	/// Zero-copy mode: send from the current zero-copy buffer.
+	/// @returns the number of bytes sent, -1 if the write has to fall back to copying.
+	int write_zerocopy(const const_buffer& buffer, int timeout_ms);
+
+	/// Zero-copy mode: process completion notifications from the socket error queue.
+	/// @param timeout_ms  time to wait for a notification if none is queued (0 - do not wait).
+	void reap_completions(int timeout_ms);
+
+	/// CSV columns of zero-copy counters (header or values), empty if zero-copy is not enabled.
+	string zerocopy_to_csv(bool print_header) const;
+
+	/// Switch a connected socket to the io_uring engine. Falls back to plain syscalls if not supported.
+	void enable_uring(const uring_io::config& cfg);
+
 private:
 	SOCKET      m_bind_socket = -1; // Invalid.
 	sockaddr_in m_dst_addr    = {};
 
 	bool                     m_blocking_mode = false;
+	bool                     m_framed        = false; // Messages are sent with a length prefix.
+	bool                     m_zerocopy      = false; // Messages are sent with MSG_ZEROCOPY from the zero-copy buffers.
 	string                   m_host;
 	int                      m_port;
 	std::map<string, string> m_options; // All other options, as provided in the URI
+
+	// io_uring engine of a connected socket (engine=uring), nullptr for plain syscalls.
+	bool                      m_uring_requested = false;
+	uring_io::config          m_uring_cfg;
+	std::unique_ptr<uring_io> m_uring;
+
+	// Framed mode: bytes received after the last returned message.
+	std::vector<char> m_rx_buffer;
+	size_t            m_rx_head = 0; // The first pending byte.
+	size_t            m_rx_tail = 0; // The end of pending bytes.
+
+	// Zero-copy mode: buffers stay in the pool until all sends from them are completed.
+	struct zc_buffer
+	{
+		std::vector<char> data;
+		int               inflight = 0; // Sends not yet completed by the kernel.
+	};
+	std::vector<zc_buffer>                   m_zc_pool;
+	size_t                                   m_zc_current = 0; // The buffer handed out last.
+	uint32_t                                 m_zc_next_id = 0; // Notification ID of the next zero-copy send.
+	std::deque<std::pair<uint32_t, size_t>>  m_zc_inflight;    // Notification ID and buffer of each send in flight.
+
+	// Updated by the sending thread, read by the statistics thread.
+	std::atomic<uint64_t> m_zc_sends{0};     // Sends with MSG_ZEROCOPY.
+	std::atomic<uint64_t> m_zc_completed{0}; // Zero-copy sends completed.
+	std::atomic<uint64_t> m_zc_copied{0};    // Completed zero-copy sends the kernel had to copy anyway (e.g. loopback).
+	std::atomic<uint64_t> m_copied_sends{0}; // Sends with copying: not from a zero-copy buffer, or out of option memory.
+	std::atomic<uint64_t> m_zc_wait_us{0};   // Time waiting for a free zero-copy buffer.
 };
 
 } // namespace socket
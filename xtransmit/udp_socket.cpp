@@ -2,6 +2,15 @@
 #include "misc.hpp"
 #include "socketoptions.hpp"
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#include <linux/sock_diag.h> // SK_MEMINFO_*
+#include <linux/sockios.h>   // SIOCINQ, SIOCOUTQ
+#endif
+
+// nlohmann_json
+#include <nlohmann/json.hpp>
+
 // submodules
 #include "spdlog/spdlog.h"
 
@@ -11,6 +20,22 @@ using shared_udp = shared_ptr<socket::udp>;
 
 #define LOG_SOCK_UDP "SOCKET::UDP "
 
+namespace
+{
+void inc(std::atomic<uint64_t>& counter, uint64_t val)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+in_addr parse_ipv4(const string& ip, const char* option)
+{
+	in_addr addr = {};
+	if (inet_pton(AF_INET, ip.c_str(), &addr) != 1)
+		throw socket::exception(fmt::format("udp: invalid IPv4 address '{}' in option '{}'", ip, option));
+	return addr;
+}
+} // namespace
+
 socket::udp::udp(const UriParser &src_uri)
 	: m_host(src_uri.host())
 	, m_port(src_uri.portno())
@@ -32,6 +57,29 @@ socket::udp::udp(const UriParser &src_uri)
 
 	int yes = 1;
 	::setsockopt(m_bind_socket, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof yes);
+#if defined(SO_RXQ_OVFL)
+	// Every received datagram carries the number of datagrams dropped by the kernel for this socket.
+	if (::setsockopt(m_bind_socket, SOL_SOCKET, SO_RXQ_OVFL, (const char *)&yes, sizeof yes) < 0)
+		spdlog::debug(LOG_SOCK_UDP "Failed to enable SO_RXQ_OVFL. Kernel drops will not be reported.");
+#endif
+
+	if (m_options.count("shards"))
+	{
+		m_shards = stoi(m_options.at("shards"));
+		m_options.erase("shards");
+		if (m_shards < 1)
+			throw socket::exception("udp: the number of shards must be positive");
+	}
+
+	if (m_shards > 1)
+	{
+#if defined(SO_REUSEPORT)
+		if (::setsockopt(m_bind_socket, SOL_SOCKET, SO_REUSEPORT, (const char *)&yes, sizeof yes) < 0)
+			throw socket::exception("Failed to set SO_REUSEPORT");
+#else
+		throw socket::exception("udp: shards require SO_REUSEPORT, not supported on this platform");
+#endif
+	}
 
 	if (!m_blocking_mode)
 	{ // set non-blocking mode
@@ -92,6 +140,7 @@ socket::udp::udp(const UriParser &src_uri)
 			m_host, m_port, bindip, bindport);
 	}
 
+	m_bound = ip_bonded;
 	if (m_host != "" || ip_bonded)
 	{
 		m_dst_addr = sa_requested.sin;
@@ -99,12 +148,142 @@ socket::udp::udp(const UriParser &src_uri)
 	else
 	{
 		bind_me(reinterpret_cast<const sockaddr*>(&sa_requested));
+		m_bound = true;
+	}
+
+	m_multicast = m_host != "" && sa_requested.family() == AF_INET && IN_MULTICAST(ntohl(sa_requested.sin.sin_addr.s_addr));
+	if (m_multicast)
+		configure_multicast_send();
+
+	if (m_shards > 1 && m_options.count("shard_by"))
+	{
+		attach_shard_filter(m_options.at("shard_by"));
+		m_options.erase("shard_by");
+	}
+
+	uring_io::config uring_cfg;
+	if (uring_io::parse_options(m_options, uring_cfg))
+	{
+		try
+		{
+			m_uring.reset(new uring_io(m_bind_socket, false, uring_cfg));
+			spdlog::info(LOG_SOCK_UDP "udp://{}:{:d}: using io_uring engine.", m_host, m_port);
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::warn(LOG_SOCK_UDP "udp://{}:{:d}: {}. Falling back to the socket API.", m_host, m_port, e.what());
+		}
 	}
 }
 
-socket::udp::~udp() { closesocket(m_bind_socket); }
+void socket::udp::attach_shard_filter(const string& shard_by)
+{
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+	// The filter returns the index of the socket in the SO_REUSEPORT group to deliver a packet to.
+	// By default the kernel selects the socket by the flow hash, so that all the packets of one flow
+	// go to the same socket. The filter spreads them instead: by the CPU handling the packet
+	// (follows RSS/RPS steering of the NIC queues) or at random.
+	uint32_t ancillary = 0;
+	if (shard_by == "cpu")
+		ancillary = SKF_AD_CPU;
+	else if (shard_by == "random")
+		ancillary = SKF_AD_RANDOM;
+	else
+		throw socket::exception(fmt::format("udp: unknown shard_by value '{}' (cpu, random)", shard_by));
 
-size_t socket::udp::read(const mutable_buffer &buffer, int timeout_ms)
+	sock_filter code[] = {
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + ancillary),
+		BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(m_shards)),
+		BPF_STMT(BPF_RET | BPF_A, 0),
+	};
+	sock_fprog prog = {};
+	prog.len        = sizeof code / sizeof code[0];
+	prog.filter     = code;
+	if (::setsockopt(m_bind_socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+		throw socket::exception("Failed to attach SO_REUSEPORT shard selection filter");
+
+	spdlog::info(LOG_SOCK_UDP "udp://{}:{:d}: packets are spread between {} shards by {}.", m_host, m_port, m_shards, shard_by);
+#else
+	throw socket::exception("udp: shard_by is only supported on Linux");
+#endif
+}
+
+void socket::udp::configure_multicast_send()
+{
+	if (m_options.count("ttl"))
+	{
+		const int ttl = stoi(m_options.at("ttl"));
+		if (::setsockopt(m_bind_socket, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl, sizeof ttl) < 0)
+			throw socket::exception("Failed to set IP_MULTICAST_TTL");
+	}
+
+	if (m_options.count("mcloop"))
+	{
+		const int loop = !false_names.count(m_options.at("mcloop"));
+		if (::setsockopt(m_bind_socket, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loop, sizeof loop) < 0)
+			throw socket::exception("Failed to set IP_MULTICAST_LOOP");
+	}
+
+	if (m_options.count("adapter"))
+	{
+		const in_addr iface = parse_ipv4(m_options.at("adapter"), "adapter");
+		if (::setsockopt(m_bind_socket, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&iface, sizeof iface) < 0)
+			throw socket::exception("Failed to set IP_MULTICAST_IF");
+	}
+
+	spdlog::info(LOG_SOCK_UDP "udp://{}:{:d}: multicast group (ttl {}, loopback {}, adapter {}).", m_host, m_port,
+		m_options.count("ttl") ? m_options.at("ttl") : "default", m_options.count("mcloop") ? m_options.at("mcloop") : "default",
+		m_options.count("adapter") ? m_options.at("adapter") : "default");
+}
+
+void socket::udp::join_multicast_group()
+{
+	m_joined = true;
+
+	if (!m_bound)
+	{
+		// Binding to the group address (rather than INADDR_ANY) filters out other groups sent to the same port.
+		sockaddr_in sa = m_dst_addr;
+#if defined(_WIN32)
+		sa.sin_addr.s_addr = INADDR_ANY;
+#endif
+		if (::bind(m_bind_socket, reinterpret_cast<const sockaddr*>(&sa), sizeof sa) < 0)
+			throw socket::exception("UDP binding to the multicast group has failed");
+		m_bound = true;
+	}
+
+	const in_addr iface = m_options.count("adapter") ? parse_ipv4(m_options.at("adapter"), "adapter") : in_addr{INADDR_ANY};
+	if (m_options.count("source"))
+	{
+		// Source-specific multicast.
+		ip_mreq_source mreq = {};
+		mreq.imr_multiaddr  = m_dst_addr.sin_addr;
+		mreq.imr_interface  = iface;
+		mreq.imr_sourceaddr = parse_ipv4(m_options.at("source"), "source");
+		if (::setsockopt(m_bind_socket, IPPROTO_IP, IP_ADD_SOURCE_MEMBERSHIP, (const char*)&mreq, sizeof mreq) < 0)
+			throw socket::exception("Failed to join the multicast group (IP_ADD_SOURCE_MEMBERSHIP)");
+	}
+	else
+	{
+		ip_mreq mreq       = {};
+		mreq.imr_multiaddr = m_dst_addr.sin_addr;
+		mreq.imr_interface = iface;
+		if (::setsockopt(m_bind_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&mreq, sizeof mreq) < 0)
+			throw socket::exception("Failed to join the multicast group (IP_ADD_MEMBERSHIP)");
+	}
+
+	spdlog::info(LOG_SOCK_UDP "udp://{}:{:d}: joined multicast group{}.", m_host, m_port,
+		m_options.count("source") ? " from source " + m_options.at("source") : "");
+}
+
+socket::udp::~udp()
+{
+	// Pending io_uring requests refer to the socket.
+	m_uring.reset();
+	closesocket(m_bind_socket);
+}
+
+bool socket::udp::wait_ready(bool for_write, int timeout_ms) const
 {
 	while (!m_blocking_mode)
 	{
@@ -113,16 +292,47 @@ size_t socket::udp::read(const mutable_buffer &buffer, int timeout_ms)
 		FD_ZERO(&set);
 		FD_SET(m_bind_socket, &set);
 		tv.tv_sec = 0;
-		tv.tv_usec = 10000;
-		const int select_ret = ::select((int)m_bind_socket + 1, &set, NULL, &set, &tv);
+		tv.tv_usec = timeout_ms == 0 ? 0 : 10000; // Only poll the state if not allowed to wait.
+		const int select_ret = for_write
+			? ::select((int)m_bind_socket + 1, nullptr, &set, &set, &tv)
+			: ::select((int)m_bind_socket + 1, &set, NULL, &set, &tv);
 
 		if (select_ret != 0)    // ready
 			break;
 
 		if (timeout_ms >= 0)   // timeout
-			return 0;
+			return false;
 	}
 
+	return true;
+}
+
+size_t socket::udp::read(const mutable_buffer &buffer, int timeout_ms)
+{
+	if (m_uring)
+	{
+		if (m_multicast && !m_joined)
+			join_multicast_group();
+
+		const size_t res = m_uring->recv(buffer, timeout_ms);
+		if (res > 0)
+		{
+			inc(m_pkts_recv, 1);
+			inc(m_bytes_recv, res);
+		}
+		return res;
+	}
+
+#if !defined(_WIN32)
+	// ::recvmsg() also gets the kernel drop counter.
+	return read(mutable_buffer_sequence(&buffer, 1), timeout_ms);
+#else
+	if (m_multicast && !m_joined)
+		join_multicast_group();
+
+	if (!wait_ready(false, timeout_ms))
+		return 0;
+
 	const int res =
 		::recv(m_bind_socket, static_cast<char *>(buffer.data()), (int)buffer.size(), 0);
 	if (res == -1)
@@ -140,28 +350,25 @@ size_t socket::udp::read(const mutable_buffer &buffer, int timeout_ms)
 		return 0;
 	}
 
+	inc(m_pkts_recv, 1);
+	inc(m_bytes_recv, res);
 	return static_cast<size_t>(res);
+#endif
 }
 
 int socket::udp::write(const const_buffer &buffer, int timeout_ms)
 {
-	while (!m_blocking_mode)
+	if (m_uring)
 	{
-		fd_set set;
-		timeval tv;
-		FD_ZERO(&set);
-		FD_SET(m_bind_socket, &set);
-		tv.tv_sec = 0;
-		tv.tv_usec = 10000;
-		const int select_ret = ::select((int)m_bind_socket + 1, nullptr, &set, &set, &tv);
-
-		if (select_ret != 0)    // ready
-			break;
-
-		if (timeout_ms >= 0)   // timeout
-			return 0;
+		const int res = m_uring->send(buffer, reinterpret_cast<const sockaddr*>(&m_dst_addr), sizeof m_dst_addr);
+		inc(m_pkts_sent, 1);
+		inc(m_bytes_sent, res);
+		return res;
 	}
 
+	if (!wait_ready(true, timeout_ms))
+		return 0;
+
 	const int res = ::sendto(m_bind_socket,
 							 static_cast<const char *>(buffer.data()),
 							 (int)buffer.size(),
@@ -186,5 +393,204 @@ int socket::udp::write(const const_buffer &buffer, int timeout_ms)
 		return 0;
 	}
 
+	inc(m_pkts_sent, 1);
+	inc(m_bytes_sent, res);
+	return static_cast<size_t>(res);
+}
+
+size_t socket::udp::read(const mutable_buffer_sequence &buffers, int timeout_ms)
+{
+#if defined(_WIN32)
+	return isocket::read(buffers, timeout_ms);
+#else
+	if (m_uring)
+		return isocket::read(buffers, timeout_ms);
+
+	if (m_multicast && !m_joined)
+		join_multicast_group();
+
+	if (!wait_ready(false, timeout_ms))
+		return 0;
+
+	iovec  iov[MAX_IOV];
+	msghdr msg     = {};
+	msg.msg_iov    = iov;
+	msg.msg_iovlen = to_iovec(buffers, iov);
+#if defined(SO_RXQ_OVFL)
+	char control[CMSG_SPACE(sizeof(uint32_t))];
+	msg.msg_control    = control;
+	msg.msg_controllen = sizeof control;
+#endif
+
+	const ssize_t res = ::recvmsg(m_bind_socket, &msg, 0);
+	if (res == -1)
+	{
+		const int err = errno;
+		if (err != EAGAIN && err != EINTR && err != ECONNREFUSED)
+			throw socket::exception("udp::read::recvmsg");
+
+		spdlog::info("UDP reading failed: error {0}. Again.", err);
+		return 0;
+	}
+
+	if (msg.msg_flags & MSG_TRUNC)
+		spdlog::warn(LOG_SOCK_UDP "Datagram truncated to {} bytes.", res);
+
+#if defined(SO_RXQ_OVFL)
+	// Only present once the kernel has dropped anything.
+	for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL)
+			continue;
+		uint32_t drops = 0;
+		memcpy(&drops, CMSG_DATA(cmsg), sizeof drops);
+		m_kernel_drops.store(drops, memory_order_relaxed);
+	}
+#endif
+
+	inc(m_pkts_recv, 1);
+	inc(m_bytes_recv, res);
 	return static_cast<size_t>(res);
+#endif
+}
+
+int socket::udp::write(const const_buffer_sequence &buffers, int timeout_ms)
+{
+#if defined(_WIN32)
+	return isocket::write(buffers, timeout_ms);
+#else
+	if (m_uring)
+		return isocket::write(buffers, timeout_ms);
+
+	if (!wait_ready(true, timeout_ms))
+		return 0;
+
+	iovec  iov[MAX_IOV];
+	msghdr msg      = {};
+	msg.msg_name    = &m_dst_addr;
+	msg.msg_namelen = sizeof m_dst_addr;
+	msg.msg_iov     = iov;
+	msg.msg_iovlen  = to_iovec(buffers, iov);
+
+	const ssize_t res = ::sendmsg(m_bind_socket, &msg, 0);
+	if (res == -1)
+	{
+		const int err = errno;
+		if (err != EAGAIN && err != EINTR && err != ECONNREFUSED)
+		{
+			spdlog::info("udp::write::sendmsg: error {0}.", err);
+			throw socket::exception("udp::write::sendmsg error");
+		}
+
+		spdlog::info("udp::sendmsg failed: error {0}. Again.", err);
+		return 0;
+	}
+
+	inc(m_pkts_sent, 1);
+	inc(m_bytes_sent, res);
+	return static_cast<int>(res);
+#endif
+}
+
+socket::udp::kernel_queues socket::udp::get_kernel_queues() const
+{
+	kernel_queues q;
+	int       val = 0;
+	socklen_t len = sizeof val;
+	if (::getsockopt(m_bind_socket, SOL_SOCKET, SO_RCVBUF, (char*)&val, &len) == 0)
+		q.rcv_buf = val;
+	len = sizeof val;
+	if (::getsockopt(m_bind_socket, SOL_SOCKET, SO_SNDBUF, (char*)&val, &len) == 0)
+		q.snd_buf = val;
+
+#if defined(__linux__)
+	// SIOCINQ only gives the size of the next datagram of a UDP socket.
+	// The memory taken by all the datagrams waiting to be read is reported by SO_MEMINFO.
+#if defined(SO_MEMINFO)
+	uint32_t meminfo[SK_MEMINFO_VARS] = {};
+	len = sizeof meminfo;
+	if (::getsockopt(m_bind_socket, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0)
+		q.rcv_queue = meminfo[SK_MEMINFO_RMEM_ALLOC];
+#else
+	if (::ioctl(m_bind_socket, SIOCINQ, &val) == 0)
+		q.rcv_queue = val;
+#endif
+	if (::ioctl(m_bind_socket, SIOCOUTQ, &val) == 0)
+		q.snd_queue = val;
+#endif
+
+	return q;
+}
+
+const string socket::udp::get_statistics(string stats_format, bool print_header) const
+{
+	const bool json = stats_format == "json";
+	if (!json && stats_format != "csv")
+		spdlog::warn(LOG_SOCK_UDP "{} format is not supported. csv format will be used instead", stats_format);
+
+	if (print_header)
+	{
+		// JSON format doesn't have header.
+		if (json)
+			return "";
+#ifdef HAS_PUT_TIME
+		return "Timepoint,SocketID,Address,pktSent,byteSent,pktRecv,byteRecv,pktRcvDropKernel,"
+			"byteRcvBuf,byteSndBuf,byteRcvQueue,byteSndQueue\n";
+#else
+		return "SocketID,Address,pktSent,byteSent,pktRecv,byteRecv,pktRcvDropKernel,"
+			"byteRcvBuf,byteSndBuf,byteRcvQueue,byteSndQueue\n";
+#endif
+	}
+
+	// Report per interval values.
+	counters curr;
+	curr.pkts_sent    = m_pkts_sent.load(memory_order_relaxed);
+	curr.bytes_sent   = m_bytes_sent.load(memory_order_relaxed);
+	curr.pkts_recv    = m_pkts_recv.load(memory_order_relaxed);
+	curr.bytes_recv   = m_bytes_recv.load(memory_order_relaxed);
+	curr.kernel_drops = m_kernel_drops.load(memory_order_relaxed);
+	const counters prev = m_prev_report;
+	m_prev_report       = curr;
+
+	// The kernel drop counter is 32-bit and wraps around.
+	const uint32_t kernel_drops = static_cast<uint32_t>(curr.kernel_drops - prev.kernel_drops);
+	const auto     queues       = get_kernel_queues();
+
+	const string address = fmt::format("{}:{}", m_host, m_port);
+	if (json)
+	{
+		nlohmann::json root;
+#ifdef HAS_PUT_TIME
+		root["Timepoint"] = print_timestamp_now();
+#endif
+		root["SocketID"]         = m_bind_socket;
+		root["Address"]          = address;
+		root["pktSent"]          = curr.pkts_sent - prev.pkts_sent;
+		root["byteSent"]         = curr.bytes_sent - prev.bytes_sent;
+		root["pktRecv"]          = curr.pkts_recv - prev.pkts_recv;
+		root["byteRecv"]         = curr.bytes_recv - prev.bytes_recv;
+		root["pktRcvDropKernel"] = kernel_drops;
+		root["byteRcvBuf"]       = queues.rcv_buf;
+		root["byteSndBuf"]       = queues.snd_buf;
+		root["byteRcvQueue"]     = queues.rcv_queue;
+		root["byteSndQueue"]     = queues.snd_queue;
+		return root.dump() + "\n";
+	}
+
+	std::ostringstream output;
+#ifdef HAS_PUT_TIME
+	output << print_timestamp_now() << ',';
+#endif
+	output << m_bind_socket << ',';
+	output << address << ',';
+	output << curr.pkts_sent - prev.pkts_sent << ',';
+	output << curr.bytes_sent - prev.bytes_sent << ',';
+	output << curr.pkts_recv - prev.pkts_recv << ',';
+	output << curr.bytes_recv - prev.bytes_recv << ',';
+	output << kernel_drops << ',';
+	output << queues.rcv_buf << ',';
+	output << queues.snd_buf << ',';
+	output << queues.rcv_queue << ',';
+	output << queues.snd_queue << endl;
+	return output.str();
 }
@@ -1,11 +1,14 @@
 #pragma once
+#include <atomic>
 #include <map>
+#include <memory>
 #include <future>
 #include <string>
 
 // xtransmit
 #include "buffer.hpp"
 #include "socket.hpp"
+#include "uring_io.hpp"
 
 // OpenSRT
 #include "uriparser.hpp"
@@ -43,14 +46,81 @@ public:
 	size_t read(const mutable_buffer &buffer, int timeout_ms = -1) final;
 	int    write(const const_buffer &buffer, int timeout_ms = -1) final;
 
+	/// Scatter read with ::recvmsg().
+	size_t read(const mutable_buffer_sequence &buffers, int timeout_ms = -1) final;
+	/// Gather write of one datagram with ::sendmsg().
+	int    write(const const_buffer_sequence &buffers, int timeout_ms = -1) final;
+
+public:
+	/// The number of sockets sharing the local port (SO_REUSEPORT) to receive one stream.
+	int shards() const { return m_shards; }
+
+	/// The socket I/O is done with io_uring (engine=uring).
+	bool uses_uring() const { return m_uring != nullptr; }
+
+public:
+	/// Per interval packets and bytes, kernel drops (SO_RXQ_OVFL, Linux),
+	/// socket buffer sizes and the amount of data waiting in the kernel queues.
+	bool supports_statistics() const final { return true; }
+
+	const std::string get_statistics(std::string stats_format, bool print_header) const final;
+
+private:
+	/// Wait for the socket to become ready in non-blocking mode.
+	/// @returns false on timeout.
+	bool wait_ready(bool for_write, int timeout_ms) const;
+
+	/// Multicast: set up sending to the group (TTL, loopback, outgoing interface).
+	void configure_multicast_send();
+
+	/// Multicast: bind to the group port and join the group (source-specific if "source" is set).
+	/// Done on the first read, so that a sender does not receive its own traffic.
+	void join_multicast_group();
+
+	/// Sharding: attach a classic BPF program selecting the socket of the SO_REUSEPORT group
+	/// for every packet: by the receiving CPU ("cpu") or at random ("random").
+	void attach_shard_filter(const string& shard_by);
+
+	struct kernel_queues
+	{
+		int64_t rcv_buf   = 0; // SO_RCVBUF
+		int64_t snd_buf   = 0; // SO_SNDBUF
+		int64_t rcv_queue = 0; // Receive queue memory (SO_MEMINFO), Linux only.
+		int64_t snd_queue = 0; // Send queue (SIOCOUTQ), Linux only.
+	};
+	kernel_queues get_kernel_queues() const;
+
 private:
 	SOCKET m_bind_socket = -1; // INVALID_SOCK;
 	sockaddr_in m_dst_addr = {};
 
 	bool                     m_blocking_mode = false;
+	bool                     m_bound         = false;
+	bool                     m_multicast     = false; // The host is a multicast group.
+	bool                     m_joined        = false; // Multicast group has been joined.
+	int                      m_shards        = 1;
 	string                   m_host;
 	int                      m_port;
 	std::map<string, string> m_options; // All other options, as provided in the URI
+	std::unique_ptr<uring_io> m_uring;  // io_uring engine (engine=uring), nullptr for plain syscalls.
+
+	// Cumulative counters, updated by the reading and writing threads.
+	std::atomic<uint64_t> m_pkts_sent{0};
+	std::atomic<uint64_t> m_bytes_sent{0};
+	std::atomic<uint64_t> m_pkts_recv{0};
+	std::atomic<uint64_t> m_bytes_recv{0};
+	std::atomic<uint32_t> m_kernel_drops{0}; // The last SO_RXQ_OVFL value received.
+
+	// Counters at the previous statistics report, accessed by the statistics thread only.
+	struct counters
+	{
+		uint64_t pkts_sent    = 0;
+		uint64_t bytes_sent   = 0;
+		uint64_t pkts_recv    = 0;
+		uint64_t bytes_recv   = 0;
+		uint32_t kernel_drops = 0;
+	};
+	mutable counters m_prev_report;
 };
 
 } // namespace socket
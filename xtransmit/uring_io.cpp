@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+// Multishot receive (Linux 6.0) comes after provided buffer rings (5.19).
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT)
+#define XTR_IO_URING 1
+#endif
+#endif
+
+// submodules
+#include "spdlog/spdlog.h"
+
+// xtransmit
+#include "uring_io.hpp"
+
+using namespace std;
+using namespace std::chrono;
+using namespace xtransmit;
+
+#define LOG_SOCK_URING "SOCKET::URING "
+
+namespace
+{
+uint32_t parse_positive(const map<string, string>& options, const char* name, uint32_t val)
+{
+	if (!options.count(name))
+		return val;
+
+	const int res = stoi(options.at(name));
+	if (res <= 0)
+		throw socket::exception(fmt::format("Invalid value '{}' of the '{}' option", options.at(name), name));
+	return static_cast<uint32_t>(res);
+}
+} // namespace
+
+bool socket::uring_io::parse_options(map<string, string>& options, config& cfg)
+{
+	cfg.num_bufs = parse_positive(options, "uring_bufs", cfg.num_bufs);
+	cfg.buf_size = parse_positive(options, "uring_bufsize", cfg.buf_size);
+	cfg.batch    = parse_positive(options, "uring_batch", cfg.batch);
+	options.erase("uring_bufs");
+	options.erase("uring_bufsize");
+	options.erase("uring_batch");
+
+	if (cfg.num_bufs & (cfg.num_bufs - 1) || cfg.num_bufs > 32768)
+		throw socket::exception("uring_bufs must be a power of two up to 32768");
+
+	if (!options.count("engine"))
+		return false;
+
+	const string engine = options.at("engine");
+	options.erase("engine");
+	if (engine != "uring" && engine != "socket")
+		throw socket::exception(fmt::format("Unknown I/O engine '{}' (uring, socket)", engine));
+	return engine == "uring";
+}
+
+#if XTR_IO_URING
+
+namespace
+{
+const uint64_t RECV_TAG   = UINT64_MAX;
+const uint64_t CANCEL_TAG = UINT64_MAX - 1;
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* p)
+{
+	return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+	return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+} // namespace
+
+socket::uring_io::uring_io(SOCKET fd, bool stream, const config& cfg)
+	: m_fd(fd)
+	, m_stream(stream)
+	, m_cfg(cfg)
+{
+	io_uring_params p = {};
+	m_ring_fd = sys_io_uring_setup(cfg.entries, &p);
+	if (m_ring_fd < 0)
+		throw socket::exception(fmt::format("io_uring_setup failed: error {}", errno));
+
+	try
+	{
+		if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+			throw socket::exception("io_uring: IORING_FEAT_SINGLE_MMAP is not supported");
+
+		// The SQ and CQ rings share one mapping.
+		m_sq_size = max<size_t>(p.sq_off.array + p.sq_entries * sizeof(unsigned), p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+		m_sq_ptr  = ::mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+		if (m_sq_ptr == MAP_FAILED)
+		{
+			m_sq_ptr = nullptr;
+			throw socket::exception(fmt::format("io_uring: failed to map the rings, error {}", errno));
+		}
+		m_cq_ptr = m_sq_ptr;
+
+		m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+		m_sqes      = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+		if (m_sqes == MAP_FAILED)
+		{
+			m_sqes = nullptr;
+			throw socket::exception(fmt::format("io_uring: failed to map the submission entries, error {}", errno));
+		}
+
+		char* sq      = static_cast<char*>(m_sq_ptr);
+		m_sq_head     = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+		m_sq_tail     = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+		m_sq_mask     = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+		m_sq_entries  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_entries);
+		m_sq_array    = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+		char* cq      = static_cast<char*>(m_cq_ptr);
+		m_cq_head     = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+		m_cq_tail     = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+		m_cq_mask     = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+		m_cqes        = cq + p.cq_off.cqes;
+
+		// Provided buffer ring (Linux 5.19): the kernel picks a receive buffer from the ring,
+		// the buffer is given back to the ring once its data has been read.
+		m_buf_ring_size = cfg.num_bufs * sizeof(io_uring_buf);
+		m_buf_ring      = ::mmap(nullptr, m_buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (m_buf_ring == MAP_FAILED)
+		{
+			m_buf_ring = nullptr;
+			throw socket::exception(fmt::format("io_uring: failed to allocate the buffer ring, error {}", errno));
+		}
+
+		io_uring_buf_reg reg = {};
+		reg.ring_addr        = reinterpret_cast<uint64_t>(m_buf_ring);
+		reg.ring_entries     = cfg.num_bufs;
+		reg.bgid             = 0;
+		if (sys_io_uring_register(m_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+			throw socket::exception(fmt::format("io_uring: provided buffer rings are not supported, error {}", errno));
+
+		m_bufs.resize(static_cast<size_t>(cfg.num_bufs) * cfg.buf_size);
+		for (unsigned i = 0; i < cfg.num_bufs; ++i)
+			recycle_buffer(static_cast<uint16_t>(i));
+	}
+	catch (const socket::exception&)
+	{
+		if (m_buf_ring)
+			::munmap(m_buf_ring, m_buf_ring_size);
+		if (m_sqes)
+			::munmap(m_sqes, m_sqes_size);
+		if (m_sq_ptr)
+			::munmap(m_sq_ptr, m_sq_size);
+		::close(m_ring_fd);
+		throw;
+	}
+
+	m_slots.resize(stream ? 1 : max(cfg.entries / 2, cfg.batch));
+	if (!stream && cfg.batch > 1)
+		m_flusher = thread(&uring_io::flush_loop, this);
+	spdlog::debug(LOG_SOCK_URING "0x{:X} io_uring engine: {} SQ entries, {} receive buffers of {} bytes, send batch {}.", m_fd,
+		p.sq_entries, cfg.num_bufs, cfg.buf_size, cfg.batch);
+}
+
+socket::uring_io::~uring_io()
+{
+	if (m_flusher.joinable())
+	{
+		{
+			lock_guard<mutex> lck(m_mtx);
+			m_stop_flusher = true;
+		}
+		m_cv_queued.notify_one();
+		m_flusher.join();
+	}
+
+	try
+	{
+		lock_guard<mutex> lck(m_mtx);
+		if (m_to_submit)
+			submit(0);
+
+		// Let the sends in flight complete (their data is owned by the slots), cancel the receive request.
+		if (m_recv_armed)
+		{
+			auto* sqe      = static_cast<io_uring_sqe*>(get_sqe());
+			sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+			sqe->fd        = -1;
+			sqe->addr      = RECV_TAG;
+			sqe->user_data = CANCEL_TAG;
+			submit(0);
+		}
+
+		const auto deadline = steady_clock::now() + seconds(1);
+		while ((m_inflight > 0 || m_recv_armed) && steady_clock::now() < deadline)
+		{
+			pollfd pfd = {m_ring_fd, POLLIN, 0};
+			::poll(&pfd, 1, 10);
+			reap();
+		}
+	}
+	catch (const socket::exception& e)
+	{
+		spdlog::warn(LOG_SOCK_URING "0x{:X} {}", m_fd, e.what());
+	}
+
+	io_uring_buf_reg reg = {};
+	reg.bgid             = 0;
+	sys_io_uring_register(m_ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+	::munmap(m_buf_ring, m_buf_ring_size);
+	::munmap(m_sqes, m_sqes_size);
+	::munmap(m_sq_ptr, m_sq_size);
+	::close(m_ring_fd);
+}
+
+void* socket::uring_io::get_sqe()
+{
+	unsigned tail = *m_sq_tail;
+	if (tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= *m_sq_entries)
+		submit(0); // The kernel consumes all the submitted entries.
+
+	const unsigned idx = tail & *m_sq_mask;
+	auto*          sqe = static_cast<io_uring_sqe*>(m_sqes) + idx;
+	memset(sqe, 0, sizeof *sqe);
+	m_sq_array[idx] = idx;
+	__atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++m_to_submit;
+	return sqe;
+}
+
+void socket::uring_io::submit(unsigned min_complete)
+{
+	const int res = sys_io_uring_enter(m_ring_fd, m_to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+	if (res < 0)
+	{
+		if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+			return;
+		throw socket::exception(fmt::format("io_uring_enter failed: error {}", errno));
+	}
+	m_to_submit -= min(m_to_submit, static_cast<unsigned>(res));
+	m_queued = 0;
+}
+
+void socket::uring_io::arm_recv()
+{
+	auto* sqe      = static_cast<io_uring_sqe*>(get_sqe());
+	sqe->opcode    = IORING_OP_RECV;
+	sqe->fd        = m_fd;
+	sqe->flags     = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->ioprio    = m_multishot ? IORING_RECV_MULTISHOT : 0;
+	sqe->user_data = RECV_TAG;
+	submit(0);
+	m_recv_armed = true;
+}
+
+void socket::uring_io::queue_send(size_t slot_idx)
+{
+	send_slot& slot = m_slots[slot_idx];
+	auto*      sqe  = static_cast<io_uring_sqe*>(get_sqe());
+	sqe->fd         = m_fd;
+	sqe->user_data  = slot_idx;
+	if (m_stream)
+	{
+		sqe->opcode    = IORING_OP_SEND;
+		sqe->addr      = reinterpret_cast<uint64_t>(slot.data.data() + slot.offset);
+		sqe->len       = static_cast<uint32_t>(slot.len - slot.offset);
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		return;
+	}
+
+	slot.iov             = {slot.data.data(), slot.len};
+	slot.msg             = {};
+	slot.msg.msg_name    = &slot.dst;
+	slot.msg.msg_namelen = slot.dst_len;
+	slot.msg.msg_iov     = &slot.iov;
+	slot.msg.msg_iovlen  = 1;
+	sqe->opcode          = IORING_OP_SENDMSG;
+	sqe->addr            = reinterpret_cast<uint64_t>(&slot.msg);
+	sqe->len             = 1;
+}
+
+void socket::uring_io::recycle_buffer(uint16_t bid)
+{
+	// The ring is an array of io_uring_buf with the tail overlaid on the first entry.
+	// Not using io_uring_buf_ring::bufs: the flexible array member has a different offset in C++.
+	auto*          ring = static_cast<io_uring_buf_ring*>(m_buf_ring);
+	const uint16_t tail = ring->tail;
+	io_uring_buf&  buf  = static_cast<io_uring_buf*>(m_buf_ring)[tail & (m_cfg.num_bufs - 1)];
+	buf.addr            = reinterpret_cast<uint64_t>(m_bufs.data() + static_cast<size_t>(bid) * m_cfg.buf_size);
+	buf.len             = m_cfg.buf_size;
+	buf.bid             = bid;
+	__atomic_store_n(&ring->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+void socket::uring_io::reap()
+{
+	unsigned       head   = *m_cq_head;
+	const unsigned tail   = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+	bool           resend = false;
+	for (; head != tail; ++head)
+	{
+		const io_uring_cqe cqe = static_cast<io_uring_cqe*>(m_cqes)[head & *m_cq_mask];
+
+		if (cqe.user_data == CANCEL_TAG)
+			continue;
+
+		if (cqe.user_data == RECV_TAG)
+		{
+			if (!(cqe.flags & IORING_CQE_F_MORE))
+				m_recv_armed = false;
+
+			if (cqe.flags & IORING_CQE_F_BUFFER)
+			{
+				const uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+				if (cqe.res > 0)
+					m_received.push_back(received{bid, static_cast<uint32_t>(cqe.res), 0});
+				else
+					recycle_buffer(bid);
+			}
+
+			if (cqe.res == 0 && m_stream)
+				m_eof = true;
+			else if (cqe.res == -EINVAL && m_multishot)
+			{
+				spdlog::debug(LOG_SOCK_URING "0x{:X} Multishot receive is not supported. Falling back to single shot.", m_fd);
+				m_multishot = false;
+			}
+			else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED && cqe.res != -ECONNREFUSED)
+				m_recv_error = -cqe.res;
+			continue;
+		}
+
+		if (cqe.user_data >= m_slots.size())
+			continue;
+
+		send_slot& slot = m_slots[cqe.user_data];
+		if (cqe.res < 0 && cqe.res != -ECONNREFUSED)
+			m_send_error = -cqe.res;
+
+		// A short send of a stream: send the rest.
+		if (m_stream && cqe.res > 0 && slot.offset + cqe.res < slot.len)
+		{
+			slot.offset += cqe.res;
+			queue_send(cqe.user_data);
+			resend = true;
+			continue;
+		}
+
+		slot.busy = false;
+		--m_inflight;
+		m_in_flight_stream = false;
+	}
+	__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+
+	if (resend)
+		submit(0);
+}
+
+size_t socket::uring_io::recv(const mutable_buffer& buffer, int timeout_ms)
+{
+	const auto deadline = steady_clock::now() + milliseconds(max(timeout_ms, 0));
+	for (;;)
+	{
+		{
+			lock_guard<mutex> lck(m_mtx);
+			// Do not hold back writes (e.g. replies) while waiting for data.
+			if (m_to_submit)
+				submit(0);
+			reap();
+
+			if (!m_received.empty())
+			{
+				received&   r   = m_received.front();
+				const char* src = m_bufs.data() + static_cast<size_t>(r.bid) * m_cfg.buf_size + r.offset;
+				const size_t n  = min<size_t>(r.len - r.offset, buffer.size());
+				memcpy(buffer.data(), src, n);
+
+				if (m_stream && r.offset + n < r.len)
+				{
+					r.offset += static_cast<uint32_t>(n);
+					return n;
+				}
+
+				if (!m_stream && n < r.len)
+					spdlog::warn(LOG_SOCK_URING "0x{:X} Datagram of {} bytes truncated to {} bytes.", m_fd, r.len, n);
+				recycle_buffer(r.bid);
+				m_received.pop_front();
+				return n;
+			}
+
+			if (m_recv_error)
+				throw socket::exception(fmt::format("io_uring receive failed: error {}", m_recv_error));
+			if (m_eof)
+				throw socket::exception("io_uring receive: zero bytes read (connection broken)");
+
+			if (!m_recv_armed)
+				arm_recv();
+		}
+
+		int wait_ms = -1;
+		if (timeout_ms >= 0)
+		{
+			wait_ms = static_cast<int>(duration_cast<milliseconds>(deadline - steady_clock::now()).count());
+			if (wait_ms < 0)
+				return 0;
+		}
+
+		// The ring is readable when completions are posted.
+		pollfd pfd = {m_ring_fd, POLLIN, 0};
+		if (::poll(&pfd, 1, wait_ms) == 0 && timeout_ms >= 0)
+			return 0;
+	}
+}
+
+int socket::uring_io::send(const const_buffer& buffer, const sockaddr* dst, socklen_t dst_len)
+{
+	unique_lock<mutex> lck(m_mtx);
+	reap();
+
+	// Requests are not guaranteed to complete in order, so a stream has one send in flight:
+	// wait for the previous write to be sent.
+	while (m_stream && m_in_flight_stream && !m_send_error)
+		wait_completion(lck);
+
+	if (m_send_error)
+		throw socket::exception(fmt::format("io_uring send failed: error {}", m_send_error));
+
+	auto free_slot = find_if(m_slots.begin(), m_slots.end(), [](const send_slot& s) { return !s.busy; });
+	while (free_slot == m_slots.end())
+	{
+		// All the slots are in flight: wait for a completion.
+		wait_completion(lck);
+		free_slot = find_if(m_slots.begin(), m_slots.end(), [](const send_slot& s) { return !s.busy; });
+	}
+
+	send_slot& slot = *free_slot;
+	slot.data.resize(max(slot.data.size(), buffer.size()));
+	memcpy(slot.data.data(), buffer.data(), buffer.size());
+	slot.len    = buffer.size();
+	slot.offset = 0;
+	slot.busy   = true;
+	if (dst)
+	{
+		memcpy(&slot.dst, dst, dst_len);
+		slot.dst_len = dst_len;
+	}
+	++m_inflight;
+	const size_t idx = free_slot - m_slots.begin();
+	if (m_stream)
+	{
+		m_in_flight_stream = true;
+		queue_send(idx);
+		submit(0);
+		return static_cast<int>(buffer.size());
+	}
+
+	queue_send(idx);
+
+	const auto now = steady_clock::now();
+	if (m_queued++ == 0)
+	{
+		m_first_queued = now;
+		m_cv_queued.notify_one();
+	}
+	if (m_queued >= m_cfg.batch || now - m_first_queued >= milliseconds(1))
+		submit(0);
+
+	return static_cast<int>(buffer.size());
+}
+
+void socket::uring_io::wait_completion(unique_lock<mutex>& lck)
+{
+	if (m_to_submit)
+		submit(0);
+
+	// Completions can be reaped by a reading thread meanwhile, so the wait is short.
+	lck.unlock();
+	pollfd pfd = {m_ring_fd, POLLIN, 0};
+	::poll(&pfd, 1, 10);
+	lck.lock();
+	reap();
+}
+
+void socket::uring_io::flush_loop()
+{
+	unique_lock<mutex> lck(m_mtx);
+	while (!m_stop_flusher)
+	{
+		if (m_queued == 0)
+		{
+			m_cv_queued.wait(lck);
+			continue;
+		}
+
+		const auto deadline = m_first_queued + milliseconds(1);
+		if (steady_clock::now() < deadline)
+		{
+			m_cv_queued.wait_until(lck, deadline);
+			continue;
+		}
+
+		try
+		{
+			submit(0);
+		}
+		catch (const socket::exception& e)
+		{
+			spdlog::warn(LOG_SOCK_URING "0x{:X} {}", m_fd, e.what());
+			m_queued = 0;
+		}
+	}
+}
+
+#else
+
+socket::uring_io::uring_io(SOCKET fd, bool stream, const config& cfg)
+	: m_fd(fd)
+	, m_stream(stream)
+	, m_cfg(cfg)
+{
+	throw socket::exception("io_uring is not supported on this platform");
+}
+
+socket::uring_io::~uring_io() {}
+
+size_t socket::uring_io::recv(const mutable_buffer&, int) { return 0; }
+
+int socket::uring_io::send(const const_buffer&, const sockaddr*, socklen_t) { return 0; }
+
+#endif // XTR_IO_URING
@@ -0,0 +1,158 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// xtransmit
+#include "buffer.hpp"
+#include "socket.hpp"
+
+namespace xtransmit
+{
+namespace socket
+{
+
+/// io_uring I/O engine of a UDP or TCP socket (Linux).
+///
+/// Reading uses a multishot receive request with a ring of provided buffers: the kernel keeps
+/// filling the buffers as data arrives without a syscall per message, and a read just takes
+/// the next completion. Writes are copied into send slots and return without waiting
+/// for the send to complete. UDP writes are queued as submission entries, submitted
+/// in batches with a single io_uring_enter(). TCP writes keep the stream order:
+/// one send request is in flight at a time, a write waits for the previous one to be sent.
+///
+/// With a UDP batch of more than one write, a queued write is submitted when the batch is full,
+/// or about 1 ms after it was queued by a flushing thread of the engine. Send errors are reported by the next write.
+class uring_io
+{
+public:
+	struct config
+	{
+		unsigned entries  = 256;  // Submission queue size.
+		unsigned num_bufs = 256;  // Provided receive buffers (a power of two).
+		unsigned buf_size = 2048; // Size of a provided receive buffer, the maximum datagram size for UDP.
+		unsigned batch    = 1;    // Writes submitted together.
+	};
+
+	/// Parse and remove the io_uring options of a URI: "engine" (uring, socket),
+	/// "uring_bufs", "uring_bufsize" and "uring_batch".
+	/// @returns true if the io_uring engine is requested.
+	/// @throws socket::exception on an invalid value.
+	static bool parse_options(std::map<std::string, std::string>& options, config& cfg);
+
+	/// @param fd      a connected TCP socket or a UDP socket
+	/// @param stream  the socket is a stream (TCP) socket: a message can be read in parts
+	/// @throws socket::exception if io_uring or a required feature (provided buffer rings)
+	///         is not supported by the kernel. The caller is expected to fall back to the plain syscalls.
+	uring_io(SOCKET fd, bool stream, const config& cfg);
+	~uring_io();
+
+	uring_io(const uring_io&) = delete;
+	uring_io& operator=(const uring_io&) = delete;
+
+public:
+	/// Receive a message (UDP) or the next bytes of the stream (TCP).
+	/// @returns the number of bytes received, 0 on timeout.
+	/// @throws socket::exception on failure or if the TCP connection is closed.
+	size_t recv(const mutable_buffer& buffer, int timeout_ms);
+
+	/// Queue a message to be sent.
+	/// @param dst  destination address (UDP), nullptr for TCP.
+	/// @returns the number of bytes queued.
+	/// @throws socket::exception if a previous send has failed.
+	int send(const const_buffer& buffer, const sockaddr* dst, socklen_t dst_len);
+
+private:
+	struct send_slot
+	{
+		std::vector<char> data;
+		size_t            len     = 0;
+		size_t            offset  = 0; // TCP: bytes already sent (short send).
+		bool              busy    = false;
+		sockaddr_storage  dst     = {};
+		socklen_t         dst_len = 0;
+#if !defined(_WIN32)
+		iovec             iov     = {};
+		msghdr            msg     = {};
+#endif
+	};
+
+	struct received
+	{
+		uint16_t bid;
+		uint32_t len;
+		uint32_t offset; // TCP: bytes already returned.
+	};
+
+	void* get_sqe();
+	void  submit(unsigned min_complete);
+	void  arm_recv();
+	void  queue_send(size_t slot_idx);
+	void  recycle_buffer(uint16_t bid);
+
+	/// Process completion entries. Must be called with m_mtx locked.
+	void reap();
+
+	/// Wait for completion entries with m_mtx unlocked, then reap them.
+	void wait_completion(std::unique_lock<std::mutex>& lck);
+
+	/// UDP batches: submit queued writes once they have waited for 1 ms.
+	void flush_loop();
+
+private:
+	const SOCKET m_fd;
+	const bool   m_stream;
+	const config m_cfg;
+	int          m_ring_fd = -1;
+
+	// Mapped ring memory.
+	void*  m_sq_ptr    = nullptr;
+	size_t m_sq_size   = 0;
+	void*  m_cq_ptr    = nullptr;
+	size_t m_cq_size   = 0;
+	void*  m_sqes      = nullptr;
+	size_t m_sqes_size = 0;
+
+	unsigned* m_sq_head    = nullptr;
+	unsigned* m_sq_tail    = nullptr;
+	unsigned* m_sq_mask    = nullptr;
+	unsigned* m_sq_entries = nullptr;
+	unsigned* m_sq_array   = nullptr;
+	unsigned* m_cq_head    = nullptr;
+	unsigned* m_cq_tail    = nullptr;
+	unsigned* m_cq_mask    = nullptr;
+	void*     m_cqes       = nullptr;
+	unsigned  m_to_submit  = 0;
+
+	// Provided receive buffers.
+	void*             m_buf_ring      = nullptr;
+	size_t            m_buf_ring_size = 0;
+	std::vector<char> m_bufs;
+	bool              m_recv_armed = false;
+	bool              m_multishot  = true; // Falls back to single shot receive requests if not supported.
+	std::deque<received> m_received;
+	int               m_recv_error = 0;
+	bool              m_eof        = false;
+
+	std::vector<send_slot> m_slots;
+	size_t                 m_inflight   = 0;
+	int                    m_send_error = 0;
+	unsigned               m_queued     = 0; // Writes queued but not submitted.
+	std::chrono::steady_clock::time_point m_first_queued;
+	bool                   m_in_flight_stream = false; // TCP: a send request is in flight.
+
+	std::mutex m_mtx; // A socket can be read and written by different threads.
+
+	std::thread             m_flusher; // UDP batches of more than one write.
+	std::condition_variable m_cv_queued;
+	bool                    m_stop_flusher = false;
+};
+
+} // namespace socket
+} // namespace xtransmit